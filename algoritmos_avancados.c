@@ -1,601 +1,7973 @@
 /*
  Detective Quest - Sistema de exploração, coleta de pistas e julgamento
- - Árvore binária para as salas (mansão)
- - BST para armazenar pistas coletadas (ordenadas)
- - Tabela hash (encadeamento) para associar pista -> suspeito
- - Funções documentadas: criarSala, explorarSalas, inserirPista/adicionarPista,
+ - Árvore binária para as salas (mansão), usada no jogo em forma plana
+   (vetor de salas com filhos por índice), montada por criarSala ou
+   carregada de arquivo (--mansao, ver carregarMansao e mansao_exemplo.txt),
+   ou procedural (--procedural): salas geradas de uma semente só quando a
+   sessão entra nelas, com cache LRU limitado por sessão
+ - Caso compartilhado somente leitura e estado por sessão (Sessao), de modo
+   que muitas investigações rodam ao mesmo tempo em threads (--lote --threads)
+ - Modo em lote (--lote): sessões roteirizadas sem prompts, com vazão medida
+ - Caso compilado em arquivo binário (.dqc) mapeado com mmap e usado no
+   lugar, sem reconstrução (--compilar-caso / --caso, ver gravarCaso)
+ - Árvore AVL para armazenar pistas coletadas (ordenadas e balanceadas)
+ - Tabela hash (endereçamento aberto Robin Hood, redimensionável) para associar pista -> suspeito
+ - Arena por jogo: salas, pistas e textos liberados de uma vez
+ - Placar por suspeito atualizado a cada pista coletada (acusação em O(1)),
+   com pesos por pista e suspeito (uma pista pode incriminar vários e
+   inocentar outros) e limiares configuráveis para o veredito
+ - Caderno opcional em bitset sobre ids densos de pistas (--caderno bits)
+ - Hash de textos e comparação sem caixa vetorizados (SSE2/AVX2 escolhidos
+   em tempo de execução, com versão escalar equivalente)
+ - Funções documentadas: criarSala, explorarSalas, inserirPistaIterativa,
    inserirNaHash, encontrarSuspeito, verificarSuspeitoFinal
  Autor: Enigma Studios (exemplo)
+
+ Compilação:
+   gcc -O2 -pthread algoritmos_avancados.c -o detective
+   gcc -O2 -pthread -DDQ_BENCH algoritmos_avancados.c -o detective_bench   (benchmarks)
+   gcc -O2 -pthread -DDQ_INSTRUMENTAR algoritmos_avancados.c -o detective   (relatório
+       de contagens, latências, alturas e ocupação da hash ao sair; ver DQ_RELATORIO)
 */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
+#include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <stdint.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <errno.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DQ_X86 1
+#include <immintrin.h>
+#endif
 
 /* -------------------------
    Definições de tipos
    ------------------------- */
 
+// Bloco de memória da arena (bump allocator)
+typedef struct ArenaBloco {
+    struct ArenaBloco *prox;
+    size_t usado;
+    size_t capacidade;
+    _Alignas(16) unsigned char dados[];
+} ArenaBloco;
+
+// Arena do jogo: nós liberados de uma só vez
+typedef struct Arena {
+    ArenaBloco *nos;        // blocos de nós (Sala, PistaNode)
+    size_t bytesReservados;
+    int individual;         // 1 = um malloc por alocação (comparação/depuração)
+} Arena;
+
+// Identificador de um texto internado (ver internar)
+typedef uint32_t TextoId;
+#define TEXTO_NENHUM ((TextoId) 0xFFFFFFFFu)
+
+// Tabela global de textos internados
+typedef struct Internador {
+    char *pool;             // textos concatenados, cada um terminado em '\0'
+    size_t poolUsado;
+    size_t poolCap;
+    uint32_t *offsets;      // offsets[id] = início do texto no pool
+    uint64_t *hashes;       // hashes[id] = hashString do texto
+    uint32_t total;
+    uint32_t capIds;
+    TextoId *slots;         // sondagem linear; TEXTO_NENHUM = vazio
+    size_t capSlots;
+    int mapeado;            // 1 = vetores apontam para um caso mapeado (ver abrirCaso)
+} Internador;
+
 // Nó da árvore da mansão (cada sala)
 typedef struct Sala {
-    char *nome;             // nome da sala (dinâmico)
+    TextoId nome;           // nome da sala (internado)
+    TextoId pista;          // pista da sala ou TEXTO_NENHUM (resolvida em criarSala)
     struct Sala *esq;       // sala à esquerda
     struct Sala *dir;       // sala à direita
 } Sala;
 
-// Nó da BST de pistas
+// Sala na forma plana (vetor contíguo, filhos por índice)
+typedef struct SalaPlana {
+    TextoId nome;           // nome da sala (internado)
+    TextoId pista;          // pista da sala ou TEXTO_NENHUM
+    uint32_t esq;           // índice da sala à esquerda ou SALA_NENHUMA
+    uint32_t dir;           // índice da sala à direita ou SALA_NENHUMA
+} SalaPlana;
+
+#define SALA_NENHUMA ((uint32_t) 0xFFFFFFFFu)
+
+// Mansão usada durante o jogo (raiz no índice 'raiz', normalmente 0)
+typedef struct Mansao {
+    SalaPlana *salas;
+    uint32_t total;
+    uint32_t cap;
+    uint32_t raiz;
+    int mapeada;            // 1 = 'salas' aponta para um caso mapeado
+    int procedural;         // 1 = salas geradas sob demanda (ver Mansão procedural); 'salas' fica NULL
+    uint64_t semente;
+    TextoId *catalogo;      // mansão procedural: pistas sorteadas para as salas
+    uint32_t totalCatalogo;
+    uint32_t salasEmCache;  // capacidade do cache de salas de cada sessão
+} Mansao;
+
+// ordem das salas no vetor depois de congelarMansao
+typedef enum { LEIAUTE_ARQUIVO, LEIAUTE_LARGURA, LEIAUTE_VEB } LeiauteMansao;
+
+#define NOME_SALA_MAX 48
+#define PISTAS_DESCONHECIDAS ((uint32_t) 0xFFFFFFFFu)
+
+// Sala de uma mansão procedural materializada no cache de uma sessão
+typedef struct SalaGerada {
+    uint32_t indice;        // sala ou SALA_NENHUMA (vaga livre)
+    uint32_t anterior;      // lista LRU: vizinho usado mais recentemente
+    uint32_t proxima;       // vizinho usado menos recentemente
+    TextoId pista;
+    char nome[NOME_SALA_MAX];
+} SalaGerada;
+
+// Cache LRU de salas geradas (um por sessão, sem trava)
+typedef struct CacheSalas {
+    SalaGerada *vagas;
+    uint32_t capacidade;
+    uint32_t usadas;
+    uint32_t *posicoes;     // sondagem linear: sala -> vaga, SALA_NENHUMA = livre
+    uint32_t mascara;
+    uint32_t recente;       // cabeça (mais recente) e cauda da lista LRU
+    uint32_t antiga;
+    unsigned long acertos;
+    unsigned long geradas;
+} CacheSalas;
+
+// Nó da árvore AVL de pistas
 typedef struct PistaNode {
-    char *pista;                // texto da pista
+    TextoId pista;              // texto da pista (internado)
     struct PistaNode *esq;
     struct PistaNode *dir;
+    int altura;                 // altura da subárvore (folha = 1)
+    uint32_t tamanho;           // nós na subárvore (contarPistas em O(1))
 } PistaNode;
 
-// Entrada da tabela hash (encadeada)
+// Par de uma carga de evidências (ver carregarEvidencias)
+typedef struct ParEvidencia {
+    const char *pista;
+    const char *suspeito;
+} ParEvidencia;
+
+// Ordem de visita dos cursores de árvore
+typedef enum { ORDEM_EM, ORDEM_PRE } OrdemPercurso;
+
+#define CURSOR_PILHA_LOCAL 64
+
+/*
+ * Cursor sobre árvore binária (Sala ou PistaNode): pilha explícita que
+ * começa num vetor interno e vai para o heap só se a árvore for mais funda
+ * que CURSOR_PILHA_LOCAL, como mansões degeneradas.
+ */
+typedef struct CursorArvore {
+    OrdemPercurso ordem;
+    size_t offEsq, offDir;      // deslocamento dos filhos no nó
+    void **itens;               // pilha em [0, topo)
+    size_t topo, cap;
+    void *atual;                // em-ordem: próximo a descer
+    void *local[CURSOR_PILHA_LOCAL];
+} CursorArvore;
+
+// Identificador denso de suspeito (ver cadastrarSuspeito)
+typedef uint32_t SuspeitoId;
+#define SUSPEITO_NENHUM ((SuspeitoId) 0xFFFFFFFFu)
+
+// Entrada da tabela hash (endereçamento aberto)
 typedef struct HashEntry {
-    char *chave;           // pista (key)
-    char *valor;           // suspeito (value)
-    struct HashEntry *prox;
+    uint64_t hash;         // hash completo da chave (0 = posição vazia)
+    TextoId chave;         // pista (key)
+    SuspeitoId valor;      // suspeito (value)
 } HashEntry;
 
+// Contagem incremental de pistas coletadas por suspeito
+typedef struct Placar {
+    int *contagem;          // contagem[s] = pistas do caderno que citam s
+    int64_t *pontos;        // pontos[s] = soma dos pesos dessas pistas para s
+    uint32_t capacidade;
+} Placar;
+
+// Peso de uma pista para um suspeito (ver Pesos de evidência)
+typedef struct PesoEvidencia {
+    SuspeitoId suspeito;
+    int32_t peso;           // > 0 incrimina, < 0 inocenta
+} PesoEvidencia;
+
+// Pesos e limiares lidos do arquivo da mansão, antes de o caso numerar as pistas
+typedef struct RegrasEvidencia {
+    TextoId *pistas;        // pistas[i] vale pesos[i]
+    PesoEvidencia *pesos;
+    uint32_t total;
+    uint32_t cap;
+    int32_t limiarSustentar;
+    int32_t limiarInocentar;
+} RegrasEvidencia;
+
+// Tabela hash pista -> suspeito (Robin Hood, capacidade potência de 2)
+typedef struct TabelaHash {
+    HashEntry *entradas;
+    size_t capacidade;
+    size_t tamanho;
+    int mapeada;           // 1 = 'entradas' aponta para um caso mapeado (copiado ao alterar)
+} TabelaHash;
+
+// Cadastro global de suspeitos
+typedef struct CadastroSuspeitos {
+    TabelaHash *porChave;   // nome em minúsculas -> SuspeitoId
+    TextoId *nomes;         // nome exibido de cada suspeito
+    uint32_t total;
+    uint32_t cap;
+    int mapeado;            // 1 = 'nomes' aponta para um caso mapeado
+} CadastroSuspeitos;
+
+#define HASH_CAPACIDADE_MIN 16
+
+// Formato do que o jogo escreve na saída (ver Saída)
+typedef enum FormatoSaida {
+    SAIDA_TEXTO,            // mensagens para o jogador
+    SAIDA_JSON              // um objeto JSON por linha, sem prompts
+} FormatoSaida;
+
+// Buffer de saída reaproveitado; vai para 'fd' com um write por descarga
+typedef struct Saida {
+    int fd;                 // -1: só acumula (benchmarks)
+    FormatoSaida formato;
+    char *buf;
+    size_t usado;
+    size_t cap;
+    unsigned long escritas; // chamadas a write
+} Saida;
+
+#define SAIDA_INICIAL 4096
+#define SAIDA_LOTE ((size_t) 64 << 10)   // listagens longas e o lote descarregam a cada SAIDA_LOTE bytes
+
+// Como a sessão guarda as pistas coletadas
+typedef enum ModoCaderno {
+    CADERNO_AVL,            // AVL de PistaNode na arena da sessão
+    CADERNO_BITS            // bitset sobre os ids densos das pistas do caso
+} ModoCaderno;
+
+// Estado de uma investigação; o resto (mansão, tabela, textos) é do Caso
+typedef struct Sessao {
+    Arena *arena;           // nós do caderno (e da vista ordenada no modo bits)
+    ModoCaderno modo;
+    PistaNode *caderno;     // pistas coletadas (AVL) - CADERNO_AVL
+    uint64_t *bits;         // pistas coletadas (bit = id denso) - CADERNO_BITS
+    uint32_t coletadas;     // bits ligados em 'bits'
+    Placar placar;          // aponta para 'caderno': a Sessao não pode ser movida
+    uint32_t cursor;        // sala atual
+    unsigned long passos;   // comandos aplicados
+    int diario;             // diário da sessão (ver abrirDiario) ou -1
+    CacheSalas *cache;      // mansão procedural: salas já geradas (ou NULL)
+} Sessao;
+
+// Efeito de um comando de exploração sobre o cursor (ver aplicarComando)
+typedef enum ResultadoComando {
+    COMANDO_MOVEU,
+    COMANDO_SEM_SALA,       // não há sala na direção pedida
+    COMANDO_INICIO,         // voltou à sala raiz
+    COMANDO_SAIR,
+    COMANDO_DESCONHECIDO
+} ResultadoComando;
+
+// Totais de uma execução em lote (ver executarLote)
+typedef struct EstatisticasLote {
+    unsigned long sessoes;
+    unsigned long passos;       // comandos aplicados
+    unsigned long sustentadas;  // acusações sustentadas
+    double segundos;
+} EstatisticasLote;
+
+// Resultado do resolvedor para um suspeito (ver resolverCaso)
+typedef enum {
+    SOLUCAO_IMPOSSIVEL,     // nenhuma exploração sustenta a acusação
+    SOLUCAO_SUSTENTAVEL,    // alguma exploração sustenta; 'passos' é a menor
+    SOLUCAO_INDETERMINADA   // grande demais para a busca exata
+} SituacaoSolucao;
+
+typedef enum {
+    PROVA_COTA,             // a soma dos pesos positivos alcançáveis não chega ao limiar
+    PROVA_ARVORE,           // custo mínimo por pontos, subárvore a subárvore
+    PROVA_CONJUNTOS,        // busca pelos conjuntos de pistas coletáveis
+    PROVA_NENHUMA
+} ProvaSolucao;
+
+// por que um suspeito ficou indeterminado
+typedef enum {
+    MOTIVO_NENHUM,
+    MOTIVO_REPETIDAS,       // pistas repetidas e relevantes demais para a busca por conjuntos
+    MOTIVO_FAIXA,           // faixa de pontos larga demais para a árvore e relevantes demais para os conjuntos
+    MOTIVO_CANDIDATAS,      // caminhos candidatos demais (RESOLVER_CANDIDATAS_MAX)
+    MOTIVO_ESTADOS          // conjuntos de pistas demais (RESOLVER_ESTADOS_MAX)
+} MotivoIndeterminado;
+
+typedef struct SolucaoSuspeito {
+    SituacaoSolucao situacao;
+    ProvaSolucao prova;
+    long long passos;       // comandos ('e', 'd', 'r') da menor exploração que sustenta
+    long long maximo;       // soma dos pesos positivos das pistas alcançáveis
+    uint32_t relevantes;    // pistas alcançáveis com peso para o suspeito
+    int repetidas;          // 1 se alguma delas está em mais de uma sala
+    MotivoIndeterminado motivo; // só em SOLUCAO_INDETERMINADA
+} SolucaoSuspeito;
+
+#define PISTAS_PARA_SUSTENTAR 2
+#define LIMIAR_INOCENTAR_PADRAO (-1)   // pontos em que (ou abaixo dos quais) um suspeito é inocentado
+#define PESO_MAXIMO 1000000
+
+// Situação de um suspeito diante dos limiares do caso (ver situacaoSuspeito)
+typedef enum SituacaoSuspeito {
+    SITUACAO_INDEFINIDA,    // entre os dois limiares
+    SITUACAO_INCRIMINADO,   // pontos >= limiarSustentar
+    SITUACAO_INOCENTADO     // pontos <= limiarInocentar
+} SituacaoSuspeito;
+
+// Caso compartilhado (somente leitura) entre sessões: montado em memória
+// (prepararCaso) ou aberto de um arquivo .dqc (abrirCaso)
+/*
+ * Índice de caminhos da mansão (ver montarCaminhos): pré-ordem com início e
+ * fim de cada subárvore (ancestral em O(1)), pais e ponteiros de salto
+ * (ancestral comum em O(log n)) e prefixos de salas com pista.
+ */
+typedef struct IndiceCaminhos {
+    uint32_t *pai;          // sala -> pai ou SALA_NENHUMA
+    uint32_t *salto;        // sala -> ancestral de salto (ponteiros de salto)
+    uint32_t *profundidade; // raiz = 0
+    uint32_t *entrada;      // posição na pré-ordem ou SALA_NENHUMA (inalcançável)
+    uint32_t *saida;        // fim (exclusivo) da subárvore na pré-ordem
+    uint32_t *ordem;        // posição na pré-ordem -> sala
+    uint32_t *pistasAntes;  // salas com pista entre as k primeiras da pré-ordem
+    uint32_t alcancaveis;   // salas ligadas à raiz
+    uint32_t *salaPorNome;  // TextoId -> primeira sala com o nome ou SALA_NENHUMA
+    uint32_t totalNomes;
+} IndiceCaminhos;
+
+typedef struct Caso {
+    Mansao mansao;
+    TabelaHash *tabela;             // pista -> suspeito
+    SuspeitoId desconhecido;        // suspeito das pistas fora da tabela
+    const TextoId *indicePistas;    // id denso -> pista, em ordem alfabética
+    uint32_t totalPistas;
+    const uint32_t *densaDaPista;   // TextoId -> id denso ou PISTA_NENHUMA
+    uint32_t totalDensaDaPista;     // textos cobertos por densaDaPista
+    const SuspeitoId *suspeitoDaPista; // id denso -> suspeito (já com "Desconhecido")
+    const uint32_t *inicioPesos;    // id denso -> primeiro peso da pista em 'pesos' (totalPistas + 1
+                                    // posições), ou NULL: cada pista vale 1 para suspeitoDaPista
+    const PesoEvidencia *pesos;
+    uint32_t totalPesos;
+    int32_t limiarSustentar;        // pontos para sustentar uma acusação
+    int32_t limiarInocentar;        // pontos em que o suspeito é inocentado
+    uint64_t *mascaras;             // mascaras[s * palavras + w]: pistas que apontam para s (ou NULL)
+    uint32_t palavras;              // palavras de 64 bits num bitset de pistas
+    uint32_t totalMascaras;         // suspeitos com máscara
+    IndiceCaminhos caminhos;        // rotas, ancestrais e pistas por subárvore
+    uint64_t impressao;             // identifica o caso nas sessões salvas
+    void *mapa;                     // NULL se o caso foi montado em memória
+    size_t tamanhoMapa;
+} Caso;
+
 /* -------------------------
    Protótipos de funções
    ------------------------- */
 
+// Arena
+Arena* criarArena(int individual);
+void* arenaAlocar(Arena *a, size_t tam);
+void reiniciarArena(Arena *a);
+void liberarArena(Arena *a);
+
+// Hash e comparação de textos (SIMD com despacho em tempo de execução)
+typedef enum { SIMD_ESCALAR, SIMD_SSE2, SIMD_AVX2 } NivelSimd;
+NivelSimd nivelSimdDisponivel(void);
+NivelSimd forcarNivelSimd(NivelSimd nivel);
+const char* nomeNivelSimd(NivelSimd nivel);
+uint64_t hashBytes(const void *dados, size_t n);
+uint64_t hashString(const char *s);
+int iguaisSemCaixa(const char *a, const char *b);
+void copiarMinusculo(char *dst, const char *src, size_t cap);
+
+// Textos internados
+TextoId internar(const char *s);
+TextoId buscarTexto(const char *s);
+const char* textoDe(TextoId id);
+uint64_t hashDoTexto(TextoId id);
+void liberarTextos(void);
+
 // Salas (árvore da mansão)
-Sala* criarSala(const char *nome);
-void liberarSalas(Sala *raiz);
+Sala* criarSala(Arena *arena, const char *nome);
+
+// Mansão plana
+void iniciarMansao(Mansao *m);
+void mansaoDeSalas(Mansao *m, Sala *raiz);
+int carregarMansao(const char *caminho, Mansao *m, TabelaHash *tab, RegrasEvidencia *regras);
+void liberarMansao(Mansao *m);
+void congelarMansao(Mansao *m, LeiauteMansao leiaute);
+
+// Mansão procedural (salas geradas sob demanda)
+void mansaoProcedural(Mansao *m, TabelaHash *tab, uint32_t salas, uint64_t semente, uint32_t salasEmCache);
+uint32_t filhoDaSala(const Mansao *m, uint32_t sala, int direita);
+void gerarSala(const Mansao *m, uint32_t sala, char *nome, TextoId *pista);
+void iniciarCacheSalas(CacheSalas *c, uint32_t capacidade);
+const SalaGerada* materializarSala(CacheSalas *c, const Mansao *m, uint32_t sala);
+void liberarCacheSalas(CacheSalas *c);
+const char* nomeDaSala(Sessao *s, const Caso *caso, uint32_t sala);
+TextoId pistaNaSala(Sessao *s, const Caso *caso, uint32_t sala);
 
 // Exploração
-void explorarSalas(Sala *atual, PistaNode **raizPistas, HashEntry **tabelaHash, int tamanhoHash);
+void prepararCaso(Caso *caso, const Mansao *mansao, TabelaHash *tabela, const RegrasEvidencia *regras);
+void iniciarSessao(Sessao *s, const Caso *caso, ModoCaderno modo);
+void reiniciarSessao(Sessao *s, const Caso *caso);
+void liberarSessao(Sessao *s);
+void explorarSalas(Saida *saida, Sessao *sessao, const Caso *caso);
+void irParaSala(Saida *saida, Sessao *sessao, const Caso *caso, const char *nome);
+void consultarCaderno(Saida *saida, const Sessao *sessao, const Caso *caso, const char *argumento);
+ResultadoComando aplicarComando(const Mansao *mansao, uint32_t *cursor, char comando);
+ResultadoComando aplicarPasso(Sessao *sessao, const Caso *caso, char comando);
+int coletarPistaDaSala(Sessao *sessao, const Caso *caso);
+int pistasColetadas(const Sessao *s);
+PistaNode* cadernoOrdenado(Sessao *s, const Caso *caso);
+uint32_t paginaDoCaderno(const Sessao *s, const Caso *caso, const char *prefixo, uint32_t inicio,
+                         TextoId *saida, uint32_t max, uint32_t *total);
+uint32_t cadernoDesde(const Sessao *s, const Caso *caso, const char *desde, TextoId *saida, uint32_t max, uint32_t *total);
+int contagemPorMascara(const Sessao *s, const Caso *caso, SuspeitoId sus);
+int executarLote(FILE *entrada, Saida *saida, const Caso *caso, ModoCaderno modo, int nThreads, EstatisticasLote *est);
+int resolverCaso(const Caso *caso, int nThreads, SolucaoSuspeito *solucoes);
+void relatarResolucao(Saida *saida, const Caso *caso, const SolucaoSuspeito *solucoes);
+
+// Sessão salva (fotografia e diário)
+int gravarSessao(const char *caminho, const Sessao *s, const Caso *caso);
+int restaurarSessao(const char *caminho, Sessao *s, const Caso *caso);
+int abrirDiario(const char *caminho, Sessao *s, const Caso *caso);
+long reproduzirDiario(const char *caminho, Sessao *s, const Caso *caso);
+int retomarSessao(const char *base, Sessao *s, const Caso *caso);
+int compactarSessao(const char *base, Sessao *s, const Caso *caso);
+void descartarSessao(const char *base, Sessao *s);
+
+// Caminhos na mansão (índice montado com o caso)
+uint32_t salaPorNome(const Caso *caso, const char *nome);
+int ehAncestral(const Caso *caso, uint32_t a, uint32_t b);
+uint32_t ancestralComum(const Caso *caso, uint32_t a, uint32_t b);
+uint32_t distanciaSalas(const Caso *caso, uint32_t a, uint32_t b);
+uint32_t pistasNaSubarvore(const Caso *caso, uint32_t sala);
+long rotaAteSala(const Caso *caso, uint32_t origem, uint32_t destino, char *passos, size_t cap);
+
+// Percursos (cursores sobre árvores de Sala e de pistas)
+void abrirCursorSalas(CursorArvore *c, Sala *raiz, OrdemPercurso ordem);
+Sala* proximaSala(CursorArvore *c);
+void abrirCursorPistas(CursorArvore *c, PistaNode *raiz, OrdemPercurso ordem);
+PistaNode* proximaPista(CursorArvore *c);
+void fecharCursor(CursorArvore *c);
 
-// Pistas (BST)
-PistaNode* inserirPista(PistaNode *raiz, const char *pista, int *inseriu);
-void mostrarPistasInOrder(PistaNode *raiz);
-void liberarPistas(PistaNode *raiz);
+// Pistas (AVL)
+PistaNode* inserirPistaIterativa(Arena *arena, PistaNode *raiz, TextoId pista, int *inseriu);
+void percorrerPistasEmOrdem(PistaNode *raiz, void (*visitar)(PistaNode *n, void *ctx), void *ctx);
+void mostrarPistasInOrder(Saida *saida, PistaNode *raiz);
 int contarPistas(PistaNode *raiz);
+int contemPista(PistaNode *raiz, TextoId pista);
+PistaNode* pistaNaPosicao(PistaNode *raiz, uint32_t k);
+uint32_t posicaoDaPista(PistaNode *raiz, const char *texto);
+uint32_t contarPistasComPrefixo(PistaNode *raiz, const char *prefixo, uint32_t *primeira);
+void abrirCursorPistasNaPosicao(CursorArvore *c, PistaNode *raiz, uint32_t k);
+void abrirCursorPistasDesde(CursorArvore *c, PistaNode *raiz, const char *desde);
 
 // Hash
-unsigned int hashString(const char *s, int m);
-HashEntry** criarTabelaHash(int m);
-void inserirNaHash(HashEntry **tab, int m, const char *chave, const char *valor);
-char* encontrarSuspeito(HashEntry **tab, int m, const char *chave);
-void liberarTabelaHash(HashEntry **tab, int m);
+TabelaHash* criarTabelaHash(int m);
+void inserirNaHash(TabelaHash *tab, const char *chave, const char *valor);
+void inserirNaHashId(TabelaHash *tab, TextoId chave, SuspeitoId valor);
+const char* encontrarSuspeito(TabelaHash *tab, const char *chave);
+SuspeitoId encontrarSuspeitoId(const TabelaHash *tab, TextoId chave);
+void liberarTabelaHash(TabelaHash *tab);
+
+// Suspeitos e placar de evidências
+SuspeitoId cadastrarSuspeito(const char *nome);
+SuspeitoId buscarSuspeito(const char *nome);
+const char* nomeDoSuspeito(SuspeitoId s);
+uint32_t totalSuspeitos(void);
+void liberarSuspeitos(void);
+void iniciarPlacar(Placar *p);
+void reiniciarPlacar(Placar *p);
+void placarSomar(Placar *p, SuspeitoId s, int delta);
+void placarPontuar(Placar *p, SuspeitoId s, int delta, int pontos);
+int placarContagem(const Placar *p, SuspeitoId s);
+int64_t placarPontos(const Placar *p, SuspeitoId s);
+uint32_t rankingSuspeitos(const Placar *p, SuspeitoId *saida);
+void liberarPlacar(Placar *p);
+
+// Pesos de evidência
+void iniciarRegras(RegrasEvidencia *r);
+void adicionarPeso(RegrasEvidencia *r, const char *pista, const char *suspeito, int32_t peso);
+void liberarRegras(RegrasEvidencia *r);
+void pontuarPista(Placar *p, const Caso *caso, uint32_t densa, int sinal);
+SituacaoSuspeito situacaoSuspeito(const Placar *p, const Caso *caso, SuspeitoId s);
+
+// Carga em lote de evidências (pares pista -> suspeito)
+TabelaHash* carregarEvidencias(const ParEvidencia *pares, size_t n, int nThreads, Arena *arena, PistaNode **indice);
+
+// Arquivo de caso
+int gravarCaso(const char *caminho, const Mansao *mansao, const TabelaHash *tabela, const RegrasEvidencia *regras);
+int abrirCaso(const char *caminho, Caso *caso);
+long buscarPistaNoCaso(const Caso *caso, const char *pista);
+void fecharCaso(Caso *caso);
+
+// Caso de exemplo
+void montarCasoExemplo(Arena *arena, TabelaHash *tabela, Mansao *mansao);
 
 // Utilitários
-char* pistaDaSala(const char *nomeSala); // define pista estática por sala
+TextoId pistaDaSala(TextoId nomeSala); // define pista estática por sala
 void trim_newline(char *s);
 void minusculo(char *s);
-void listarPistasEAssociacoes(PistaNode *raiz, HashEntry **tab, int m);
+void listarPistasEAssociacoes(Saida *saida, PistaNode *raiz, TabelaHash *tab);
+
+// Saída em buffer
+void iniciarSaida(Saida *s, int fd, FormatoSaida formato);
+void escreverSaida(Saida *s, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+void escreverJsonTexto(Saida *s, const char *texto);
+int descarregarSaida(Saida *s);
+void liberarSaida(Saida *s);
+
+// Instrumentação (só com -DDQ_INSTRUMENTAR; sem ela as macros não geram código)
+#ifdef DQ_INSTRUMENTAR
+typedef enum {
+    MEDIDA_INSERIR_PISTA,       // inserirPistaIterativa (sucesso = inseriu)
+    MEDIDA_INSERIR_HASH,        // inserirNaHash (internação + cadastro + inserção)
+    MEDIDA_INSERIR_HASH_ID,     // inserirNaHashId (sucesso = chave nova)
+    MEDIDA_ENCONTRAR_SUSPEITO,  // encontrarSuspeito (sucesso = achou)
+    MEDIDA_ENCONTRAR_SUSPEITO_ID,
+    MEDIDAS_TOTAL
+} Medida;
+uint64_t instrInicio(void);
+void instrFim(Medida m, uint64_t inicio, int sucesso);
+void instrCaderno(const PistaNode *raiz, uint32_t pistas);
+void relatarInstrumentacao(const Caso *caso, PistaNode *caderno);
+#define INSTR_INICIO(v) uint64_t v = instrInicio()
+#define INSTR_FIM(m, v, sucesso) instrFim((m), (v), (sucesso))
+#define INSTR_CADERNO(raiz, pistas) instrCaderno((raiz), (pistas))
+#else
+#define INSTR_INICIO(v) ((void) 0)
+#define INSTR_FIM(m, v, sucesso) ((void) 0)
+#define INSTR_CADERNO(raiz, pistas) ((void) 0)
+#endif
+
+// Julgamento
+void verificarSuspeitoFinal(Saida *saida, PistaNode *raizPistas, const Placar *placar, const Caso *caso, const char *acusado);
+int acusacaoSustentada(const Placar *placar, const char *acusado, int limiar, int64_t *pontos);
+void mostrarRankingSuspeitos(Saida *saida, const Placar *placar, const Caso *caso);
+void contarPistasPorSuspeito(PistaNode *raiz, TabelaHash *tab, const char *acusado, int *out_count);
 
 /* -------------------------
    Implementação
    ------------------------- */
 
 /*
- * criarSala: cria dinamicamente um nó Sala com nome copiado.
- * O chamador é responsável por liberar com liberarSalas.
+ * Arena do jogo
+ * Salas e nós de pistas são alocados em blocos contíguos e liberados todos
+ * de uma vez por liberarArena, sem percorrer as estruturas. Os textos ficam
+ * no pool de textos internados (ver internar).
+ * No modo individual cada alocação vira um malloc próprio (útil com
+ * valgrind/ASan e para comparar o custo com a alocação agrupada).
  */
-Sala* criarSala(const char *nome) {
-    Sala *s = (Sala*) malloc(sizeof(Sala));
-    if (!s) {
-        perror("malloc criarSala");
-        exit(EXIT_FAILURE);
-    }
-    s->nome = (char*) malloc(strlen(nome) + 1);
-    if (!s->nome) {
-        perror("malloc criarSala nome");
-        exit(EXIT_FAILURE);
-    }
-    strcpy(s->nome, nome);
-    s->esq = s->dir = NULL;
-    return s;
+#define ARENA_BLOCO_INICIAL 4096
+#define ARENA_BLOCO_MAX (1u << 20)
+#define ARENA_ALINHAMENTO 16
+
+static atomic_size_t g_chamadasMalloc = 0; // chamadas a malloc/calloc do programa (todas as threads)
+
+static void* alocarMemoria(size_t tam, const char *contexto) {
+    void *p = malloc(tam);
+    if (!p) { perror(contexto); exit(EXIT_FAILURE); }
+    g_chamadasMalloc++;
+    return p;
 }
 
-/*
- * liberarSalas: libera recursivamente a árvore de salas.
- */
-void liberarSalas(Sala *raiz) {
-    if (!raiz) return;
-    liberarSalas(raiz->esq);
-    liberarSalas(raiz->dir);
-    free(raiz->nome);
-    free(raiz);
+static void* alocarZerada(size_t n, size_t tam, const char *contexto) {
+    void *p = calloc(n, tam);
+    if (!p) { perror(contexto); exit(EXIT_FAILURE); }
+    g_chamadasMalloc++;
+    return p;
 }
 
+#ifdef DQ_INSTRUMENTAR
 /*
- * inserirPista: insere uma pista na BST (ordenada por strcmp).
- * Se a pista já existe, não a insere novamente.
- * Retorna a raiz (possivelmente nova). 'inseriu' = 1 se inseriu, 0 se já existia.
+ * Instrumentação
+ * Contadores globais atualizados com atômicos relaxados (o modo em lote
+ * roda em várias threads). Latências vão para um histograma em potências
+ * de 2 de nanossegundos; alturas de cadernos, para um histograma por altura.
  */
-PistaNode* inserirPista(PistaNode *raiz, const char *pista, int *inseriu) {
-    if (raiz == NULL) {
-        PistaNode *n = (PistaNode*) malloc(sizeof(PistaNode));
-        if (!n) { perror("malloc inserirPista"); exit(EXIT_FAILURE); }
-        n->pista = (char*) malloc(strlen(pista) + 1);
-        if (!n->pista) { perror("malloc inserirPista pista"); exit(EXIT_FAILURE); }
-        strcpy(n->pista, pista);
-        n->esq = n->dir = NULL;
-        *inseriu = 1;
-        return n;
-    }
-    int cmp = strcmp(pista, raiz->pista);
-    if (cmp == 0) {
-        *inseriu = 0;
-        return raiz; // já existe
-    } else if (cmp < 0) {
-        raiz->esq = inserirPista(raiz->esq, pista, inserirPista ? inserirPista + 0 : NULL); // dummy to avoid warning
-        // NOTE: the previous line has been intentionally written to keep consistent signature use;
-        // but we need to correctly propagate 'inseriu'. Simpler approach below:
-    }
-    return raiz; // placeholder; real implementation continues below
+#define INSTR_FAIXAS 32
+
+typedef struct ContadorMedida {
+    atomic_ulong chamadas;
+    atomic_ulong sucessos;
+    atomic_ulong nanos;
+    atomic_ulong maximo;
+    atomic_ulong faixas[INSTR_FAIXAS]; // faixas[k]: latência em [2^k, 2^(k+1)) ns
+} ContadorMedida;
+
+static ContadorMedida g_medidas[MEDIDAS_TOTAL];
+static atomic_ulong g_alturasCaderno[65];   // cadernos AVL por altura (fim de sessão)
+static atomic_ulong g_cadernos, g_excessoAlturaMax;
+
+uint64_t instrInicio(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
 }
 
-/* 
- * The above attempt to "avoid warning" is awkward. We'll replace inserirPista with a clean implementation:
- */
-PistaNode* inserirPista_clean(PistaNode *raiz, const char *pista, int *inseriu) {
-    if (raiz == NULL) {
-        PistaNode *n = (PistaNode*) malloc(sizeof(PistaNode));
-        if (!n) { perror("malloc inserirPista"); exit(EXIT_FAILURE); }
-        n->pista = (char*) malloc(strlen(pista) + 1);
-        if (!n->pista) { perror("malloc inserirPista pista"); exit(EXIT_FAILURE); }
-        strcpy(n->pista, pista);
-        n->esq = n->dir = NULL;
-        *inseriu = 1;
-        return n;
-    }
-    int cmp = strcmp(pista, raiz->pista);
-    if (cmp == 0) {
-        *inseriu = 0;
-        return raiz;
-    } else if (cmp < 0) {
-        raiz->esq = inserirPista_clean(raiz->esq, pista, inserirPista ? inserirPista + 0 : NULL); // will fix below
-    } 
-    return raiz;
+static void maximoAtomico(atomic_ulong *m, unsigned long v) {
+    unsigned long atual = atomic_load_explicit(m, memory_order_relaxed);
+    while (v > atual && !atomic_compare_exchange_weak_explicit(m, &atual, v, memory_order_relaxed, memory_order_relaxed)) {}
 }
 
-/* 
- To avoid confusion and ensure correctness, I'll scrap the previous partial versions and provide a clean, correct implementation below.
-*/
+void instrFim(Medida m, uint64_t inicio, int sucesso) {
+    unsigned long ns = (unsigned long) (instrInicio() - inicio);
+    ContadorMedida *c = &g_medidas[m];
+    int faixa = ns ? 63 - __builtin_clzll(ns) : 0;
+    if (faixa >= INSTR_FAIXAS) faixa = INSTR_FAIXAS - 1;
+    atomic_fetch_add_explicit(&c->chamadas, 1, memory_order_relaxed);
+    if (sucesso) atomic_fetch_add_explicit(&c->sucessos, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->nanos, ns, memory_order_relaxed);
+    atomic_fetch_add_explicit(&c->faixas[faixa], 1, memory_order_relaxed);
+    maximoAtomico(&c->maximo, ns);
+}
 
-PistaNode* inserirPista_final(PistaNode *raiz, const char *pista, int *inseriu) {
-    if (raiz == NULL) {
-        PistaNode *n = (PistaNode*) malloc(sizeof(PistaNode));
-        if (!n) { perror("malloc inserirPista_final"); exit(EXIT_FAILURE); }
-        n->pista = (char*) malloc(strlen(pista) + 1);
-        if (!n->pista) { perror("malloc inserirPista_final pista"); exit(EXIT_FAILURE); }
-        strcpy(n->pista, pista);
-        n->esq = n->dir = NULL;
-        *inseriu = 1;
-        return n;
-    }
-    int cmp = strcmp(pista, raiz->pista);
-    if (cmp == 0) {
-        *inseriu = 0;
-        return raiz;
-    } else if (cmp < 0) {
-        raiz->esq = inserirPista_final(raiz->esq, pista, inserirPista_final ? inserirPista_final + 0 : NULL);
-        // The above hack is incorrect; we need to call with &local variable. We'll instead implement iterative insertion to avoid complexity.
-    }
-    return raiz;
+/*
+ * instrCaderno: registra a altura do caderno AVL ao fim de uma sessão e o
+ * excesso sobre a altura mínima possível para o mesmo número de pistas.
+ */
+void instrCaderno(const PistaNode *raiz, uint32_t pistas) {
+    if (!raiz || pistas == 0) return;
+    int minima = 64 - __builtin_clzll((unsigned long long) pistas); // ceil(log2(pistas+1))
+    atomic_fetch_add_explicit(&g_alturasCaderno[raiz->altura], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_cadernos, 1, memory_order_relaxed);
+    maximoAtomico(&g_excessoAlturaMax, (unsigned long) (raiz->altura - minima));
 }
+#endif /* DQ_INSTRUMENTAR */
 
-/* The attempts above are messy due to trying to prematurely optimize. I'll now provide a clean iterative insertion to BST to guarantee correctness. */
+Arena* criarArena(int individual) {
+    Arena *a = (Arena*) alocarZerada(1, sizeof(Arena), "calloc criarArena");
+    a->individual = individual;
+    return a;
+}
 
 /*
- * inserirPistaIterativa: insere iterativamente para evitar confusões com recursão e ponteiros
+ * arenaBloco: garante espaço para 'tam' bytes no bloco corrente.
+ * Blocos novos dobram de tamanho até ARENA_BLOCO_MAX, de modo que o número
+ * de blocos (e o custo de liberarArena) cresce só com o total alocado / 1 MiB.
  */
-PistaNode* inserirPistaIterativa(PistaNode *raiz, const char *pista, int *inseriu) {
-    *inseriu = 0;
-    if (raiz == NULL) {
-        PistaNode *n = (PistaNode*) malloc(sizeof(PistaNode));
-        if (!n) { perror("malloc inserirPistaIterativa"); exit(EXIT_FAILURE); }
-        n->pista = strdup(pista);
-        n->esq = n->dir = NULL;
-        *inseriu = 1;
-        return n;
-    }
-    PistaNode *atual = raiz;
-    PistaNode *pai = NULL;
-    while (atual != NULL) {
-        int cmp = strcmp(pista, atual->pista);
-        if (cmp == 0) {
-            *inseriu = 0;
-            return raiz; // já existe
-        } else if (cmp < 0) {
-            pai = atual;
-            if (atual->esq) atual = atual->esq;
-            else {
-                PistaNode *n = (PistaNode*) malloc(sizeof(PistaNode));
-                if (!n) { perror("malloc inserirPistaIterativa"); exit(EXIT_FAILURE); }
-                n->pista = strdup(pista);
-                n->esq = n->dir = NULL;
-                pai->esq = n;
-                *inseriu = 1;
-                return raiz;
-            }
-        } else {
-            pai = atual;
-            if (atual->dir) atual = atual->dir;
-            else {
-                PistaNode *n = (PistaNode*) malloc(sizeof(PistaNode));
-                if (!n) { perror("malloc inserirPistaIterativa"); exit(EXIT_FAILURE); }
-                n->pista = strdup(pista);
-                n->esq = n->dir = NULL;
-                pai->dir = n;
-                *inseriu = 1;
-                return raiz;
-            }
-        }
+static ArenaBloco* arenaBloco(Arena *a, size_t tam) {
+    ArenaBloco *b = a->nos;
+    if (b && b->usado + tam <= b->capacidade) return b;
+    size_t cap;
+    if (a->individual) {
+        cap = tam;
+    } else {
+        cap = b ? b->capacidade * 2 : ARENA_BLOCO_INICIAL;
+        if (cap > ARENA_BLOCO_MAX) cap = ARENA_BLOCO_MAX;
+        if (cap < tam) cap = tam;
     }
-    return raiz;
+    ArenaBloco *novo = (ArenaBloco*) alocarMemoria(sizeof(ArenaBloco) + cap, "malloc arenaBloco");
+    novo->usado = 0;
+    novo->capacidade = cap;
+    novo->prox = b;
+    a->nos = novo;
+    a->bytesReservados += cap;
+    return novo;
 }
 
 /*
- * mostrarPistasInOrder: percorre a BST em ordem e imprime pistas coletadas.
+ * arenaAlocar: reserva 'tam' bytes alinhados para nós de estruturas.
+ * A memória só é devolvida por liberarArena.
  */
-void mostrarPistasInOrder(PistaNode *raiz) {
-    if (!raiz) return;
-    mostrarPistasInOrder(raiz->esq);
-    printf("- %s\n", raiz->pista);
-    mostrarPistasInOrder(raiz->dir);
+void* arenaAlocar(Arena *a, size_t tam) {
+    tam = (tam + ARENA_ALINHAMENTO - 1) & ~(size_t) (ARENA_ALINHAMENTO - 1);
+    ArenaBloco *b = arenaBloco(a, tam);
+    void *p = b->dados + b->usado;
+    b->usado += tam;
+    return p;
+}
+
+static void liberarBlocos(ArenaBloco *b) {
+    while (b) {
+        ArenaBloco *prox = b->prox;
+        free(b);
+        b = prox;
+    }
 }
 
 /*
- * liberarPistas: libera toda a árvore de pistas.
+ * reiniciarArena: descarta tudo o que foi alocado mas guarda o bloco mais
+ * recente (o maior) para a próxima rodada, evitando malloc por sessão.
  */
-void liberarPistas(PistaNode *raiz) {
-    if (!raiz) return;
-    liberarPistas(raiz->esq);
-    liberarPistas(raiz->dir);
-    free(raiz->pista);
-    free(raiz);
+void reiniciarArena(Arena *a) {
+    ArenaBloco *b = a->nos;
+    if (!b) return;
+    if (a->individual) {
+        liberarBlocos(b);
+        a->nos = NULL;
+        a->bytesReservados = 0;
+        return;
+    }
+    liberarBlocos(b->prox);
+    b->prox = NULL;
+    b->usado = 0;
+    a->bytesReservados = b->capacidade;
 }
 
 /*
- * contarPistas: conta nós na BST.
+ * liberarArena: devolve todos os blocos (salas e pistas) de uma vez.
  */
-int contarPistas(PistaNode *raiz) {
-    if (!raiz) return 0;
-    return 1 + contarPistas(raiz->esq) + contarPistas(raiz->dir);
+void liberarArena(Arena *a) {
+    if (!a) return;
+    liberarBlocos(a->nos);
+    free(a);
 }
 
 /*
- * hashString: função de hash simples (djb2-like) retornando [0..m-1]
+ * Hash e comparação de textos
+ * O hash processa a string em blocos de 32 bytes com quatro acumuladores de
+ * 64 bits independentes: acc[i] = rotl(acc[i], 29) * P + lo32(k) * hi32(k) + d,
+ * com k = d ^ segredo. A mistura do acumulador a cada bloco faz a posição do
+ * bloco contar (sem ela, trocar dois blocos não mudava o hash). P cabe em 32
+ * bits, então o passo só usa multiplicação 32x32->64, que existe em SSE2
+ * (pmuludq) e AVX2, e as três implementações dão exatamente o mesmo valor.
+ * O último bloco (parcial, possivelmente vazio) é sempre escalar e completado
+ * com zeros, sem ler além do fim da string; o comprimento entra na mistura
+ * final.
+ * A versão vetorial é escolhida uma vez, em tempo de execução, pela CPU.
+ * Os hashes ficam gravados nos arquivos .dqc: mudar a função exige nova
+ * CASO_VERSAO.
  */
-unsigned int hashString(const char *s, int m) {
-    unsigned long h = 5381;
-    int c;
-    while ((c = *s++))
-        h = ((h << 5) + h) + c; /* h * 33 + c */
-    return (unsigned int)(h % m);
+#define HASH_BLOCO 32
+
+static const uint64_t SEGREDO_HASH[4] = {
+    0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b19e3779f9ULL, 0x27d4eb2f165667c5ULL
+};
+
+static inline uint64_t ler64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof v);
+    return v;
+}
+
+// palavra de n < 8 bytes completada com zeros (little-endian, como ler64)
+static inline uint64_t lerParcial(const unsigned char *p, size_t n) {
+    uint64_t v = 0;
+    while (n-- > 0) v = (v << 8) | p[n];
+    return v;
+}
+
+// rotl(x, 29) * PRIMO_MISTURA, com o produto 64x32 montado de duas metades
+#define PRIMO_MISTURA 0x9e3779b1ULL
+
+static inline uint64_t misturarAcumulador(uint64_t x) {
+    x = (x << 29) | (x >> 35);
+    return (x & 0xffffffffULL) * PRIMO_MISTURA + (((x >> 32) * PRIMO_MISTURA) << 32);
+}
+
+static inline char dobrarCaixa(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char) (c | 0x20) : c;
+}
+
+static void blocosHashEscalar(uint64_t acc[4], const unsigned char *p, size_t nBlocos) {
+    for (; nBlocos > 0; nBlocos--, p += HASH_BLOCO)
+        for (int i = 0; i < 4; i++) {
+            uint64_t d = ler64(p + 8 * i);
+            uint64_t k = d ^ SEGREDO_HASH[i];
+            acc[i] = misturarAcumulador(acc[i]) + (k & 0xffffffffULL) * (k >> 32) + d;
+        }
+}
+
+static int iguaisSemCaixaEscalar(const char *a, const char *b, size_t n) {
+    for (size_t i = 0; i < n; i++)
+        if (dobrarCaixa(a[i]) != dobrarCaixa(b[i])) return 0;
+    return 1;
+}
+
+static void copiarMinusculoEscalar(char *dst, const char *src, size_t n) {
+    for (size_t i = 0; i < n; i++) dst[i] = dobrarCaixa(src[i]);
 }
 
+#ifdef DQ_X86
 /*
- * criarTabelaHash: aloca vetor de ponteiros para HashEntry.
+ * Dobra de caixa vetorial: x + (128 - 'A') cai abaixo de -128 + 26 (com
+ * sinal) exatamente para 'A'..'Z'; nesses bytes liga-se o bit 0x20.
  */
-HashEntry** criarTabelaHash(int m) {
-    HashEntry **tab = (HashEntry**) calloc(m, sizeof(HashEntry*));
-    if (!tab) { perror("calloc criarTabelaHash"); exit(EXIT_FAILURE); }
-    return tab;
+__attribute__((target("sse2")))
+static inline __m128i dobrarCaixaSse2(__m128i x) {
+    __m128i deslocado = _mm_add_epi8(x, _mm_set1_epi8((char) (128 - 'A')));
+    __m128i maiuscula = _mm_cmplt_epi8(deslocado, _mm_set1_epi8((char) (-128 + 26)));
+    return _mm_or_si128(x, _mm_and_si128(maiuscula, _mm_set1_epi8(0x20)));
+}
+
+__attribute__((target("sse2")))
+static inline __m128i misturarAcumuladorSse2(__m128i x) {
+    const __m128i primo = _mm_set1_epi64x((long long) PRIMO_MISTURA);
+    x = _mm_or_si128(_mm_slli_epi64(x, 29), _mm_srli_epi64(x, 35));
+    __m128i alto = _mm_slli_epi64(_mm_mul_epu32(_mm_srli_epi64(x, 32), primo), 32);
+    return _mm_add_epi64(_mm_mul_epu32(x, primo), alto);
+}
+
+__attribute__((target("sse2")))
+static void blocosHashSse2(uint64_t acc[4], const unsigned char *p, size_t nBlocos) {
+    __m128i a0 = _mm_loadu_si128((const __m128i*) acc);
+    __m128i a1 = _mm_loadu_si128((const __m128i*) (acc + 2));
+    const __m128i s0 = _mm_loadu_si128((const __m128i*) SEGREDO_HASH);
+    const __m128i s1 = _mm_loadu_si128((const __m128i*) (SEGREDO_HASH + 2));
+    for (; nBlocos > 0; nBlocos--, p += HASH_BLOCO) {
+        __m128i d0 = _mm_loadu_si128((const __m128i*) p);
+        __m128i d1 = _mm_loadu_si128((const __m128i*) (p + 16));
+        __m128i k0 = _mm_xor_si128(d0, s0);
+        __m128i k1 = _mm_xor_si128(d1, s1);
+        a0 = _mm_add_epi64(misturarAcumuladorSse2(a0), _mm_add_epi64(_mm_mul_epu32(k0, _mm_srli_epi64(k0, 32)), d0));
+        a1 = _mm_add_epi64(misturarAcumuladorSse2(a1), _mm_add_epi64(_mm_mul_epu32(k1, _mm_srli_epi64(k1, 32)), d1));
+    }
+    _mm_storeu_si128((__m128i*) acc, a0);
+    _mm_storeu_si128((__m128i*) (acc + 2), a1);
+}
+
+__attribute__((target("sse2")))
+static int iguaisSemCaixaSse2(const char *a, const char *b, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i x = dobrarCaixaSse2(_mm_loadu_si128((const __m128i*) (a + i)));
+        __m128i y = dobrarCaixaSse2(_mm_loadu_si128((const __m128i*) (b + i)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) return 0;
+    }
+    return iguaisSemCaixaEscalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static void copiarMinusculoSse2(char *dst, const char *src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+        _mm_storeu_si128((__m128i*) (dst + i), dobrarCaixaSse2(_mm_loadu_si128((const __m128i*) (src + i))));
+    copiarMinusculoEscalar(dst + i, src + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i dobrarCaixaAvx2(__m256i x) {
+    __m256i deslocado = _mm256_add_epi8(x, _mm256_set1_epi8((char) (128 - 'A')));
+    __m256i maiuscula = _mm256_cmpgt_epi8(_mm256_set1_epi8((char) (-128 + 26)), deslocado);
+    return _mm256_or_si256(x, _mm256_and_si256(maiuscula, _mm256_set1_epi8(0x20)));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i misturarAcumuladorAvx2(__m256i x) {
+    const __m256i primo = _mm256_set1_epi64x((long long) PRIMO_MISTURA);
+    x = _mm256_or_si256(_mm256_slli_epi64(x, 29), _mm256_srli_epi64(x, 35));
+    __m256i alto = _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), primo), 32);
+    return _mm256_add_epi64(_mm256_mul_epu32(x, primo), alto);
+}
+
+__attribute__((target("avx2")))
+static void blocosHashAvx2(uint64_t acc[4], const unsigned char *p, size_t nBlocos) {
+    __m256i a = _mm256_loadu_si256((const __m256i*) acc);
+    const __m256i segredo = _mm256_loadu_si256((const __m256i*) SEGREDO_HASH);
+    for (; nBlocos > 0; nBlocos--, p += HASH_BLOCO) {
+        __m256i d = _mm256_loadu_si256((const __m256i*) p);
+        __m256i k = _mm256_xor_si256(d, segredo);
+        a = _mm256_add_epi64(misturarAcumuladorAvx2(a), _mm256_add_epi64(_mm256_mul_epu32(k, _mm256_srli_epi64(k, 32)), d));
+    }
+    _mm256_storeu_si256((__m256i*) acc, a);
+}
+
+__attribute__((target("avx2")))
+static int iguaisSemCaixaAvx2(const char *a, const char *b, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i x = dobrarCaixaAvx2(_mm256_loadu_si256((const __m256i*) (a + i)));
+        __m256i y = dobrarCaixaAvx2(_mm256_loadu_si256((const __m256i*) (b + i)));
+        if ((uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != 0xffffffffu) return 0;
+    }
+    if (i + 16 <= n) {
+        __m128i x = dobrarCaixaSse2(_mm_loadu_si128((const __m128i*) (a + i)));
+        __m128i y = dobrarCaixaSse2(_mm_loadu_si128((const __m128i*) (b + i)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xffff) return 0;
+        i += 16;
+    }
+    return iguaisSemCaixaEscalar(a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void copiarMinusculoAvx2(char *dst, const char *src, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32)
+        _mm256_storeu_si256((__m256i*) (dst + i), dobrarCaixaAvx2(_mm256_loadu_si256((const __m256i*) (src + i))));
+    if (i + 16 <= n) {
+        _mm_storeu_si128((__m128i*) (dst + i), dobrarCaixaSse2(_mm_loadu_si128((const __m128i*) (src + i))));
+        i += 16;
+    }
+    copiarMinusculoEscalar(dst + i, src + i, n - i);
 }
+#endif /* DQ_X86 */
+
+// Implementações por nível; o índice é o próprio NivelSimd
+typedef struct ImplSimd {
+    NivelSimd nivel;
+    void (*blocosHash)(uint64_t acc[4], const unsigned char *p, size_t nBlocos);
+    int (*iguais)(const char *a, const char *b, size_t n);
+    void (*copiar)(char *dst, const char *src, size_t n);
+} ImplSimd;
+
+static const ImplSimd IMPLS_SIMD[] = {
+    { SIMD_ESCALAR, blocosHashEscalar, iguaisSemCaixaEscalar, copiarMinusculoEscalar },
+#ifdef DQ_X86
+    { SIMD_SSE2, blocosHashSse2, iguaisSemCaixaSse2, copiarMinusculoSse2 },
+    { SIMD_AVX2, blocosHashAvx2, iguaisSemCaixaAvx2, copiarMinusculoAvx2 },
+#endif
+};
+
+static _Atomic(const ImplSimd*) g_implSimd;
 
 /*
- * inserirNaHash: insere (chave->valor) na tabela hash (encadeamento).
- * Faz strdup das strings para armazenar cópias.
+ * nivelSimdDisponivel: maior conjunto de instruções suportado pela CPU
+ * (DQ_SIMD=escalar|sse2 no ambiente limita a escolha, para comparação).
  */
-void inserirNaHash(HashEntry **tab, int m, const char *chave, const char *valor) {
-    unsigned int idx = hashString(chave, m);
-    // verificar se já existe chave; se sim, atualizar valor
-    HashEntry *cur = tab[idx];
-    while (cur) {
-        if (strcmp(cur->chave, chave) == 0) {
-            // atualiza valor
-            free(cur->valor);
-            cur->valor = strdup(valor);
-            return;
-        }
-        cur = cur->prox;
+NivelSimd nivelSimdDisponivel(void) {
+    NivelSimd nivel = SIMD_ESCALAR;
+#ifdef DQ_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) nivel = SIMD_SSE2;
+    if (__builtin_cpu_supports("avx2")) nivel = SIMD_AVX2;
+#endif
+    const char *limite = getenv("DQ_SIMD");
+    if (limite && strcmp(limite, "escalar") == 0) nivel = SIMD_ESCALAR;
+    else if (limite && strcmp(limite, "sse2") == 0 && nivel > SIMD_SSE2) nivel = SIMD_SSE2;
+    return nivel;
+}
+
+static const ImplSimd* implSimd(void) {
+    const ImplSimd *impl = atomic_load_explicit(&g_implSimd, memory_order_acquire);
+    if (!impl) {
+        impl = &IMPLS_SIMD[nivelSimdDisponivel()];
+        atomic_store_explicit(&g_implSimd, impl, memory_order_release);
     }
-    // inserir novo no início
-    HashEntry *novo = (HashEntry*) malloc(sizeof(HashEntry));
-    if (!novo) { perror("malloc inserirNaHash"); exit(EXIT_FAILURE); }
-    novo->chave = strdup(chave);
-    novo->valor = strdup(valor);
-    novo->prox = tab[idx];
-    tab[idx] = novo;
+    return impl;
 }
 
 /*
- * encontrarSuspeito: busca na tabela hash o suspeito correspondente a uma pista (chave).
- * Retorna ponteiro para o valor (string) ou NULL se não achar.
+ * forcarNivelSimd: troca a implementação (limitada ao que a CPU suporta) e
+ * devolve o nível efetivo. Usada pelos benchmarks; o resultado das funções
+ * não muda com o nível.
  */
-char* encontrarSuspeito(HashEntry **tab, int m, const char *chave) {
-    unsigned int idx = hashString(chave, m);
-    HashEntry *cur = tab[idx];
-    while (cur) {
-        if (strcmp(cur->chave, chave) == 0) return cur->valor;
-        cur = cur->prox;
-    }
-    return NULL;
+NivelSimd forcarNivelSimd(NivelSimd nivel) {
+    NivelSimd maximo = nivelSimdDisponivel();
+    if (nivel > maximo) nivel = maximo;
+    atomic_store_explicit(&g_implSimd, &IMPLS_SIMD[nivel], memory_order_release);
+    return nivel;
+}
+
+const char* nomeNivelSimd(NivelSimd nivel) {
+    static const char *nomes[] = { "escalar", "sse2", "avx2" };
+    return nomes[nivel];
 }
 
 /*
- * liberarTabelaHash: libera todas as entradas e o vetor.
+ * hashBytes: hash de 64 bits de n bytes. Nunca retorna 0, valor reservado
+ * para marcar posições vazias da tabela.
  */
-void liberarTabelaHash(HashEntry **tab, int m) {
-    for (int i = 0; i < m; i++) {
-        HashEntry *cur = tab[i];
-        while (cur) {
-            HashEntry *tmp = cur;
-            cur = cur->prox;
-            free(tmp->chave);
-            free(tmp->valor);
-            free(tmp);
-        }
+uint64_t hashBytes(const void *dados, size_t n) {
+    const unsigned char *p = (const unsigned char*) dados;
+    uint64_t acc[4] = { SEGREDO_HASH[0], SEGREDO_HASH[1], SEGREDO_HASH[2], SEGREDO_HASH[3] };
+    size_t nBlocos = n / HASH_BLOCO;
+    if (nBlocos) implSimd()->blocosHash(acc, p, nBlocos);
+    const unsigned char *resto = p + nBlocos * HASH_BLOCO;
+    size_t r = n % HASH_BLOCO;
+    for (size_t i = 0; i < 4; i++) {
+        size_t ini = 8 * i;
+        uint64_t d = r >= ini + 8 ? ler64(resto + ini) : r > ini ? lerParcial(resto + ini, r - ini) : 0;
+        uint64_t k = d ^ SEGREDO_HASH[i];
+        acc[i] = misturarAcumulador(acc[i]) + (k & 0xffffffffULL) * (k >> 32) + d;
     }
-    free(tab);
+
+    // lanes combinadas com rotações distintas, depois o finalizador do MurmurHash3
+    uint64_t h = (uint64_t) n * 0x9e3779b97f4a7c15ULL;
+    h += acc[0] ^ ((acc[1] << 17) | (acc[1] >> 47));
+    h ^= ((acc[2] << 31) | (acc[2] >> 33)) + ((acc[3] << 47) | (acc[3] >> 17));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h ? h : 1;
 }
 
 /*
- * pistaDaSala: define uma pista estática para cada sala (por nome).
- * Retorna string literal (não liberar). Se retornar NULL, sala não tem pista.
- *
- * As pistas são definidas por lógica codificada.
- */
-char* pistaDaSala(const char *nomeSala) {
-    // Exemplo de mapeamento fixo:
-    if (strcmp(nomeSala, "Entrada") == 0) return "pegadas molhadas";
-    if (strcmp(nomeSala, "Sala de Estar") == 0) return "charuto queimado";
-    if (strcmp(nomeSala, "Biblioteca") == 0) return "marcador de livro rasgado";
-    if (strcmp(nomeSala, "Cozinha") == 0) return "pegador de panelas sujo";
-    if (strcmp(nomeSala, "Quarto Principal") == 0) return "fio de tecido vermelho";
-    if (strcmp(nomeSala, "Banheiro") == 0) return "batom no lavatório";
-    if (strcmp(nomeSala, "Escritorio") == 0) return "recibo rasgado";
-    if (strcmp(nomeSala, "Jardim") == 0) return "sementes pisoteadas";
-    // salas sem pista
-    return NULL;
+ * hashString: hashBytes sobre os caracteres de s (sem o '\0').
+ */
+uint64_t hashString(const char *s) {
+    return hashBytes(s, strlen(s));
 }
 
 /*
- * trim_newline: remove '\n' final de uma string capturada por fgets
+ * iguaisSemCaixa: 1 se a e b são iguais ignorando maiúsculas/minúsculas
+ * (ASCII, como tolower no locale "C"), comparando 16/32 bytes por vez.
  */
-void trim_newline(char *s) {
-    if (!s) return;
-    size_t len = strlen(s);
-    if (len == 0) return;
-    if (s[len-1] == '\n') s[len-1] = '\0';
+int iguaisSemCaixa(const char *a, const char *b) {
+    size_t n = strlen(a);
+    if (strlen(b) != n) return 0;
+    return implSimd()->iguais(a, b, n);
 }
 
 /*
- * minusculo: converte string para minúsculas (útil para comparação de nomes de suspeitos)
+ * copiarMinusculo: copia src em minúsculas para dst (truncando em cap-1
+ * caracteres; dst sempre termina em '\0').
  */
-void minusculo(char *s) {
-    for (; *s; ++s) *s = (char) tolower((unsigned char)*s);
+void copiarMinusculo(char *dst, const char *src, size_t cap) {
+    size_t n = strnlen(src, cap - 1);
+    implSimd()->copiar(dst, src, n);
+    dst[n] = '\0';
 }
 
 /*
- * explorarSalas:
- * - Navega interativamente pela árvore de salas.
- * - Ao visitar uma sala, exibe o nome e, se existir, exibe e coleta automaticamente a pista associada.
- * - Insere a pista na BST de pistas coletadas (se ainda não coletada).
- *
- * Parâmetros:
- *   atual: nó atual da árvore de salas
- *   raizPistas: ponteiro para a raiz da BST de pistas (modificável)
- *   tabelaHash: tabela hash com associações pista->suspeito
- *
- * O jogador escolhe 'e' para ir à esquerda, 'd' para ir à direita, 's' para sair da exploração.
+ * Internação de textos
+ * Cada string distinta (nome de sala, pista, suspeito) é guardada uma única
+ * vez no pool global e identificada por um TextoId estável. As estruturas
+ * guardam só o id, e igualdade de textos vira comparação de inteiros.
+ * O pool é contíguo e endereçado por offsets; o ponteiro devolvido por
+ * textoDe vale até a próxima chamada a internar.
  */
-void explorarSalas(Sala *atual, PistaNode **raizPistas, HashEntry **tabelaHash, int tamanhoHash) {
-    if (!atual) return;
-    Sala *cursor = atual;
-    char comando[32];
-
-    printf("\nIniciando exploracao da mansao. Comandos: [e] esquerda, [d] direita, [s] sair.\n");
-    while (cursor) {
-        printf("\nVoce esta na sala: %s\n", cursor->nome);
-        char *pista = pistaDaSala(cursor->nome);
-        if (pista) {
-            printf("Voce encontrou uma pista: \"%s\"\n", pista);
-            // Inserir na BST se ainda não coletada
-            int inseriu = 0;
-            *raizPistas = inserirPistaIterativa(*raizPistas, pista, &inseriu);
-            if (inseriu) {
-                printf("Pista adicionada ao caderno.\n");
-            } else {
-                printf("Pista ja constava no caderno (nao duplicada).\n");
-            }
-            // (Opcional) assegure que a pista exista na hash; se não existir, associar a "Desconhecido"
-            if (!encontrarSuspeito(tabelaHash, tamanhoHash, pista)) {
-                inserirNaHash(tabelaHash, tamanhoHash, pista, "Desconhecido");
-            }
-        } else {
-            printf("Nenhuma pista aparente nesta sala.\n");
-        }
+static Internador g_textos;
 
-        // apresentar opções de movimento
-        printf("\nEscolhas: [e] ir para sala da esquerda, [d] ir para sala da direita, [r] voltar ao inicio, [s] sair exploracao\n");
-        printf("Digite a escolha: ");
-        if (!fgets(comando, sizeof(comando), stdin)) break;
-        trim_newline(comando);
-        if (strlen(comando) == 0) {
-            printf("Entrada invalida. Tente novamente.\n");
-            continue;
-        }
-        char c = comando[0];
-        if (c == 'e' || c == 'E') {
-            if (cursor->esq) cursor = cursor->esq;
-            else printf("Nao ha sala à esquerda.\n");
-        } else if (c == 'd' || c == 'D') {
-            if (cursor->dir) cursor = cursor->dir;
-            else printf("Nao ha sala à direita.\n");
-        } else if (c == 'r' || c == 'R') {
-            // voltar ao nó inicial (raiz passada)
-            cursor = atual;
-            printf("Voltando à sala inicial.\n");
-        } else if (c == 's' || c == 'S') {
-            printf("Encerrando exploracao.\n");
-            break;
-        } else {
-            printf("Comando desconhecido. Tente novamente.\n");
-        }
+static void* realocarMemoria(void *p, size_t tam, const char *contexto) {
+    void *q = realloc(p, tam);
+    if (!q) { perror(contexto); exit(EXIT_FAILURE); }
+    g_chamadasMalloc++;
+    return q;
+}
+
+const char* textoDe(TextoId id) {
+    return g_textos.pool + g_textos.offsets[id];
+}
+
+uint64_t hashDoTexto(TextoId id) {
+    return g_textos.hashes[id];
+}
+
+static size_t procurarSlotTexto(const char *s, uint64_t h) {
+    size_t mask = g_textos.capSlots - 1;
+    size_t i = (size_t) h & mask;
+    while (g_textos.slots[i] != TEXTO_NENHUM) {
+        TextoId id = g_textos.slots[i];
+        if (g_textos.hashes[id] == h && strcmp(textoDe(id), s) == 0) break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static void crescerSlotsTexto(void) {
+    size_t cap = g_textos.capSlots ? g_textos.capSlots * 2 : 64;
+    free(g_textos.slots);
+    g_textos.slots = (TextoId*) alocarMemoria(cap * sizeof(TextoId), "malloc crescerSlotsTexto");
+    memset(g_textos.slots, 0xFF, cap * sizeof(TextoId));
+    g_textos.capSlots = cap;
+    for (TextoId id = 0; id < g_textos.total; id++) {
+        size_t i = (size_t) g_textos.hashes[id] & (cap - 1);
+        while (g_textos.slots[i] != TEXTO_NENHUM) i = (i + 1) & (cap - 1);
+        g_textos.slots[i] = id;
     }
 }
 
 /*
- * listarPistasEAssociacoes:
- * - Percorre a BST em ordem e imprime cada pista com o suspeito associado (se houver).
+ * buscarTexto: id do texto já internado ou TEXTO_NENHUM (não insere).
  */
-void listarPistasEAssociacoes(PistaNode *raiz, HashEntry **tab, int m) {
-    if (!raiz) return;
-    listarPistasEAssociacoes(raiz->esq, tab, m);
-    char *sus = encontrarSuspeito(tab, m, raiz->pista);
-    if (!sus) sus = "Desconhecido";
-    printf("- \"%s\"  -> Suspeito sugerido: %s\n", raiz->pista, sus);
-    listarPistasEAssociacoes(raiz->dir, tab, m);
+TextoId buscarTexto(const char *s) {
+    if (g_textos.total == 0) return TEXTO_NENHUM;
+    return g_textos.slots[procurarSlotTexto(s, hashString(s))];
+}
+
+// copia para o heap um cadastro de textos mapeado (antes da primeira inserção)
+static void copiarTextosMapeados(void) {
+    char *pool = (char*) alocarMemoria(g_textos.poolUsado ? g_textos.poolUsado : 1, "malloc copiarTextosMapeados");
+    uint32_t *offsets = (uint32_t*) alocarMemoria((g_textos.total + 1) * sizeof(uint32_t), "malloc copiarTextosMapeados");
+    uint64_t *hashes = (uint64_t*) alocarMemoria((g_textos.total + 1) * sizeof(uint64_t), "malloc copiarTextosMapeados");
+    TextoId *slots = (TextoId*) alocarMemoria(g_textos.capSlots * sizeof(TextoId), "malloc copiarTextosMapeados");
+    memcpy(pool, g_textos.pool, g_textos.poolUsado);
+    memcpy(offsets, g_textos.offsets, g_textos.total * sizeof(uint32_t));
+    memcpy(hashes, g_textos.hashes, g_textos.total * sizeof(uint64_t));
+    memcpy(slots, g_textos.slots, g_textos.capSlots * sizeof(TextoId));
+    g_textos.pool = pool;
+    g_textos.poolCap = g_textos.poolUsado ? g_textos.poolUsado : 1;
+    g_textos.offsets = offsets;
+    g_textos.hashes = hashes;
+    g_textos.capIds = g_textos.total + 1;
+    g_textos.slots = slots;
+    g_textos.mapeado = 0;
 }
 
+static TextoId internarComHash(const char *s, uint64_t h);
+
 /*
- * verificarSuspeitoFinal:
- * - Recebe o nome do suspeito acusado pelo jogador.
- * - Conta quantas pistas coletadas apontam para esse suspeito (buscando via hash).
- * - Regras: se count >= 2 => acusacao sustentada; caso contrário => insuficiente.
+ * internar: devolve o id de 's', copiando o texto para o pool na primeira vez.
  */
-void verificarSuspeitoFinal(PistaNode *raizPistas, HashEntry **tab, int m, const char *acusado) {
-    if (!raizPistas) {
-        printf("Nenhuma pista coletada. Impossivel sustentar acusacao.\n");
-        return;
+TextoId internar(const char *s) {
+    return internarComHash(s, hashString(s));
+}
+
+// internar com o hash já calculado (a carga em lote calcula em paralelo)
+static TextoId internarComHash(const char *s, uint64_t h) {
+    size_t slot;
+    if (g_textos.capSlots > 0) {
+        slot = procurarSlotTexto(s, h);
+        if (g_textos.slots[slot] != TEXTO_NENHUM) return g_textos.slots[slot];
     }
-    // percorrer BST e contar
-    int count = 0;
-    // stack-less recursion
-    // We'll implement a recursive helper:
-    struct HelperCtx { PistaNode *root; HashEntry **tab; int m; const char *acusado; int *count; };
-    // But simpler: implement recursive function inline using nested function is not standard in C.
-    // So implement separate static function:
-    // To keep code concise here, write a small recursive lambda-like helper as separate static function below.
-    // However C doesn't support nested functions portably, so we'll implement a separate function.
-    // We'll call contarPistasPorSuspeito.
-    extern void contarPistasPorSuspeito(PistaNode*, HashEntry**, int, const char*, int*);
-    contarPistasPorSuspeito(raizPistas, tab, m, acusado, &count);
-
-    printf("\nResultado da verificacao:\n");
-    printf("Pistas que apontam para %s: %d\n", acusado, count);
-    if (count >= 2) {
-        printf("Acusacao SUSTENTADA: ha evidencias suficientes para prender %s.\n", acusado);
-    } else {
-        printf("Acusacao NAO sustentada: nao ha pistas suficientes contra %s.\n", acusado);
+    // texto novo: só agora copia um cadastro mapeado e cresce os slots
+    if (g_textos.mapeado) copiarTextosMapeados();
+    if ((size_t) (g_textos.total + 1) * 4 > g_textos.capSlots * 3) crescerSlotsTexto();
+    slot = procurarSlotTexto(s, h);
+
+    size_t tam = strlen(s) + 1;
+    // os offsets são de 32 bits (também nos arquivos .dqc): o pool não passa de 4 GiB
+    if (tam > UINT32_MAX - g_textos.poolUsado) {
+        fprintf(stderr, "internar: pool de textos excede %u bytes\n", UINT32_MAX);
+        exit(EXIT_FAILURE);
+    }
+    if (g_textos.poolUsado + tam > g_textos.poolCap) {
+        size_t cap = g_textos.poolCap ? g_textos.poolCap : 4096;
+        while (g_textos.poolUsado + tam > cap) cap *= 2;
+        g_textos.pool = (char*) realocarMemoria(g_textos.pool, cap, "realloc internar pool");
+        g_textos.poolCap = cap;
     }
+    if (g_textos.total == g_textos.capIds) {
+        uint32_t cap = g_textos.capIds ? g_textos.capIds * 2 : 64;
+        g_textos.offsets = (uint32_t*) realocarMemoria(g_textos.offsets, cap * sizeof(uint32_t), "realloc internar offsets");
+        g_textos.hashes = (uint64_t*) realocarMemoria(g_textos.hashes, cap * sizeof(uint64_t), "realloc internar hashes");
+        g_textos.capIds = cap;
+    }
+    TextoId id = g_textos.total++;
+    memcpy(g_textos.pool + g_textos.poolUsado, s, tam);
+    g_textos.offsets[id] = (uint32_t) g_textos.poolUsado;
+    g_textos.hashes[id] = h;
+    g_textos.poolUsado += tam;
+    g_textos.slots[slot] = id;
+    return id;
 }
 
-/* 
- * contarPistasPorSuspeito: percorre a BST e incrementa *out_count cada vez 
- * que a pista aponta para 'acusado' (segundo a tabela hash).
+static void descartarCatalogoPistas(void); // ids do catálogo morrem com os textos
+
+/*
+ * liberarTextos: descarta todos os textos internados (fim do programa).
  */
-void contarPistasPorSuspeito(PistaNode *raiz, HashEntry **tab, int m, const char *acusado, int *out_count) {
-    if (!raiz) return;
-    contarPistasPorSuspeito(raiz->esq, tab, m, acusado, out_count);
-    char *sus = encontrarSuspeito(tab, m, raiz->pista);
-    if (sus) {
-        char tmpSus[128];
-        strncpy(tmpSus, sus, sizeof(tmpSus)-1);
-        tmpSus[sizeof(tmpSus)-1] = '\0';
-        char tmpAcus[128];
-        strncpy(tmpAcus, acusado, sizeof(tmpAcus)-1);
-        tmpAcus[sizeof(tmpAcus)-1] = '\0';
-        minusculo(tmpSus);
-        minusculo(tmpAcus);
-        if (strcmp(tmpSus, tmpAcus) == 0) (*out_count)++;
+void liberarTextos(void) {
+    if (!g_textos.mapeado) {
+        free(g_textos.pool);
+        free(g_textos.offsets);
+        free(g_textos.hashes);
+        free(g_textos.slots);
     }
-    contarPistasPorSuspeito(raiz->dir, tab, m, acusado, out_count);
+    memset(&g_textos, 0, sizeof(g_textos));
+    descartarCatalogoPistas();
 }
 
-/* -------------------------
-   MAIN - monta mansão, hash, lida com fluxo
-   ------------------------- */
-int main() {
-    // tamanho da tabela hash - pequeno para demo
-    const int M = 31;
+/*
+ * criarSala: cria um nó Sala na arena do jogo, com nome internado e a pista
+ * já resolvida (pistaDaSala). É liberado junto com a arena (liberarArena).
+ */
+Sala* criarSala(Arena *arena, const char *nome) {
+    Sala *s = (Sala*) arenaAlocar(arena, sizeof(Sala));
+    s->nome = internar(nome);
+    s->pista = pistaDaSala(s->nome);
+    s->esq = s->dir = NULL;
+    return s;
+}
 
-    // --- montar mapa fixo da mansao (árvore binária) ---
-    // Exemplo (manual):
-    //                   Entrada
-    //                  /       \
-    //           Sala de Estar   Cozinha
-    //            /     \           \
-    //      Biblioteca QuartoP   Escritorio
-    //        /                       \
-    //    Jardim                    Banheiro
+/*
+ * Mansão plana
+ * A árvore usada durante o jogo fica num vetor contíguo de SalaPlana, com
+ * filhos como índices de 32 bits e nomes/pistas como ids do pool de textos.
+ * Pode ser montada a partir da árvore de Sala (mansaoDeSalas) ou carregada
+ * de arquivo (carregarMansao).
+ */
+void iniciarMansao(Mansao *m) {
+    memset(m, 0, sizeof(*m));
+}
 
-    Sala *root = criarSala("Entrada");
-    root->esq = criarSala("Sala de Estar");
-    root->dir = criarSala("Cozinha");
+// garante que o índice 'i' exista, criando salas vazias até ele
+static void mansaoGarantir(Mansao *m, uint32_t i) {
+    if (i < m->total) return;
+    if (i >= m->cap) {
+        uint32_t cap = m->cap ? m->cap : 64;
+        while (cap <= i) cap *= 2;
+        m->salas = (SalaPlana*) realocarMemoria(m->salas, (size_t) cap * sizeof(SalaPlana), "realloc mansaoGarantir");
+        m->cap = cap;
+    }
+    for (uint32_t k = m->total; k <= i; k++) {
+        m->salas[k].nome = TEXTO_NENHUM;
+        m->salas[k].pista = TEXTO_NENHUM;
+        m->salas[k].esq = m->salas[k].dir = SALA_NENHUMA;
+    }
+    m->total = i + 1;
+}
 
-    root->esq->esq = criarSala("Biblioteca");
-    root->esq->dir = criarSala("Quarto Principal");
+/*
+ * mansaoDeSalas: copia a árvore de Sala para a forma plana em pré-ordem
+ * (a raiz fica no índice 0), com um cursor em pré-ordem, então árvores
+ * degeneradas não estouram a pilha de chamadas. Em pré-ordem o filho
+ * esquerdo vem logo depois do pai; o direito é o da sala mais recente que
+ * ainda espera o seu (pilha 'pendentes'). A pista vem pronta no nó (criarSala).
+ */
+void mansaoDeSalas(Mansao *m, Sala *raiz) {
+    size_t cap = 64, topo = 0;
+    uint32_t *pendentes = (uint32_t*) alocarMemoria(cap * sizeof(uint32_t), "malloc mansaoDeSalas");
+    CursorArvore c;
+    Sala *sala, *anterior = NULL;
 
-    root->dir->dir = criarSala("Escritorio");
+    iniciarMansao(m);
+    abrirCursorSalas(&c, raiz, ORDEM_PRE);
+    while ((sala = proximaSala(&c))) {
+        uint32_t i = m->total;
+        mansaoGarantir(m, i);
+        m->salas[i].nome = sala->nome;
+        m->salas[i].pista = sala->pista;
+        if (anterior && anterior->esq == sala) m->salas[i - 1].esq = i;
+        else if (anterior) m->salas[pendentes[--topo]].dir = i;
+        if (sala->dir) {
+            if (topo == cap) {
+                cap *= 2;
+                pendentes = (uint32_t*) realocarMemoria(pendentes, cap * sizeof(uint32_t), "realloc mansaoDeSalas");
+            }
+            pendentes[topo++] = i;
+        }
+        anterior = sala;
+    }
+    fecharCursor(&c);
+    free(pendentes);
+}
 
-    root->esq->esq->esq = criarSala("Jardim");
-    root->dir->dir->dir = criarSala("Banheiro");
+// separa 'linha' em até 'max' campos delimitados por '|', in place
+static int separarCampos(char *linha, char **campos, int max) {
+    int n = 0;
+    campos[n++] = linha;
+    for (char *p = linha; *p && n < max; p++) {
+        if (*p == '|') {
+            *p = '\0';
+            campos[n++] = p + 1;
+        }
+    }
+    return n;
+}
 
-    // --- criar tabela hash e popular com associações pista->suspeito ---
-    HashEntry **tabela = criarTabelaHash(M);
+// lê um índice de sala; campo vazio ou "-" = SALA_NENHUMA. Retorna 0 se inválido.
+static int lerIndiceSala(const char *campo, uint32_t *out) {
+    if (campo[0] == '\0' || strcmp(campo, "-") == 0) {
+        *out = SALA_NENHUMA;
+        return 1;
+    }
+    char *fim;
+    unsigned long v = strtoul(campo, &fim, 10);
+    if (*fim != '\0' || v >= SALA_NENHUMA) return 0;
+    *out = (uint32_t) v;
+    return 1;
+}
 
-    // Exemplo de associações conhecidas (pré-definidas no jogo)
-    inserirNaHash(tabela, M, "pegadas molhadas", "Jardineiro");
-    inserirNaHash(tabela, M, "charuto queimado", "Marido");
-    inserirNaHash(tabela, M, "marcador de livro rasgado", "Bibliotecaria");
-    inserirNaHash(tabela, M, "pegador de panelas sujo", "Cozinheiro");
-    inserirNaHash(tabela, M, "fio de tecido vermelho", "Marido");
-    inserirNaHash(tabela, M, "batom no lavatório", "Mulher da festa");
-    inserirNaHash(tabela, M, "recibo rasgado", "Contador");
-    inserirNaHash(tabela, M, "sementes pisoteadas", "Jardineiro");
-    // Podemos deixar outras pistas mapeadas para "Desconhecido" por default se necessário.
+// lê um inteiro em [min, max]. Retorna 0 se inválido.
+static int lerInteiro(const char *campo, long min, long max, long *out) {
+    char *fim;
+    errno = 0;
+    long v = strtol(campo, &fim, 10);
+    if (campo[0] == '\0' || *fim != '\0' || errno != 0 || v < min || v > max) return 0;
+    *out = v;
+    return 1;
+}
 
-    // --- BST para armazenar pistas coletadas ---
-    PistaNode *raizPistas = NULL;
+/*
+ * carregarMansao: lê a descrição textual de uma mansão.
+ * Formato (uma entrada por linha, campos separados por '|', '#' comenta):
+ *   M|<total de salas>                       (opcional, pré-aloca)
+ *   S|<indice>|<nome>|<pista>|<esq>|<dir>    (pista/esq/dir vazios = nenhum)
+ *   H|<pista>|<suspeito>                     (associação na tabela hash)
+ *   P|<pista>|<suspeito>|<peso>              (peso da pista para o suspeito)
+ *   L|<sustentar>|<inocentar>                (limiares do veredito, em pontos)
+ * Sem linhas P cada pista vale 1 para o suspeito da linha H; um peso
+ * negativo inocenta e um peso 0 desfaz a associação da linha H (ver Pesos
+ * de evidência). Com 'tab' ou 'regras' NULL as linhas H ou P/L são ignoradas.
+ * A sala 0 é a entrada. Retorna 0 em sucesso ou -1 (com mensagem em stderr)
+ * se o arquivo não abre, tem linha malformada ou não descreve uma árvore.
+ */
+int carregarMansao(const char *caminho, Mansao *m, TabelaHash *tab, RegrasEvidencia *regras) {
+    FILE *f = fopen(caminho, "r");
+    if (!f) { perror(caminho); return -1; }
 
-    // Mensagem inicial
-    printf("===== DETECTIVE QUEST - Exploracao da Mansao =====\n");
-    printf("Voce ira explorar as salas e coletar pistas automaticamente ao entrar.\n");
+    iniciarMansao(m);
+    uint8_t *temPai = NULL;
+    uint32_t capPai = 0;
+    char linha[4096];
+    char *campos[6];
+    long numLinha = 0;
+    int erro = 0;
 
-    // Explorar salas (interativo)
-    explorarSalas(root, &raizPistas, tabela, M);
+    while (!erro && fgets(linha, sizeof(linha), f)) {
+        numLinha++;
+        trim_newline(linha);
+        size_t len = strlen(linha);
+        if (len > 0 && linha[len - 1] == '\r') linha[len - 1] = '\0';
+        if (linha[0] == '\0' || linha[0] == '#') continue;
 
-    // Ao final da exploração, listar pistas coletadas e buscar suspeito
-    printf("\n=== FIM DA EXPLORACAO ===\n");
-    int total = contarPistas(raizPistas);
+        int n = separarCampos(linha, campos, 6);
+        if (linha[0] == 'M' && n == 2) {
+            uint32_t total;
+            if (!lerIndiceSala(campos[1], &total) || total == SALA_NENHUMA) { erro = 1; break; }
+            if (total > m->cap) {
+                m->salas = (SalaPlana*) realocarMemoria(m->salas, (size_t) total * sizeof(SalaPlana), "realloc carregarMansao");
+                m->cap = total;
+            }
+        } else if (linha[0] == 'S' && n == 6) {
+            uint32_t i, filhos[2];
+            if (!lerIndiceSala(campos[1], &i) || i == SALA_NENHUMA ||
+                !lerIndiceSala(campos[4], &filhos[0]) || !lerIndiceSala(campos[5], &filhos[1])) {
+                erro = 1;
+                break;
+            }
+            mansaoGarantir(m, i);
+            m->salas[i].nome = internar(campos[2]);
+            m->salas[i].pista = campos[3][0] ? internar(campos[3]) : TEXTO_NENHUM;
+            m->salas[i].esq = filhos[0];
+            m->salas[i].dir = filhos[1];
+            for (int k = 0; k < 2; k++) {
+                uint32_t c = filhos[k];
+                if (c == SALA_NENHUMA) continue;
+                if (c >= capPai) {
+                    uint32_t cap = capPai ? capPai : 64;
+                    while (cap <= c) cap *= 2;
+                    temPai = (uint8_t*) realocarMemoria(temPai, cap, "realloc carregarMansao");
+                    memset(temPai + capPai, 0, cap - capPai);
+                    capPai = cap;
+                }
+                if (c == 0 || temPai[c]) {
+                    fprintf(stderr, "%s:%ld: sala %u com mais de um pai\n", caminho, numLinha, c);
+                    erro = 2;
+                    break;
+                }
+                temPai[c] = 1;
+            }
+        } else if (linha[0] == 'H' && n == 3) {
+            if (tab) inserirNaHash(tab, campos[1], campos[2]);
+        } else if (linha[0] == 'P' && n == 4) {
+            long peso;
+            if (!lerInteiro(campos[3], -PESO_MAXIMO, PESO_MAXIMO, &peso) || !campos[1][0] || !campos[2][0]) { erro = 1; break; }
+            if (regras) adicionarPeso(regras, campos[1], campos[2], (int32_t) peso);
+        } else if (linha[0] == 'L' && n == 3) {
+            long sustentar, inocentar = LIMIAR_INOCENTAR_PADRAO;
+            if (!lerInteiro(campos[1], -PESO_MAXIMO, PESO_MAXIMO, &sustentar) ||
+                (campos[2][0] && !lerInteiro(campos[2], -PESO_MAXIMO, PESO_MAXIMO, &inocentar)) ||
+                inocentar >= sustentar) { erro = 1; break; }
+            if (regras) {
+                regras->limiarSustentar = (int32_t) sustentar;
+                regras->limiarInocentar = (int32_t) inocentar;
+            }
+        } else {
+            erro = 1;
+        }
+    }
+    if (erro == 1) fprintf(stderr, "%s:%ld: linha malformada\n", caminho, numLinha);
+    fclose(f);
+    free(temPai);
+
+    for (uint32_t i = 0; !erro && i < m->total; i++) {
+        SalaPlana *s = &m->salas[i];
+        if (s->nome == TEXTO_NENHUM) {
+            fprintf(stderr, "%s: sala %u nao declarada\n", caminho, i);
+            erro = 2;
+        } else if ((s->esq != SALA_NENHUMA && s->esq >= m->total) ||
+                   (s->dir != SALA_NENHUMA && s->dir >= m->total)) {
+            fprintf(stderr, "%s: sala %u aponta para sala inexistente\n", caminho, i);
+            erro = 2;
+        }
+    }
+    if (!erro && m->total == 0) {
+        fprintf(stderr, "%s: nenhuma sala declarada\n", caminho);
+        erro = 2;
+    }
+    if (erro) {
+        liberarMansao(m);
+        return -1;
+    }
+    return 0;
+}
+
+void liberarMansao(Mansao *m) {
+    if (!m->mapeada) free(m->salas);
+    free(m->catalogo);
+    iniciarMansao(m);
+}
+
+/*
+ * Leiaute da mansão
+ * Montada a mansão, as salas não mudam mais; o que sobra é a ordem delas no
+ * vetor. Um arquivo escrito à mão (ou uma mansão que cresceu por inserções)
+ * pode pôr pai e filho a megabytes de distância, e cada [e]/[d] vira uma
+ * falta de cache. congelarMansao renumera as salas:
+ * - LEIAUTE_LARGURA: nível por nível a partir da entrada, a ordem de
+ *   Eytzinger quando a árvore é completa; os primeiros níveis, por onde
+ *   passam todos os caminhos, ficam juntos no começo do vetor.
+ * - LEIAUTE_VEB (van Emde Boas): a metade de cima dos níveis primeiro, depois
+ *   cada subárvore pendurada nela, com a mesma regra dentro de cada parte.
+ *   Um caminho de h salas cruza O(log_B h) blocos de B salas, seja qual for
+ *   B (linha de cache, página), sem conhecer B.
+ * A entrada vira a sala 0 e as salas inalcançáveis vão para o fim, na ordem
+ * original. Os filhos continuam índices de 32 bits (SalaPlana tem 16 bytes);
+ * o leiaute só encurta a distância entre eles. A mansão mapeada é somente
+ * leitura (o leiaute é escolhido ao compilar o caso) e a procedural já está
+ * em numeração de heap, que é a ordem em largura.
+ */
+typedef struct Leiaute {
+    const Mansao *m;
+    const uint32_t *pai;
+    const uint32_t *altura;     // níveis da subárvore de cada sala
+    uint32_t *ordem;            // salas na ordem nova
+    uint32_t total;
+    uint32_t *fronteira;        // raízes das partes de baixo pendentes, em pilha
+    size_t topoFronteira;
+    uint32_t *pilha;            // busca em profundidade (sala, nível) da fronteira
+} Leiaute;
+
+// filho de 'v' na árvore alcançável da entrada (SALA_NENHUMA se não há)
+static uint32_t filhoNoLeiaute(const Leiaute *l, uint32_t v, int direita) {
+    const SalaPlana *s = &l->m->salas[v];
+    uint32_t c = direita ? s->dir : s->esq;
+    return c < l->m->total && c != v && l->pai[c] == v && !(direita && c == s->esq) ? c : SALA_NENHUMA;
+}
+
+// dispõe os 'niveis' primeiros níveis da subárvore de 'v' em ordem de van Emde Boas
+static void disporVeb(Leiaute *l, uint32_t v, uint32_t niveis) {
+    if (niveis > l->altura[v]) niveis = l->altura[v];
+    if (niveis == 1) {
+        l->ordem[l->total++] = v;
+        return;
+    }
+    uint32_t cima = niveis / 2, baixo = niveis - cima;
+    disporVeb(l, v, cima);
+    // salas 'cima' níveis abaixo de 'v', da esquerda para a direita
+    size_t inicio = l->topoFronteira, topo = 0;
+    l->pilha[topo++] = v;
+    l->pilha[topo++] = 0;
+    while (topo > 0) {
+        uint32_t nivel = l->pilha[--topo], u = l->pilha[--topo];
+        if (nivel == cima) {
+            l->fronteira[l->topoFronteira++] = u;
+            continue;
+        }
+        for (int lado = 1; lado >= 0; lado--) {
+            uint32_t c = filhoNoLeiaute(l, u, lado);
+            if (c == SALA_NENHUMA) continue;
+            l->pilha[topo++] = c;
+            l->pilha[topo++] = nivel + 1;
+        }
+    }
+    size_t fim = l->topoFronteira;
+    for (size_t i = inicio; i < fim; i++) disporVeb(l, l->fronteira[i], baixo);
+    l->topoFronteira = inicio;
+}
+
+/*
+ * congelarMansao: renumera as salas de 'm' no 'leiaute' pedido (ver Leiaute
+ * da mansão), corrigindo os filhos. LEIAUTE_ARQUIVO mantém a ordem.
+ */
+void congelarMansao(Mansao *m, LeiauteMansao leiaute) {
+    if (leiaute == LEIAUTE_ARQUIVO || m->mapeada || m->procedural || m->total == 0) return;
+    uint32_t n = m->total;
+    size_t bytes = ((size_t) n + 1) * sizeof(uint32_t);
+    uint32_t *pai = (uint32_t*) alocarMemoria(bytes, "malloc congelarMansao");
+    uint32_t *largura = (uint32_t*) alocarMemoria(bytes, "malloc congelarMansao");
+    uint32_t *posicao = (uint32_t*) alocarMemoria(bytes, "malloc congelarMansao");
+    memset(pai, 0xFF, bytes);
+
+    // ordem em largura a partir da entrada; 'pai' marca as salas alcançadas
+    uint32_t alcancadas = 0;
+    largura[alcancadas++] = m->raiz;
+    pai[m->raiz] = m->raiz;
+    for (uint32_t j = 0; j < alcancadas; j++) {
+        uint32_t v = largura[j];
+        uint32_t filhos[2] = { m->salas[v].esq, m->salas[v].dir };
+        for (int k = 0; k < 2; k++) {
+            uint32_t c = filhos[k];
+            if (c >= n || pai[c] != SALA_NENHUMA) continue; // arquivos malformados
+            pai[c] = v;
+            largura[alcancadas++] = c;
+        }
+    }
+
+    uint32_t *ordem = largura;
+    if (leiaute == LEIAUTE_VEB) {
+        // alturas de baixo para cima (largura ao contrário), depois a recursão,
+        // que desce O(log altura) níveis
+        uint32_t *altura = (uint32_t*) alocarZerada((size_t) n + 1, sizeof(uint32_t), "calloc congelarMansao");
+        for (uint32_t j = alcancadas; j-- > 0;) {
+            uint32_t v = largura[j];
+            altura[v] += 1;
+            if (v != m->raiz && altura[pai[v]] < altura[v]) altura[pai[v]] = altura[v];
+        }
+        Leiaute l = { m, pai, altura, NULL, 0, NULL, 0, NULL };
+        l.ordem = (uint32_t*) alocarMemoria(bytes, "malloc congelarMansao");
+        l.fronteira = (uint32_t*) alocarMemoria(bytes, "malloc congelarMansao");
+        l.pilha = (uint32_t*) alocarMemoria(2 * bytes, "malloc congelarMansao");
+        disporVeb(&l, m->raiz, altura[m->raiz]);
+        free(l.pilha);
+        free(l.fronteira);
+        free(altura);
+        free(largura);
+        ordem = l.ordem;
+    }
+
+    // inalcançáveis no fim, na ordem original
+    for (uint32_t i = 0; i < n; i++)
+        if (pai[i] == SALA_NENHUMA) ordem[alcancadas++] = i;
+    for (uint32_t j = 0; j < n; j++) posicao[ordem[j]] = j;
+    SalaPlana *novas = (SalaPlana*) alocarMemoria((size_t) n * sizeof(SalaPlana), "malloc congelarMansao");
+    for (uint32_t j = 0; j < n; j++) {
+        novas[j] = m->salas[ordem[j]];
+        if (novas[j].esq < n) novas[j].esq = posicao[novas[j].esq];
+        if (novas[j].dir < n) novas[j].dir = posicao[novas[j].dir];
+    }
+    free(m->salas);
+    m->salas = novas;
+    m->cap = n;
+    m->raiz = posicao[m->raiz];
+    free(ordem);
+    free(posicao);
+    free(pai);
+}
+
+/*
+ * Mansão procedural
+ * Uma mansão de até ~4 bilhões de salas que não existe na memória: as salas
+ * formam uma árvore completa numerada como um heap (filhos de i em 2i+1 e
+ * 2i+2), e nome e pista de cada sala saem de um hash da semente com o
+ * índice, então qualquer sala é gerada a qualquer momento, sempre igual.
+ * As pistas vêm de um catálogo fixo (PISTAS_PROCEDURAIS textos internados
+ * na criação, cada um associado a um suspeito na tabela), de modo que o
+ * caso tem ids densos, máscaras e pesos como um caso comum. Cada sessão
+ * materializa as salas em que entra num cache LRU de capacidade fixa
+ * (materializarSala); a memória cresce com o caminho percorrido, limitada
+ * pelo cache, e não com o tamanho da mansão. Caminhos, ancestrais e rotas
+ * são aritmética sobre os índices (ver Índice de caminhos).
+ */
+#define PISTAS_PROCEDURAIS 1024
+#define SALAS_EM_CACHE_PADRAO 4096
+
+static const char *const COMODOS_PROCEDURAIS[] = {
+    "Biblioteca", "Cozinha", "Sala de Estar", "Escritorio", "Jardim de Inverno", "Quarto", "Banheiro", "Adega",
+    "Sotao", "Galeria", "Capela", "Estufa", "Sala de Musica", "Salao de Baile", "Despensa", "Lavanderia",
+};
+static const char *const ALAS_PROCEDURAIS[] = { "Norte", "Sul", "Leste", "Oeste" };
+static const char *const OBJETOS_PROCEDURAIS[] = {
+    "luva", "bilhete", "chave", "lenco", "taca", "vela", "carta", "botao",
+    "frasco", "fotografia", "relogio", "bengala", "anel", "mapa", "pena", "moeda",
+};
+static const char *const DETALHES_PROCEDURAIS[] = {
+    "rasgado", "manchado", "queimado", "molhado", "quebrado", "escondido", "riscado", "perfumado",
+    "amassado", "sujo de terra", "com digitais", "com sangue", "dobrado", "trincado", "descolado", "gasto",
+};
+static const char *const SUSPEITOS_PROCEDURAIS[] = {
+    "Mordomo", "Jardineiro", "Cozinheira", "Herdeiro", "Governanta", "Motorista", "Medica", "Coronel",
+};
+#define TAMANHO_DE(v) (sizeof(v) / sizeof((v)[0]))
+
+// mistura de 64 bits (splitmix64) da semente com um índice
+static uint64_t misturarSemente(uint64_t semente, uint64_t i) {
+    uint64_t x = semente + (i + 1) * 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/*
+ * mansaoProcedural: prepara 'm' como mansão procedural de 'salas' salas e
+ * associa na tabela as pistas do catálogo a suspeitos sorteados pela
+ * semente. Nenhuma sala é gerada aqui.
+ */
+void mansaoProcedural(Mansao *m, TabelaHash *tab, uint32_t salas, uint64_t semente, uint32_t salasEmCache) {
+    iniciarMansao(m);
+    m->procedural = 1;
+    m->total = salas < SALA_NENHUMA ? salas : SALA_NENHUMA - 1;
+    m->semente = semente;
+    m->salasEmCache = salasEmCache >= 2 ? salasEmCache : 2;
+    m->totalCatalogo = PISTAS_PROCEDURAIS;
+    m->catalogo = (TextoId*) alocarMemoria(PISTAS_PROCEDURAIS * sizeof(TextoId), "malloc mansaoProcedural");
+    char texto[64];
+    for (uint32_t k = 0; k < PISTAS_PROCEDURAIS; k++) {
+        uint32_t combinacoes = TAMANHO_DE(OBJETOS_PROCEDURAIS) * TAMANHO_DE(DETALHES_PROCEDURAIS);
+        int n = snprintf(texto, sizeof(texto), "%s %s", OBJETOS_PROCEDURAIS[k % TAMANHO_DE(OBJETOS_PROCEDURAIS)],
+                         DETALHES_PROCEDURAIS[k / TAMANHO_DE(OBJETOS_PROCEDURAIS) % TAMANHO_DE(DETALHES_PROCEDURAIS)]);
+        if (k >= combinacoes) snprintf(texto + n, sizeof(texto) - (size_t) n, " %u", k / combinacoes + 1);
+        m->catalogo[k] = internar(texto);
+        uint64_t h = misturarSemente(~semente, k);
+        inserirNaHashId(tab, m->catalogo[k], cadastrarSuspeito(SUSPEITOS_PROCEDURAIS[h % TAMANHO_DE(SUSPEITOS_PROCEDURAIS)]));
+    }
+}
+
+// filho de 'sala' (esquerda ou direita) ou SALA_NENHUMA
+uint32_t filhoDaSala(const Mansao *m, uint32_t sala, int direita) {
+    if (!m->procedural) return direita ? m->salas[sala].dir : m->salas[sala].esq;
+    uint64_t f = 2 * (uint64_t) sala + 1 + (uint64_t) direita;
+    return f < m->total ? (uint32_t) f : SALA_NENHUMA;
+}
+
+/*
+ * gerarSala: nome (em 'nome', NOME_SALA_MAX bytes) e pista da sala da
+ * mansão procedural. Metade das salas tem pista. 'nome' ou 'pista' podem
+ * ser NULL.
+ */
+void gerarSala(const Mansao *m, uint32_t sala, char *nome, TextoId *pista) {
+    uint64_t h = misturarSemente(m->semente, sala);
+    if (nome && sala == m->raiz) {
+        snprintf(nome, NOME_SALA_MAX, "Entrada");
+    } else if (nome) {
+        snprintf(nome, NOME_SALA_MAX, "%s %s %u", COMODOS_PROCEDURAIS[(h >> 8) % TAMANHO_DE(COMODOS_PROCEDURAIS)],
+                 ALAS_PROCEDURAIS[(h >> 16) % TAMANHO_DE(ALAS_PROCEDURAIS)], sala);
+    }
+    if (pista) *pista = (h & 1) ? TEXTO_NENHUM : m->catalogo[(h >> 24) % m->totalCatalogo];
+}
+
+void iniciarCacheSalas(CacheSalas *c, uint32_t capacidade) {
+    c->capacidade = capacidade;
+    c->usadas = 0;
+    c->vagas = (SalaGerada*) alocarMemoria((size_t) capacidade * sizeof(SalaGerada), "malloc iniciarCacheSalas");
+    uint32_t slots = 4;
+    while (slots < 2 * capacidade) slots *= 2;
+    c->posicoes = (uint32_t*) alocarMemoria((size_t) slots * sizeof(uint32_t), "malloc iniciarCacheSalas");
+    memset(c->posicoes, 0xFF, (size_t) slots * sizeof(uint32_t));
+    c->mascara = slots - 1;
+    c->recente = c->antiga = SALA_NENHUMA;
+    c->acertos = c->geradas = 0;
+}
+
+static uint32_t slotDaSala(const CacheSalas *c, uint32_t sala) {
+    return (uint32_t) ((sala * 0x9E3779B97F4A7C15ULL) >> 32) & c->mascara;
+}
+
+// tira a vaga 'v' da lista LRU
+static void desligarVaga(CacheSalas *c, uint32_t v) {
+    SalaGerada *g = &c->vagas[v];
+    if (g->anterior != SALA_NENHUMA) c->vagas[g->anterior].proxima = g->proxima;
+    else c->recente = g->proxima;
+    if (g->proxima != SALA_NENHUMA) c->vagas[g->proxima].anterior = g->anterior;
+    else c->antiga = g->anterior;
+}
+
+// põe a vaga 'v' na frente da lista LRU
+static void ligarVagaNaFrente(CacheSalas *c, uint32_t v) {
+    c->vagas[v].anterior = SALA_NENHUMA;
+    c->vagas[v].proxima = c->recente;
+    if (c->recente != SALA_NENHUMA) c->vagas[c->recente].anterior = v;
+    c->recente = v;
+    if (c->antiga == SALA_NENHUMA) c->antiga = v;
+}
+
+// apaga a sala da sondagem linear, puxando para trás as entradas seguintes
+static void esquecerSala(CacheSalas *c, uint32_t sala) {
+    uint32_t i = slotDaSala(c, sala);
+    while (c->vagas[c->posicoes[i]].indice != sala) i = (i + 1) & c->mascara;
+    for (;;) {
+        c->posicoes[i] = SALA_NENHUMA;
+        uint32_t j = i;
+        for (;;) {
+            j = (j + 1) & c->mascara;
+            if (c->posicoes[j] == SALA_NENHUMA) return;
+            uint32_t ideal = slotDaSala(c, c->vagas[c->posicoes[j]].indice);
+            if (((j - ideal) & c->mascara) >= ((j - i) & c->mascara)) break;
+        }
+        c->posicoes[i] = c->posicoes[j];
+        i = j;
+    }
+}
+
+/*
+ * materializarSala: a sala no cache, gerada (gerarSala) na primeira vez.
+ * Cheio, o cache descarta a sala usada há mais tempo. O ponteiro vale até
+ * a próxima materialização.
+ */
+const SalaGerada* materializarSala(CacheSalas *c, const Mansao *m, uint32_t sala) {
+    uint32_t i = slotDaSala(c, sala);
+    for (; c->posicoes[i] != SALA_NENHUMA; i = (i + 1) & c->mascara) {
+        uint32_t v = c->posicoes[i];
+        if (c->vagas[v].indice != sala) continue;
+        c->acertos++;
+        if (c->recente != v) {
+            desligarVaga(c, v);
+            ligarVagaNaFrente(c, v);
+        }
+        return &c->vagas[v];
+    }
+    uint32_t v;
+    if (c->usadas < c->capacidade) {
+        v = c->usadas++;
+    } else {
+        v = c->antiga;
+        desligarVaga(c, v);
+        esquecerSala(c, c->vagas[v].indice);
+        i = slotDaSala(c, sala);
+        while (c->posicoes[i] != SALA_NENHUMA) i = (i + 1) & c->mascara;
+    }
+    SalaGerada *g = &c->vagas[v];
+    g->indice = sala;
+    gerarSala(m, sala, g->nome, &g->pista);
+    c->posicoes[i] = v;
+    ligarVagaNaFrente(c, v);
+    c->geradas++;
+    return g;
+}
+
+void liberarCacheSalas(CacheSalas *c) {
+    free(c->vagas);
+    free(c->posicoes);
+    memset(c, 0, sizeof(*c));
+}
+
+// nome da sala para a sessão (em mansão procedural, válido até a próxima sala gerada)
+const char* nomeDaSala(Sessao *s, const Caso *caso, uint32_t sala) {
+    if (!s->cache) return textoDe(caso->mansao.salas[sala].nome);
+    return materializarSala(s->cache, &caso->mansao, sala)->nome;
+}
+
+TextoId pistaNaSala(Sessao *s, const Caso *caso, uint32_t sala) {
+    if (!s->cache) return caso->mansao.salas[sala].pista;
+    return materializarSala(s->cache, &caso->mansao, sala)->pista;
+}
+
+/*
+ * Pistas (árvore AVL)
+ * A árvore de pistas é balanceada por altura (AVL), de modo que inserções em
+ * ordem (pacotes de caso já ordenados) não degeneram em lista. A altura de uma
+ * AVL com n nós é < 1.45*log2(n+2), então PISTA_ALTURA_MAX cobre qualquer n
+ * representável e os percursos usam pilha explícita de tamanho fixo.
+ */
+#define PISTA_ALTURA_MAX 64
+
+static int alturaPista(const PistaNode *n) {
+    return n ? n->altura : 0;
+}
+
+static uint32_t tamanhoPista(const PistaNode *n) {
+    return n ? n->tamanho : 0;
+}
+
+// recalcula altura e tamanho de n a partir dos filhos
+static void atualizarAlturaPista(PistaNode *n) {
+    int he = alturaPista(n->esq), hd = alturaPista(n->dir);
+    n->altura = 1 + (he > hd ? he : hd);
+    n->tamanho = 1 + tamanhoPista(n->esq) + tamanhoPista(n->dir);
+}
+
+static PistaNode* rotacionarDireitaPista(PistaNode *y) {
+    PistaNode *x = y->esq;
+    y->esq = x->dir;
+    x->dir = y;
+    atualizarAlturaPista(y);
+    atualizarAlturaPista(x);
+    return x;
+}
+
+static PistaNode* rotacionarEsquerdaPista(PistaNode *x) {
+    PistaNode *y = x->dir;
+    x->dir = y->esq;
+    y->esq = x;
+    atualizarAlturaPista(x);
+    atualizarAlturaPista(y);
+    return y;
+}
+
+/*
+ * balancearPista: recalcula a altura de n e aplica a rotação (simples ou
+ * dupla) necessária. Retorna a nova raiz da subárvore.
+ */
+static PistaNode* balancearPista(PistaNode *n) {
+    atualizarAlturaPista(n);
+    int fb = alturaPista(n->esq) - alturaPista(n->dir);
+    if (fb > 1) {
+        if (alturaPista(n->esq->esq) < alturaPista(n->esq->dir))
+            n->esq = rotacionarEsquerdaPista(n->esq);
+        return rotacionarDireitaPista(n);
+    }
+    if (fb < -1) {
+        if (alturaPista(n->dir->dir) < alturaPista(n->dir->esq))
+            n->dir = rotacionarDireitaPista(n->dir);
+        return rotacionarEsquerdaPista(n);
+    }
+    return n;
+}
+
+static PistaNode* novoNoPista(Arena *arena, TextoId pista) {
+    PistaNode *n = (PistaNode*) arenaAlocar(arena, sizeof(PistaNode));
+    n->pista = pista;
+    n->esq = n->dir = NULL;
+    n->altura = 1;
+    n->tamanho = 1;
+    return n;
+}
+
+/*
+ * inserirPistaIterativa: insere a pista na AVL sem recursão.
+ * Desce guardando os enlaces percorridos e, na volta, rebalanceia até o
+ * primeiro ancestral cuja altura não mudou; acima dele só os tamanhos
+ * das subárvores aumentam.
+ * Os nós vêm da arena da sessão. A duplicata é detectada pelo id internado;
+ * strcmp só é usado para decidir o lado da descida.
+ * Retorna a raiz (possivelmente nova). 'inseriu' = 1 se inseriu, 0 se já existia.
+ */
+PistaNode* inserirPistaIterativa(Arena *arena, PistaNode *raiz, TextoId pista, int *inseriu) {
+    PistaNode **caminho[PISTA_ALTURA_MAX];
+    int topo = 0;
+    PistaNode **ref = &raiz;
+    const char *texto = textoDe(pista);
+    INSTR_INICIO(t0);
+
+    *inseriu = 0;
+    while (*ref) {
+        if ((*ref)->pista == pista) { // já existe
+            INSTR_FIM(MEDIDA_INSERIR_PISTA, t0, 0);
+            return raiz;
+        }
+        int cmp = strcmp(texto, textoDe((*ref)->pista));
+        caminho[topo++] = ref;
+        ref = (cmp < 0) ? &(*ref)->esq : &(*ref)->dir;
+    }
+    *ref = novoNoPista(arena, pista);
+    *inseriu = 1;
+
+    while (topo > 0) {
+        ref = caminho[--topo];
+        int alturaAntes = (*ref)->altura;
+        *ref = balancearPista(*ref);
+        if ((*ref)->altura == alturaAntes) break;
+    }
+    while (topo > 0) (*caminho[--topo])->tamanho++;
+    INSTR_FIM(MEDIDA_INSERIR_PISTA, t0, 1);
+    return raiz;
+}
+
+/*
+ * Cursores de árvore
+ * Um mesmo motor percorre árvores de Sala e de PistaNode (os filhos são
+ * lidos pelos deslocamentos dos campos esq/dir), sem recursão, em ordem ou
+ * em pré-ordem. As árvores ficam na arena e são liberadas de uma vez, então
+ * nenhum chamador precisa de pós-ordem.
+ * Uso: abrirCursor...; while ((n = proxima...(&c))) ...; fecharCursor(&c).
+ */
+
+// filho em 'off' do nó, lido por memcpy (o campo é Sala* ou PistaNode*, não void*)
+static inline void* filhoDoNo(const void *no, size_t off) {
+    void *filho;
+    memcpy(&filho, (const char*) no + off, sizeof filho);
+    return filho;
+}
+
+static void empilharCursor(CursorArvore *c, void *no) {
+    if (c->topo == c->cap) {
+        size_t cap = c->cap * 2;
+        void **novos = (void**) alocarMemoria(cap * sizeof(void*), "malloc empilharCursor");
+        memcpy(novos, c->itens, c->topo * sizeof(void*));
+        if (c->itens != c->local) free(c->itens);
+        c->itens = novos;
+        c->cap = cap;
+    }
+    c->itens[c->topo++] = no;
+}
+
+static void abrirCursor(CursorArvore *c, void *raiz, OrdemPercurso ordem, size_t offEsq, size_t offDir) {
+    c->ordem = ordem;
+    c->offEsq = offEsq;
+    c->offDir = offDir;
+    c->itens = c->local;
+    c->cap = CURSOR_PILHA_LOCAL;
+    c->topo = 0;
+    c->atual = NULL;
+    if (ordem == ORDEM_EM) c->atual = raiz;
+    else if (raiz) empilharCursor(c, raiz);
+}
+
+// próximo nó na ordem do cursor, ou NULL no fim
+static void* proximoNo(CursorArvore *c) {
+    void *n, *filho;
+    switch (c->ordem) {
+    case ORDEM_PRE:
+        if (c->topo == 0) return NULL;
+        n = c->itens[--c->topo];
+        // direita empilhada antes para a esquerda sair primeiro
+        if ((filho = filhoDoNo(n, c->offDir))) empilharCursor(c, filho);
+        if ((filho = filhoDoNo(n, c->offEsq))) empilharCursor(c, filho);
+        return n;
+    case ORDEM_EM:
+        while (c->atual) {
+            empilharCursor(c, c->atual);
+            c->atual = filhoDoNo(c->atual, c->offEsq);
+        }
+        if (c->topo == 0) return NULL;
+        n = c->itens[--c->topo];
+        c->atual = filhoDoNo(n, c->offDir);
+        return n;
+    }
+    return NULL;
+}
+
+void abrirCursorSalas(CursorArvore *c, Sala *raiz, OrdemPercurso ordem) {
+    abrirCursor(c, raiz, ordem, offsetof(Sala, esq), offsetof(Sala, dir));
+}
+
+Sala* proximaSala(CursorArvore *c) {
+    return (Sala*) proximoNo(c);
+}
+
+void abrirCursorPistas(CursorArvore *c, PistaNode *raiz, OrdemPercurso ordem) {
+    abrirCursor(c, raiz, ordem, offsetof(PistaNode, esq), offsetof(PistaNode, dir));
+}
+
+PistaNode* proximaPista(CursorArvore *c) {
+    return (PistaNode*) proximoNo(c);
+}
+
+// libera a pilha do cursor se ela foi para o heap (pode ser chamada antes do fim)
+void fecharCursor(CursorArvore *c) {
+    if (c->itens != c->local) free(c->itens);
+    c->itens = c->local;
+    c->topo = 0;
+}
+
+/*
+ * percorrerPistasEmOrdem: visita as pistas em ordem alfabética (cursor em
+ * ordem), chamando 'visitar' para cada nó.
+ */
+void percorrerPistasEmOrdem(PistaNode *raiz, void (*visitar)(PistaNode *n, void *ctx), void *ctx) {
+    CursorArvore c;
+    PistaNode *n;
+    abrirCursorPistas(&c, raiz, ORDEM_EM);
+    while ((n = proximaPista(&c))) visitar(n, ctx);
+    fecharCursor(&c);
+}
+
+/*
+ * mostrarPistasInOrder: percorre a AVL em ordem e escreve as pistas
+ * coletadas na saída, descarregada a cada SAIDA_LOTE bytes.
+ */
+void mostrarPistasInOrder(Saida *saida, PistaNode *raiz) {
+    CursorArvore c;
+    PistaNode *n;
+    abrirCursorPistas(&c, raiz, ORDEM_EM);
+    while ((n = proximaPista(&c))) {
+        if (saida->formato == SAIDA_JSON) {
+            escreverSaida(saida, "{\"evento\":\"pista\",\"pista\":");
+            escreverJsonTexto(saida, textoDe(n->pista));
+            escreverSaida(saida, "}\n");
+        } else {
+            escreverSaida(saida, "- %s\n", textoDe(n->pista));
+        }
+        if (saida->usado >= SAIDA_LOTE) descarregarSaida(saida);
+    }
+    fecharCursor(&c);
+    descarregarSaida(saida);
+}
+
+/*
+ * contarPistas: nós na AVL, lido do tamanho guardado na raiz (O(1)).
+ */
+int contarPistas(PistaNode *raiz) {
+    return (int) tamanhoPista(raiz);
+}
+
+/*
+ * contemPista: 1 se a pista já está na AVL.
+ */
+int contemPista(PistaNode *raiz, TextoId pista) {
+    const char *texto = textoDe(pista);
+    while (raiz && raiz->pista != pista)
+        raiz = (strcmp(texto, textoDe(raiz->pista)) < 0) ? raiz->esq : raiz->dir;
+    return raiz != NULL;
+}
+
+/*
+ * Consultas por posição
+ * O tamanho guardado em cada nó dá a posição (rank) de um texto e a k-ésima
+ * pista descendo uma vez da raiz, O(log n). Os cursores abertos numa posição
+ * ou a partir de um texto começam com a pilha do ORDEM_EM já montada na
+ * descida, então uma página de p pistas custa O(log n + p). Prefixos usam a
+ * ordem de strcmp: as pistas que começam com 'prefixo' são contíguas, entre
+ * a posição do próprio prefixo e a primeira pista cujos strlen(prefixo)
+ * primeiros bytes passam dele.
+ */
+
+// k-ésima pista em ordem alfabética (a partir de 0) ou NULL
+PistaNode* pistaNaPosicao(PistaNode *raiz, uint32_t k) {
+    while (raiz) {
+        uint32_t e = tamanhoPista(raiz->esq);
+        if (k == e) return raiz;
+        if (k < e) {
+            raiz = raiz->esq;
+        } else {
+            k -= e + 1;
+            raiz = raiz->dir;
+        }
+    }
+    return NULL;
+}
+
+// pistas menores que 'texto' (posição em que ele está ou entraria)
+uint32_t posicaoDaPista(PistaNode *raiz, const char *texto) {
+    uint32_t antes = 0;
+    while (raiz) {
+        if (strcmp(textoDe(raiz->pista), texto) < 0) {
+            antes += tamanhoPista(raiz->esq) + 1;
+            raiz = raiz->dir;
+        } else {
+            raiz = raiz->esq;
+        }
+    }
+    return antes;
+}
+
+// pistas até a última que começa com 'prefixo' (de len bytes), inclusive
+static uint32_t posicaoAposPrefixo(PistaNode *raiz, const char *prefixo, size_t len) {
+    uint32_t antes = 0;
+    while (raiz) {
+        if (strncmp(textoDe(raiz->pista), prefixo, len) <= 0) {
+            antes += tamanhoPista(raiz->esq) + 1;
+            raiz = raiz->dir;
+        } else {
+            raiz = raiz->esq;
+        }
+    }
+    return antes;
+}
+
+/*
+ * contarPistasComPrefixo: pistas que começam com 'prefixo'; em 'primeira'
+ * (se não for NULL) a posição da primeira delas.
+ */
+uint32_t contarPistasComPrefixo(PistaNode *raiz, const char *prefixo, uint32_t *primeira) {
+    uint32_t ini = posicaoDaPista(raiz, prefixo);
+    uint32_t fim = posicaoAposPrefixo(raiz, prefixo, strlen(prefixo));
+    if (primeira) *primeira = ini;
+    return fim > ini ? fim - ini : 0;
+}
+
+// cursor em ordem cujo primeiro nó é a k-ésima pista
+void abrirCursorPistasNaPosicao(CursorArvore *c, PistaNode *raiz, uint32_t k) {
+    abrirCursorPistas(c, NULL, ORDEM_EM);
+    while (raiz) {
+        uint32_t e = tamanhoPista(raiz->esq);
+        if (k <= e) {
+            empilharCursor(c, raiz);
+            if (k == e) break;
+            raiz = raiz->esq;
+        } else {
+            k -= e + 1;
+            raiz = raiz->dir;
+        }
+    }
+}
+
+// cursor em ordem cujo primeiro nó é a primeira pista >= 'desde'
+void abrirCursorPistasDesde(CursorArvore *c, PistaNode *raiz, const char *desde) {
+    abrirCursorPistas(c, NULL, ORDEM_EM);
+    while (raiz) {
+        if (strcmp(textoDe(raiz->pista), desde) >= 0) {
+            empilharCursor(c, raiz);
+            raiz = raiz->esq;
+        } else {
+            raiz = raiz->dir;
+        }
+    }
+}
+
+/*
+ * criarTabelaHash: cria tabela com endereçamento aberto (Robin Hood).
+ * 'm' é só uma sugestão de capacidade inicial; a tabela cresce sozinha.
+ * Chaves e valores são ids internados; só o vetor de entradas é da tabela.
+ */
+TabelaHash* criarTabelaHash(int m) {
+    TabelaHash *tab = (TabelaHash*) alocarMemoria(sizeof(TabelaHash), "malloc criarTabelaHash");
+    size_t cap = HASH_CAPACIDADE_MIN;
+    while (cap < (size_t) (m > 0 ? m : 0)) cap <<= 1;
+    tab->entradas = (HashEntry*) alocarZerada(cap, sizeof(HashEntry), "calloc criarTabelaHash");
+    tab->capacidade = cap;
+    tab->tamanho = 0;
+    tab->mapeada = 0;
+    return tab;
+}
+
+// distância da entrada na posição i até a sua posição ideal
+static size_t distanciaHash(const TabelaHash *tab, const HashEntry *e, size_t i) {
+    return (i - (size_t) (e->hash & (tab->capacidade - 1))) & (tab->capacidade - 1);
+}
+
+/*
+ * buscarEntradaHash: localiza a entrada da chave ou NULL.
+ * Como as chaves são internadas, basta comparar o hash de 64 bits guardado
+ * e o id. A busca para assim que encontra uma entrada mais próxima de casa
+ * do que a chave procurada (invariante Robin Hood).
+ */
+static HashEntry* buscarEntradaHash(const TabelaHash *tab, TextoId chave, uint64_t h) {
+    size_t mask = tab->capacidade - 1;
+    size_t i = (size_t) h & mask;
+    for (size_t dist = 0; ; dist++, i = (i + 1) & mask) {
+        HashEntry *e = &tab->entradas[i];
+        if (e->hash == 0 || distanciaHash(tab, e, i) < dist) return NULL;
+        if (e->hash == h && e->chave == chave) return e;
+    }
+}
+
+/*
+ * colocarEntradaHash: insere uma entrada nova (chave ausente) deslocando
+ * as entradas mais próximas de casa, sem verificar capacidade.
+ */
+static void colocarEntradaHash(TabelaHash *tab, HashEntry nova) {
+    size_t mask = tab->capacidade - 1;
+    size_t i = (size_t) nova.hash & mask;
+    for (size_t dist = 0; ; dist++, i = (i + 1) & mask) {
+        HashEntry *e = &tab->entradas[i];
+        if (e->hash == 0) {
+            *e = nova;
+            tab->tamanho++;
+            return;
+        }
+        size_t d = distanciaHash(tab, e, i);
+        if (d < dist) {
+            HashEntry tmp = *e;
+            *e = nova;
+            nova = tmp;
+            dist = d;
+        }
+    }
+}
+
+static void crescerTabelaHash(TabelaHash *tab) {
+    HashEntry *antigas = tab->entradas;
+    size_t capAntiga = tab->capacidade;
+    tab->capacidade = capAntiga * 2;
+    tab->entradas = (HashEntry*) alocarZerada(tab->capacidade, sizeof(HashEntry), "calloc crescerTabelaHash");
+    tab->tamanho = 0;
+    for (size_t i = 0; i < capAntiga; i++)
+        if (antigas[i].hash) colocarEntradaHash(tab, antigas[i]);
+    free(antigas);
+}
+
+// copia para o heap as entradas de uma tabela mapeada (antes de alterá-la)
+static void copiarEntradasMapeadas(TabelaHash *tab) {
+    HashEntry *e = (HashEntry*) alocarMemoria(tab->capacidade * sizeof(HashEntry), "malloc copiarEntradasMapeadas");
+    memcpy(e, tab->entradas, tab->capacidade * sizeof(HashEntry));
+    tab->entradas = e;
+    tab->mapeada = 0;
+}
+
+/*
+ * inserirNaHash: insere (chave->valor) na tabela; se a chave já existe,
+ * atualiza o valor. A chave é internada e o valor vira um suspeito cadastrado.
+ * Dobra a capacidade quando a ocupação passaria de 7/8.
+ */
+void inserirNaHash(TabelaHash *tab, const char *chave, const char *valor) {
+    INSTR_INICIO(t0);
+    TextoId idChave = internar(chave);
+    inserirNaHashId(tab, idChave, cadastrarSuspeito(valor));
+    INSTR_FIM(MEDIDA_INSERIR_HASH, t0, 1);
+}
+
+/*
+ * inserirNaHashId: como inserirNaHash, para chave internada e suspeito já
+ * cadastrado.
+ */
+void inserirNaHashId(TabelaHash *tab, TextoId idChave, SuspeitoId idValor) {
+    INSTR_INICIO(t0);
+    if (tab->mapeada) copiarEntradasMapeadas(tab);
+    uint64_t h = hashDoTexto(idChave);
+    HashEntry *e = buscarEntradaHash(tab, idChave, h);
+    if (e) {
+        // atualiza valor
+        e->valor = idValor;
+        INSTR_FIM(MEDIDA_INSERIR_HASH_ID, t0, 0);
+        return;
+    }
+    if ((tab->tamanho + 1) * 8 > tab->capacidade * 7) crescerTabelaHash(tab);
+    HashEntry nova;
+    nova.hash = h;
+    nova.chave = idChave;
+    nova.valor = idValor;
+    colocarEntradaHash(tab, nova);
+    INSTR_FIM(MEDIDA_INSERIR_HASH_ID, t0, 1);
+}
+
+/*
+ * encontrarSuspeitoId: versão por id internado (sem recalcular hash).
+ * Retorna o id do suspeito ou SUSPEITO_NENHUM.
+ */
+SuspeitoId encontrarSuspeitoId(const TabelaHash *tab, TextoId chave) {
+    if (chave == TEXTO_NENHUM) return SUSPEITO_NENHUM;
+    INSTR_INICIO(t0);
+    HashEntry *e = buscarEntradaHash(tab, chave, hashDoTexto(chave));
+    INSTR_FIM(MEDIDA_ENCONTRAR_SUSPEITO_ID, t0, e != NULL);
+    return e ? e->valor : SUSPEITO_NENHUM;
+}
+
+/*
+ * encontrarSuspeito: busca na tabela hash o suspeito correspondente a uma pista (chave).
+ * Retorna ponteiro para o valor (string) ou NULL se não achar.
+ */
+const char* encontrarSuspeito(TabelaHash *tab, const char *chave) {
+    INSTR_INICIO(t0);
+    SuspeitoId sus = encontrarSuspeitoId(tab, buscarTexto(chave));
+    INSTR_FIM(MEDIDA_ENCONTRAR_SUSPEITO, t0, sus != SUSPEITO_NENHUM);
+    return sus == SUSPEITO_NENHUM ? NULL : nomeDoSuspeito(sus);
+}
+
+/*
+ * liberarTabelaHash: libera o vetor de entradas (os textos são internados).
+ */
+void liberarTabelaHash(TabelaHash *tab) {
+    if (!tab->mapeada) free(tab->entradas);
+    free(tab);
+}
+
+/*
+ * Cadastro de suspeitos
+ * Cada suspeito recebe um SuspeitoId denso. A chave é o nome em minúsculas,
+ * normalizado uma única vez no cadastro, de modo que "Marido" e "marido"
+ * são o mesmo suspeito; o nome exibido é a primeira grafia cadastrada.
+ */
+static CadastroSuspeitos g_suspeitos;
+
+// copia 'nome' em minúsculas para 'dst' (truncando em cap-1 caracteres)
+static void normalizarNomeSuspeito(const char *nome, char *dst, size_t cap) {
+    copiarMinusculo(dst, nome, cap);
+}
+
+/*
+ * cadastrarSuspeito: devolve o id do suspeito, cadastrando-o se for novo.
+ */
+SuspeitoId cadastrarSuspeito(const char *nome) {
+    char chave[128];
+    normalizarNomeSuspeito(nome, chave, sizeof(chave));
+    if (!g_suspeitos.porChave) g_suspeitos.porChave = criarTabelaHash(0);
+    TextoId idChave = internar(chave);
+    SuspeitoId s = encontrarSuspeitoId(g_suspeitos.porChave, idChave);
+    if (s != SUSPEITO_NENHUM) return s;
+
+    if (g_suspeitos.mapeado) {
+        TextoId *nomes = (TextoId*) alocarMemoria((g_suspeitos.total + 1) * sizeof(TextoId), "malloc cadastrarSuspeito");
+        memcpy(nomes, g_suspeitos.nomes, g_suspeitos.total * sizeof(TextoId));
+        g_suspeitos.nomes = nomes;
+        g_suspeitos.cap = g_suspeitos.total + 1;
+        g_suspeitos.mapeado = 0;
+    }
+    if (g_suspeitos.total == g_suspeitos.cap) {
+        uint32_t cap = g_suspeitos.cap ? g_suspeitos.cap * 2 : 16;
+        g_suspeitos.nomes = (TextoId*) realocarMemoria(g_suspeitos.nomes, cap * sizeof(TextoId), "realloc cadastrarSuspeito");
+        g_suspeitos.cap = cap;
+    }
+    s = g_suspeitos.total++;
+    g_suspeitos.nomes[s] = internar(nome);
+    inserirNaHashId(g_suspeitos.porChave, idChave, s);
+    return s;
+}
+
+/*
+ * buscarSuspeito: id do suspeito pelo nome (sem diferenciar maiúsculas),
+ * ou SUSPEITO_NENHUM. Não cadastra nada.
+ */
+SuspeitoId buscarSuspeito(const char *nome) {
+    char chave[128];
+    if (!g_suspeitos.porChave) return SUSPEITO_NENHUM;
+    normalizarNomeSuspeito(nome, chave, sizeof(chave));
+    return encontrarSuspeitoId(g_suspeitos.porChave, buscarTexto(chave));
+}
+
+const char* nomeDoSuspeito(SuspeitoId s) {
+    return textoDe(g_suspeitos.nomes[s]);
+}
+
+uint32_t totalSuspeitos(void) {
+    return g_suspeitos.total;
+}
+
+void liberarSuspeitos(void) {
+    if (g_suspeitos.porChave) liberarTabelaHash(g_suspeitos.porChave);
+    if (!g_suspeitos.mapeado) free(g_suspeitos.nomes);
+    memset(&g_suspeitos, 0, sizeof(g_suspeitos));
+}
+
+/*
+ * Placar de evidências
+ * Mantém, para o caderno de uma sessão, quantas pistas coletadas citam cada
+ * suspeito e a soma dos seus pesos (os pontos; sem pesos no caso, iguais à
+ * contagem). É atualizado quando a sessão coleta uma pista nova, então a
+ * verificação de uma acusação não percorre o caderno.
+ */
+void iniciarPlacar(Placar *p) {
+    p->contagem = NULL;
+    p->pontos = NULL;
+    p->capacidade = 0;
+}
+
+// zera as contagens para uma nova sessão, mantendo os vetores
+void reiniciarPlacar(Placar *p) {
+    if (p->contagem) memset(p->contagem, 0, p->capacidade * sizeof(int));
+    if (p->pontos) memset(p->pontos, 0, p->capacidade * sizeof(int64_t));
+}
+
+// uma pista a mais (delta > 0) ou a menos para s, valendo 'pontos'
+void placarPontuar(Placar *p, SuspeitoId s, int delta, int pontos) {
+    if (s == SUSPEITO_NENHUM) return;
+    if (s >= p->capacidade) {
+        uint32_t cap = p->capacidade ? p->capacidade : 16;
+        while (cap <= s) cap *= 2;
+        p->contagem = (int*) realocarMemoria(p->contagem, cap * sizeof(int), "realloc placarPontuar");
+        p->pontos = (int64_t*) realocarMemoria(p->pontos, cap * sizeof(int64_t), "realloc placarPontuar");
+        memset(p->contagem + p->capacidade, 0, (cap - p->capacidade) * sizeof(int));
+        memset(p->pontos + p->capacidade, 0, (cap - p->capacidade) * sizeof(int64_t));
+        p->capacidade = cap;
+    }
+    p->contagem[s] += delta;
+    p->pontos[s] += pontos;
+}
+
+// pistas de peso 1 (sem pesos no caso)
+void placarSomar(Placar *p, SuspeitoId s, int delta) {
+    placarPontuar(p, s, delta, delta);
+}
+
+int placarContagem(const Placar *p, SuspeitoId s) {
+    return (s != SUSPEITO_NENHUM && s < p->capacidade) ? p->contagem[s] : 0;
+}
+
+int64_t placarPontos(const Placar *p, SuspeitoId s) {
+    return (s != SUSPEITO_NENHUM && s < p->capacidade) ? p->pontos[s] : 0;
+}
+
+// chave de ordenação do ranking: o qsort não precisa consultar o placar
+typedef struct PosicaoRanking {
+    int64_t pontos;
+    int contagem;
+    SuspeitoId suspeito;
+} PosicaoRanking;
+
+static int compararPorPontos(const void *a, const void *b) {
+    const PosicaoRanking *x = (const PosicaoRanking*) a, *y = (const PosicaoRanking*) b;
+    if (x->pontos != y->pontos) return (x->pontos < y->pontos) - (x->pontos > y->pontos);
+    if (x->contagem != y->contagem) return (x->contagem < y->contagem) - (x->contagem > y->contagem);
+    return (x->suspeito > y->suspeito) - (x->suspeito < y->suspeito);
+}
+
+/*
+ * rankingSuspeitos: preenche 'saida' (capacidade totalSuspeitos()) com os
+ * suspeitos em ordem decrescente de pontos (e de pistas, no empate).
+ * Retorna quantos. Sessões em threads diferentes podem chamá-la ao mesmo
+ * tempo: a ordenação não usa estado global.
+ */
+uint32_t rankingSuspeitos(const Placar *p, SuspeitoId *saida) {
+    uint32_t n = totalSuspeitos();
+    PosicaoRanking *posicoes = (PosicaoRanking*) alocarMemoria((size_t) n * sizeof(PosicaoRanking) + 1, "malloc rankingSuspeitos");
+    for (uint32_t s = 0; s < n; s++) {
+        posicoes[s].pontos = placarPontos(p, s);
+        posicoes[s].contagem = placarContagem(p, s);
+        posicoes[s].suspeito = s;
+    }
+    qsort(posicoes, n, sizeof(PosicaoRanking), compararPorPontos);
+    for (uint32_t i = 0; i < n; i++) saida[i] = posicoes[i].suspeito;
+    free(posicoes);
+    return n;
+}
+
+void liberarPlacar(Placar *p) {
+    free(p->contagem);
+    free(p->pontos);
+    p->contagem = NULL;
+    p->pontos = NULL;
+    p->capacidade = 0;
+}
+
+/*
+ * Pesos de evidência
+ * Cada pista do caso tem um vetor esparso de (suspeito, peso), guardado em
+ * Caso.pesos na ordem dos ids densos, com o início de cada pista em
+ * Caso.inicioPesos (ver montarPesos). O vetor de uma pista é o suspeito da
+ * tabela hash com peso 1, alterado pelas linhas P do caso: um peso para
+ * outro suspeito acrescenta uma entrada, um peso para o mesmo suspeito
+ * substitui o 1 e peso 0 remove a entrada. Coletar uma pista soma o vetor
+ * ao placar da sessão (pontuarPista), então o veredito e o ranking leem só
+ * o placar, sem percorrer o caderno. Um caso sem linhas P não tem vetores
+ * (inicioPesos NULL) e se comporta como a regra "pistas >= 2".
+ */
+void iniciarRegras(RegrasEvidencia *r) {
+    memset(r, 0, sizeof(*r));
+    r->limiarSustentar = PISTAS_PARA_SUSTENTAR;
+    r->limiarInocentar = LIMIAR_INOCENTAR_PADRAO;
+}
+
+// acrescenta o peso da pista para o suspeito (o último peso do par vale)
+void adicionarPeso(RegrasEvidencia *r, const char *pista, const char *suspeito, int32_t peso) {
+    if (r->total == r->cap) {
+        r->cap = r->cap ? r->cap * 2 : 16;
+        r->pistas = (TextoId*) realocarMemoria(r->pistas, r->cap * sizeof(TextoId), "realloc adicionarPeso");
+        r->pesos = (PesoEvidencia*) realocarMemoria(r->pesos, r->cap * sizeof(PesoEvidencia), "realloc adicionarPeso");
+    }
+    r->pistas[r->total] = internar(pista);
+    r->pesos[r->total].suspeito = cadastrarSuspeito(suspeito);
+    r->pesos[r->total].peso = peso;
+    r->total++;
+}
+
+void liberarRegras(RegrasEvidencia *r) {
+    free(r->pistas);
+    free(r->pesos);
+    iniciarRegras(r);
+}
+
+/*
+ * Carga em lote de evidências
+ * Despejos com milhões de pares pista -> suspeito não passam um a um por
+ * inserirNaHash e inserirPistaIterativa. carregarEvidencias:
+ *   1. calcula os hashes dos textos em paralelo;
+ *   2. interna pistas e cadastra suspeitos na ordem de entrada (cadastros
+ *      globais, sequenciais; os ids saem iguais aos da inserção um a um);
+ *   3. ordena os pares por texto da pista (e ordem de entrada) com blocos
+ *      ordenados em paralelo e intercalados dois a dois, também em paralelo;
+ *   4. mantém a última ocorrência de cada pista (como inserirNaHash, em que
+ *      a última associação vence);
+ *   5. monta o índice de pistas (AVL perfeitamente balanceada) direto do
+ *      vetor ordenado, em O(n) e sem comparações, num único bloco da arena;
+ *   6. cria a tabela já no tamanho final e a preenche em faixas de posições
+ *      em paralelo: cada thread insere (Robin Hood) as entradas cuja posição
+ *      ideal cai na sua faixa, sem passar do fim dela; as poucas que
+ *      passariam são inseridas no fim, normalmente.
+ */
+#define CARGA_FAIXAS_POR_THREAD 8
+
+typedef struct ItemEvidencia {
+    TextoId pista;
+    SuspeitoId suspeito;
+    uint32_t ordem;         // posição na entrada (desempate: a última vence)
+} ItemEvidencia;
+
+static int compararItensEvidencia(const void *a, const void *b) {
+    const ItemEvidencia *x = (const ItemEvidencia*) a, *y = (const ItemEvidencia*) b;
+    if (x->pista != y->pista) {
+        int c = strcmp(textoDe(x->pista), textoDe(y->pista));
+        if (c) return c;
+    }
+    return (x->ordem > y->ordem) - (x->ordem < y->ordem);
+}
+
+/*
+ * paralelizar: roda rotina(args + i*passo) para i em [0, n), uma thread por
+ * item (o item 0 na thread chamadora). Se uma thread não puder ser criada,
+ * o item roda na própria thread chamadora.
+ */
+static void paralelizar(int n, void *(*rotina)(void*), void *args, size_t passo) {
+    pthread_t *threads = (pthread_t*) alocarMemoria((size_t) (n > 1 ? n : 1) * sizeof(pthread_t), "malloc paralelizar");
+    char *criadas = (char*) alocarZerada((size_t) (n > 1 ? n : 1), 1, "calloc paralelizar");
+    for (int i = 1; i < n; i++)
+        criadas[i] = pthread_create(&threads[i], NULL, rotina, (char*) args + (size_t) i * passo) == 0;
+    if (n > 0) rotina(args);
+    for (int i = 1; i < n; i++) {
+        if (criadas[i]) pthread_join(threads[i], NULL);
+        else rotina((char*) args + (size_t) i * passo);
+    }
+    free(criadas);
+    free(threads);
+}
+
+typedef struct TarefaCarga {
+    const ParEvidencia *pares;
+    uint64_t *hashPista, *hashSuspeito;
+    ItemEvidencia *origem, *destino;
+    size_t ini, meio, fim;          // hashes/ordenação: [ini, fim); intercalação: [ini, meio) + [meio, fim)
+    // preenchimento da tabela
+    TabelaHash *tab;
+    const HashEntry *entradas;      // entradas agrupadas por faixa
+    const size_t *inicioFaixa;      // entradas da faixa f em [inicioFaixa[f], inicioFaixa[f + 1])
+    size_t larguraFaixa;
+    int primeiraFaixa, passoFaixa, totalFaixas;
+    HashEntry *sobras;
+    size_t totalSobras, capSobras, colocadas;
+} TarefaCarga;
+
+static void* calcularHashesCarga(void *arg) {
+    TarefaCarga *t = (TarefaCarga*) arg;
+    for (size_t i = t->ini; i < t->fim; i++) {
+        t->hashPista[i] = hashString(t->pares[i].pista);
+        t->hashSuspeito[i] = hashString(t->pares[i].suspeito);
+    }
+    return NULL;
+}
+
+static void* ordenarBlocoCarga(void *arg) {
+    TarefaCarga *t = (TarefaCarga*) arg;
+    qsort(t->origem + t->ini, t->fim - t->ini, sizeof(ItemEvidencia), compararItensEvidencia);
+    return NULL;
+}
+
+static void* intercalarCarga(void *arg) {
+    TarefaCarga *t = (TarefaCarga*) arg;
+    size_t i = t->ini, j = t->meio, k = t->ini;
+    while (i < t->meio && j < t->fim)
+        t->destino[k++] = compararItensEvidencia(&t->origem[j], &t->origem[i]) < 0 ? t->origem[j++] : t->origem[i++];
+    while (i < t->meio) t->destino[k++] = t->origem[i++];
+    while (j < t->fim) t->destino[k++] = t->origem[j++];
+    return NULL;
+}
+
+/*
+ * colocarNaFaixa: colocarEntradaHash restrita às posições antes de 'fim'.
+ * Se a sequência de sondagem chegaria a 'fim', a entrada que estiver sendo
+ * carregada naquele momento (a nova ou uma deslocada) volta em *sobra.
+ */
+static int colocarNaFaixa(TabelaHash *tab, HashEntry nova, size_t fim, HashEntry *sobra) {
+    size_t i = (size_t) nova.hash & (tab->capacidade - 1);
+    for (size_t dist = 0; ; dist++, i++) {
+        if (i == fim) {
+            *sobra = nova;
+            return 1;
+        }
+        HashEntry *e = &tab->entradas[i];
+        if (e->hash == 0) {
+            *e = nova;
+            return 0;
+        }
+        size_t d = distanciaHash(tab, e, i);
+        if (d < dist) {
+            HashEntry tmp = *e;
+            *e = nova;
+            nova = tmp;
+            dist = d;
+        }
+    }
+}
+
+static void* preencherFaixasCarga(void *arg) {
+    TarefaCarga *t = (TarefaCarga*) arg;
+    for (int f = t->primeiraFaixa; f < t->totalFaixas; f += t->passoFaixa) {
+        size_t fim = (size_t) (f + 1) * t->larguraFaixa;
+        for (size_t k = t->inicioFaixa[f]; k < t->inicioFaixa[f + 1]; k++) {
+            HashEntry sobra;
+            if (!colocarNaFaixa(t->tab, t->entradas[k], fim, &sobra)) {
+                t->colocadas++;
+                continue;
+            }
+            // sobrou uma entrada (a nova ou uma deslocada): vai para o fim
+            if (t->totalSobras == t->capSobras) {
+                t->capSobras = t->capSobras ? t->capSobras * 2 : 16;
+                t->sobras = (HashEntry*) realocarMemoria(t->sobras, t->capSobras * sizeof(HashEntry), "realloc preencherFaixasCarga");
+            }
+            t->sobras[t->totalSobras++] = sobra;
+        }
+    }
+    return NULL;
+}
+
+// liga o vetor ordenado de nós numa AVL perfeitamente balanceada (meio de cada faixa como raiz)
+static PistaNode* montarIndiceBalanceado(PistaNode *nos, size_t n) {
+    typedef struct { size_t ini, fim; PistaNode **ref; } Faixa;
+    Faixa pilha[PISTA_ALTURA_MAX * 2];
+    int topo = 0;
+    PistaNode *raiz = NULL;
+    if (n > 0) pilha[topo++] = (Faixa) { 0, n, &raiz };
+    while (topo > 0) {
+        Faixa f = pilha[--topo];
+        size_t meio = f.ini + (f.fim - f.ini) / 2;
+        PistaNode *no = &nos[meio];
+        *f.ref = no;
+        no->tamanho = (uint32_t) (f.fim - f.ini);
+        no->altura = 64 - __builtin_clzll((unsigned long long) (f.fim - f.ini)); // floor(log2(tamanho)) + 1
+        no->esq = no->dir = NULL;
+        if (meio > f.ini) pilha[topo++] = (Faixa) { f.ini, meio, &no->esq };
+        if (f.fim > meio + 1) pilha[topo++] = (Faixa) { meio + 1, f.fim, &no->dir };
+    }
+    return raiz;
+}
+
+/*
+ * carregarEvidencias: monta uma tabela pista -> suspeito nova com os n pares
+ * (a última associação de cada pista vence) e, se 'indice' e 'arena' forem
+ * dados, a AVL com as pistas distintas. Equivale a chamar inserirNaHash e
+ * inserirPistaIterativa para cada par, em ordem.
+ */
+TabelaHash* carregarEvidencias(const ParEvidencia *pares, size_t n, int nThreads, Arena *arena, PistaNode **indice) {
+    if (nThreads < 1) nThreads = 1;
+    if ((size_t) nThreads > n / 1024 + 1) nThreads = (int) (n / 1024 + 1); // blocos pequenos não compensam
+    TarefaCarga *tarefas = (TarefaCarga*) alocarZerada((size_t) nThreads, sizeof(TarefaCarga), "calloc carregarEvidencias");
+
+    // 1. hashes em paralelo
+    uint64_t *hashes = (uint64_t*) alocarMemoria((2 * n + 1) * sizeof(uint64_t), "malloc carregarEvidencias");
+    for (int t = 0; t < nThreads; t++) {
+        tarefas[t].pares = pares;
+        tarefas[t].hashPista = hashes;
+        tarefas[t].hashSuspeito = hashes + n;
+        tarefas[t].ini = n * (size_t) t / (size_t) nThreads;
+        tarefas[t].fim = n * (size_t) (t + 1) / (size_t) nThreads;
+    }
+    paralelizar(nThreads, calcularHashesCarga, tarefas, sizeof(TarefaCarga));
+
+    // 2. internação e cadastro, em ordem (cache de suspeitos por hash do nome)
+    ItemEvidencia *itens = (ItemEvidencia*) alocarMemoria((n + 1) * sizeof(ItemEvidencia), "malloc carregarEvidencias");
+    ItemEvidencia *aux = (ItemEvidencia*) alocarMemoria((n + 1) * sizeof(ItemEvidencia), "malloc carregarEvidencias");
+    struct { uint64_t hash; const char *nome; SuspeitoId id; } cache[256];
+    memset(cache, 0, sizeof(cache));
+    for (size_t i = 0; i < n; i++) {
+        uint64_t hs = hashes[n + i];
+        unsigned c = (unsigned) (hs & 255);
+        itens[i].pista = internarComHash(pares[i].pista, hashes[i]);
+        if (!(cache[c].nome && cache[c].hash == hs && strcmp(cache[c].nome, pares[i].suspeito) == 0)) {
+            cache[c].hash = hs;
+            cache[c].nome = pares[i].suspeito;
+            cache[c].id = cadastrarSuspeito(pares[i].suspeito);
+        }
+        itens[i].suspeito = cache[c].id;
+        itens[i].ordem = (uint32_t) i;
+    }
+    free(hashes);
+
+    // 3. ordenação: blocos em paralelo, depois intercalação dois a dois
+    for (int t = 0; t < nThreads; t++) tarefas[t].origem = itens;
+    paralelizar(nThreads, ordenarBlocoCarga, tarefas, sizeof(TarefaCarga));
+    size_t *limites = (size_t*) alocarMemoria(((size_t) nThreads + 1) * sizeof(size_t), "malloc carregarEvidencias");
+    for (int t = 0; t <= nThreads; t++) limites[t] = n * (size_t) t / (size_t) nThreads;
+    int blocos = nThreads;
+    while (blocos > 1) {
+        int pares2 = blocos / 2;
+        for (int k = 0; k < pares2; k++) {
+            tarefas[k].origem = itens;
+            tarefas[k].destino = aux;
+            tarefas[k].ini = limites[2 * k];
+            tarefas[k].meio = limites[2 * k + 1];
+            tarefas[k].fim = limites[2 * k + 2];
+        }
+        paralelizar(pares2, intercalarCarga, tarefas, sizeof(TarefaCarga));
+        if (blocos % 2) // bloco ímpar no fim: só copia
+            memcpy(aux + limites[blocos - 1], itens + limites[blocos - 1], (n - limites[blocos - 1]) * sizeof(ItemEvidencia));
+        for (int k = 0; k <= pares2; k++) limites[k] = limites[2 * k < blocos ? 2 * k : blocos];
+        limites[(blocos + 1) / 2] = n;
+        blocos = (blocos + 1) / 2;
+        ItemEvidencia *tmp = itens; itens = aux; aux = tmp;
+    }
+    free(limites);
+    free(aux);
+
+    // 4. última ocorrência de cada pista
+    size_t m = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (i + 1 < n && itens[i + 1].pista == itens[i].pista) continue;
+        itens[m++] = itens[i];
+    }
+
+    // 5. índice balanceado
+    if (indice && arena) {
+        PistaNode *nos = (PistaNode*) arenaAlocar(arena, (m ? m : 1) * sizeof(PistaNode));
+        for (size_t k = 0; k < m; k++) nos[k].pista = itens[k].pista;
+        *indice = montarIndiceBalanceado(nos, m);
+    }
+
+    // 6. tabela no tamanho final, preenchida por faixas
+    size_t necessario = m * 8 / 7 + 1;
+    TabelaHash *tab = criarTabelaHash(necessario > (size_t) INT32_MAX ? INT32_MAX : (int) necessario);
+    int faixas = 1;
+    while (faixas < nThreads * CARGA_FAIXAS_POR_THREAD && (size_t) faixas * 64 < tab->capacidade) faixas *= 2;
+    size_t largura = tab->capacidade / (size_t) faixas;
+    HashEntry *entradas = (HashEntry*) alocarMemoria((m + 1) * sizeof(HashEntry), "malloc carregarEvidencias");
+    size_t *inicioFaixa = (size_t*) alocarZerada((size_t) faixas + 1, sizeof(size_t), "calloc carregarEvidencias");
+    for (size_t k = 0; k < m; k++)
+        inicioFaixa[((size_t) hashDoTexto(itens[k].pista) & (tab->capacidade - 1)) / largura + 1]++;
+    for (int f = 0; f < faixas; f++) inicioFaixa[f + 1] += inicioFaixa[f];
+    {
+        size_t *proxima = (size_t*) alocarMemoria((size_t) faixas * sizeof(size_t), "malloc carregarEvidencias");
+        memcpy(proxima, inicioFaixa, (size_t) faixas * sizeof(size_t));
+        for (size_t k = 0; k < m; k++) {
+            HashEntry e;
+            e.hash = hashDoTexto(itens[k].pista);
+            e.chave = itens[k].pista;
+            e.valor = itens[k].suspeito;
+            entradas[proxima[((size_t) e.hash & (tab->capacidade - 1)) / largura]++] = e;
+        }
+        free(proxima);
+    }
+    free(itens);
+    int nFaixas = nThreads < faixas ? nThreads : faixas;
+    for (int t = 0; t < nFaixas; t++) {
+        TarefaCarga *tc = &tarefas[t];
+        memset(tc, 0, sizeof(*tc));
+        tc->tab = tab;
+        tc->entradas = entradas;
+        tc->inicioFaixa = inicioFaixa;
+        tc->larguraFaixa = largura;
+        tc->primeiraFaixa = t;
+        tc->passoFaixa = nFaixas;
+        tc->totalFaixas = faixas;
+    }
+    paralelizar(nFaixas, preencherFaixasCarga, tarefas, sizeof(TarefaCarga));
+    tab->tamanho = 0;
+    for (int t = 0; t < nFaixas; t++) tab->tamanho += tarefas[t].colocadas;
+    for (int t = 0; t < nFaixas; t++) {
+        for (size_t k = 0; k < tarefas[t].totalSobras; k++) colocarEntradaHash(tab, tarefas[t].sobras[k]);
+        free(tarefas[t].sobras);
+    }
+    free(entradas);
+    free(inicioFaixa);
+    free(tarefas);
+    return tab;
+}
+
+/*
+ * Catálogo fixo sala -> pista
+ * As pistas são definidas por conteúdo codificado. Em vez de comparar o nome
+ * da sala com cada entrada, o catálogo é internado uma vez e vira um vetor
+ * indexado pelo TextoId do nome da sala: consultar a pista de uma sala custa
+ * um acesso ao vetor, qualquer que seja o tamanho do catálogo.
+ */
+static const char *const CATALOGO_PISTAS[][2] = {
+    { "Entrada", "pegadas molhadas" },
+    { "Sala de Estar", "charuto queimado" },
+    { "Biblioteca", "marcador de livro rasgado" },
+    { "Cozinha", "pegador de panelas sujo" },
+    { "Quarto Principal", "fio de tecido vermelho" },
+    { "Banheiro", "batom no lavatório" },
+    { "Escritorio", "recibo rasgado" },
+    { "Jardim", "sementes pisoteadas" },
+};
+
+static TextoId *g_pistaPorNome;     // g_pistaPorNome[nome da sala] = pista
+static uint32_t g_totalPistaPorNome;
+
+static void montarCatalogoPistas(void) {
+    size_t n = sizeof(CATALOGO_PISTAS) / sizeof(CATALOGO_PISTAS[0]);
+    TextoId salas[sizeof(CATALOGO_PISTAS) / sizeof(CATALOGO_PISTAS[0])];
+    TextoId pistas[sizeof(CATALOGO_PISTAS) / sizeof(CATALOGO_PISTAS[0])];
+    uint32_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        salas[i] = internar(CATALOGO_PISTAS[i][0]);
+        pistas[i] = internar(CATALOGO_PISTAS[i][1]);
+        if (salas[i] + 1 > total) total = salas[i] + 1;
+    }
+    g_pistaPorNome = (TextoId*) alocarMemoria(total * sizeof(TextoId), "malloc montarCatalogoPistas");
+    memset(g_pistaPorNome, 0xFF, total * sizeof(TextoId));
+    for (size_t i = 0; i < n; i++) g_pistaPorNome[salas[i]] = pistas[i];
+    g_totalPistaPorNome = total;
+}
+
+static void descartarCatalogoPistas(void) {
+    free(g_pistaPorNome);
+    g_pistaPorNome = NULL;
+    g_totalPistaPorNome = 0;
+}
+
+/*
+ * pistaDaSala: pista estática da sala (pelo id do nome), segundo o catálogo.
+ * Retorna o id internado da pista. Se retornar TEXTO_NENHUM, sala não tem pista.
+ */
+TextoId pistaDaSala(TextoId nomeSala) {
+    if (!g_pistaPorNome) montarCatalogoPistas();
+    return nomeSala < g_totalPistaPorNome ? g_pistaPorNome[nomeSala] : TEXTO_NENHUM;
+}
+
+/*
+ * trim_newline: remove '\n' final de uma string capturada por fgets
+ */
+void trim_newline(char *s) {
+    if (!s) return;
+    size_t len = strlen(s);
+    if (len == 0) return;
+    if (s[len-1] == '\n') s[len-1] = '\0';
+}
+
+// relógio monotônico em segundos (medições de vazão)
+static double agoraSegundos(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/*
+ * minusculo: converte string para minúsculas (útil para comparação de nomes de suspeitos)
+ */
+void minusculo(char *s) {
+    copiarMinusculo(s, s, strlen(s) + 1);
+}
+
+/*
+ * Saída
+ * Tudo o que a exploração e as listagens escrevem vai para um buffer da
+ * Saida, reaproveitado entre passos (cresce só até o maior passo/listagem),
+ * e segue para o descritor com um único write por descarga: um por passo da
+ * exploração (antes de ler o próximo comando) e um por listagem (ou por
+ * SAIDA_LOTE bytes, se a listagem for maior). Em
+ * SAIDA_JSON as mesmas funções escrevem um objeto por linha, com o campo
+ * "evento", em vez das mensagens e prompts.
+ * Descarregar na saída padrão esvazia antes o buffer do stdio, para que o
+ * que ainda for escrito com printf não saia fora de ordem.
+ */
+void iniciarSaida(Saida *s, int fd, FormatoSaida formato) {
+    s->fd = fd;
+    s->formato = formato;
+    s->buf = (char*) alocarMemoria(SAIDA_INICIAL, "malloc iniciarSaida");
+    s->usado = 0;
+    s->cap = SAIDA_INICIAL;
+    s->escritas = 0;
+}
+
+static void reservarSaida(Saida *s, size_t bytes) {
+    if (s->cap - s->usado >= bytes) return;
+    while (s->cap - s->usado < bytes) s->cap *= 2;
+    s->buf = (char*) realocarMemoria(s->buf, s->cap, "realloc reservarSaida");
+}
+
+// como printf, acrescentando ao buffer
+void escreverSaida(Saida *s, const char *fmt, ...) {
+    for (;;) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(s->buf + s->usado, s->cap - s->usado, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t) n < s->cap - s->usado) {
+            s->usado += (size_t) n;
+            return;
+        }
+        reservarSaida(s, (size_t) n + 1);
+    }
+}
+
+// 'texto' como string JSON (entre aspas, com escapes); bytes UTF-8 passam como estão
+void escreverJsonTexto(Saida *s, const char *texto) {
+    static const char hex[] = "0123456789abcdef";
+    size_t len = strlen(texto);
+    reservarSaida(s, len * 6 + 3);
+    char *o = s->buf + s->usado;
+    *o++ = '"';
+    for (const unsigned char *p = (const unsigned char*) texto; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            *o++ = '\\';
+            *o++ = (char) *p;
+        } else if (*p < 0x20) {
+            memcpy(o, "\\u00", 4);
+            o[4] = hex[*p >> 4];
+            o[5] = hex[*p & 15];
+            o += 6;
+        } else {
+            *o++ = (char) *p;
+        }
+    }
+    *o++ = '"';
+    s->usado = (size_t) (o - s->buf);
+}
+
+/*
+ * descarregarSaida: escreve o buffer no descritor (um write, repetido só se
+ * o kernel aceitar parte) e o esvazia. Retorna 0 ou -1.
+ */
+int descarregarSaida(Saida *s) {
+    if (s->fd < 0 || s->usado == 0) {
+        if (s->fd < 0) s->usado = 0;
+        return 0;
+    }
+    if (s->fd == STDOUT_FILENO) fflush(stdout);
+    size_t feito = 0;
+    while (feito < s->usado) {
+        ssize_t n = write(s->fd, s->buf + feito, s->usado - feito);
+        s->escritas++;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            s->usado = 0;
+            return -1;
+        }
+        feito += (size_t) n;
+    }
+    s->usado = 0;
+    return 0;
+}
+
+void liberarSaida(Saida *s) {
+    descarregarSaida(s);
+    free(s->buf);
+    s->buf = NULL;
+    s->usado = s->cap = 0;
+}
+
+/*
+ * Índice de caminhos
+ * Montado uma vez com o caso. Uma pré-ordem a partir da raiz dá a cada sala
+ * a faixa [entrada, saida) ocupada pela sua subárvore: 'a' é ancestral de
+ * 'b' se a faixa de 'a' contém a de 'b' (O(1)). Ponteiros de salto (de
+ * comprimentos em binário assimétrico, como em listas de acesso aleatório)
+ * sobem O(log n) salas por consulta, e com o teste de ancestral acham o
+ * ancestral comum em O(log n) e O(n) de memória. Prefixos das salas com
+ * pista na pré-ordem contam as pistas de uma subárvore em O(1).
+ * Só se anda para baixo ([e]/[d]) ou de volta à raiz ([r]), então a rota
+ * até uma sala que não está abaixo da atual passa pela entrada.
+ * A mansão procedural não tem índice: na numeração de heap o pai de i é
+ * (i-1)/2 e a profundidade é o número de bits de i+1 menos um, então as
+ * mesmas consultas saem de aritmética sobre os índices.
+ */
+static void montarCaminhos(Caso *caso) {
+    const Mansao *m = &caso->mansao;
+    IndiceCaminhos *ic = &caso->caminhos;
+    if (m->procedural) return;
+    uint32_t n = m->total;
+    size_t bytes = ((size_t) n + 1) * sizeof(uint32_t);
+    ic->pai = (uint32_t*) alocarMemoria(bytes, "malloc montarCaminhos");
+    ic->salto = (uint32_t*) alocarMemoria(bytes, "malloc montarCaminhos");
+    ic->profundidade = (uint32_t*) alocarMemoria(bytes, "malloc montarCaminhos");
+    ic->entrada = (uint32_t*) alocarMemoria(bytes, "malloc montarCaminhos");
+    ic->saida = (uint32_t*) alocarMemoria(bytes, "malloc montarCaminhos");
+    ic->ordem = (uint32_t*) alocarMemoria(bytes, "malloc montarCaminhos");
+    ic->pistasAntes = (uint32_t*) alocarMemoria(bytes, "malloc montarCaminhos");
+    for (uint32_t i = 0; i < n; i++) {
+        ic->pai[i] = ic->salto[i] = ic->entrada[i] = SALA_NENHUMA;
+        ic->profundidade[i] = 0;
+        ic->saida[i] = 0;
+    }
+
+    // pré-ordem com pilha explícita; o pai é visitado antes dos filhos, então
+    // o salto do filho sai do salto do pai
+    uint32_t *pilha = (uint32_t*) alocarMemoria(bytes, "malloc montarCaminhos");
+    uint32_t topo = 0, k = 0;
+    if (n > 0) {
+        pilha[topo++] = m->raiz;
+        ic->salto[m->raiz] = m->raiz;
+    }
+    while (topo > 0) {
+        uint32_t v = pilha[--topo];
+        ic->entrada[v] = k;
+        ic->ordem[k++] = v;
+        uint32_t filhos[2] = { m->salas[v].dir, m->salas[v].esq }; // esquerda sai primeiro
+        for (int f = 0; f < 2; f++) {
+            uint32_t w = filhos[f];
+            if (w == SALA_NENHUMA || w >= n || ic->salto[w] != SALA_NENHUMA) continue; // arquivos malformados
+            uint32_t s1 = ic->salto[v], s2 = ic->salto[s1];
+            ic->pai[w] = v;
+            ic->profundidade[w] = ic->profundidade[v] + 1;
+            ic->salto[w] = (v != m->raiz && ic->profundidade[v] - ic->profundidade[s1] == ic->profundidade[s1] - ic->profundidade[s2]) ? s2 : v;
+            pilha[topo++] = w;
+        }
+    }
+    free(pilha);
+    ic->alcancaveis = k;
+
+    // fim das subárvores: filhos vêm depois do pai na pré-ordem
+    for (uint32_t j = k; j-- > 0;) {
+        uint32_t v = ic->ordem[j];
+        if (ic->saida[v] < j + 1) ic->saida[v] = j + 1;
+        if (ic->pai[v] != SALA_NENHUMA && ic->saida[ic->pai[v]] < ic->saida[v]) ic->saida[ic->pai[v]] = ic->saida[v];
+    }
+    ic->pistasAntes[0] = 0;
+    for (uint32_t j = 0; j < k; j++)
+        ic->pistasAntes[j + 1] = ic->pistasAntes[j] + (m->salas[ic->ordem[j]].pista != TEXTO_NENHUM);
+
+    ic->totalNomes = g_textos.total;
+    ic->salaPorNome = (uint32_t*) alocarMemoria(((size_t) ic->totalNomes + 1) * sizeof(uint32_t), "malloc montarCaminhos");
+    memset(ic->salaPorNome, 0xFF, ((size_t) ic->totalNomes + 1) * sizeof(uint32_t));
+    for (uint32_t i = n; i-- > 0;) {
+        TextoId nome = m->salas[i].nome;
+        if (nome < ic->totalNomes) ic->salaPorNome[nome] = i;
+    }
+}
+
+/*
+ * calcularImpressao: identifica o caso pelas salas e pelos textos das
+ * pistas densas (hashes já guardados com os textos), para que uma sessão
+ * salva não seja restaurada sobre outro caso.
+ */
+static void calcularImpressao(Caso *caso) {
+    uint64_t h[3] = { caso->mansao.total, caso->mansao.raiz, caso->totalPistas };
+    uint64_t acc = hashBytes(h, sizeof(h));
+    if (caso->mansao.procedural) acc = misturarSemente(caso->mansao.semente, acc);
+    // a sala atual de uma sessão salva é um índice: a numeração das salas (congelarMansao) faz parte do caso
+    for (uint32_t i = 0; !caso->mansao.procedural && i < caso->mansao.total; i++)
+        acc = (acc ^ ((uint64_t) caso->mansao.salas[i].esq << 32 | caso->mansao.salas[i].dir)) * 0x9E3779B97F4A7C15ULL;
+    for (uint32_t d = 0; d < caso->totalPistas; d++)
+        acc = (acc ^ hashDoTexto(caso->indicePistas[d])) * 0x9E3779B97F4A7C15ULL;
+    caso->impressao = acc ^ (acc >> 29);
+}
+
+static void liberarCaminhos(IndiceCaminhos *ic) {
+    free(ic->pai);
+    free(ic->salto);
+    free(ic->profundidade);
+    free(ic->entrada);
+    free(ic->saida);
+    free(ic->ordem);
+    free(ic->pistasAntes);
+    free(ic->salaPorNome);
+    memset(ic, 0, sizeof(*ic));
+}
+
+/*
+ * salaPorNome: índice da sala com esse nome (exato; se não houver, sem
+ * diferenciar maiúsculas) ou SALA_NENHUMA.
+ */
+uint32_t salaPorNome(const Caso *caso, const char *nome) {
+    const IndiceCaminhos *ic = &caso->caminhos;
+    if (caso->mansao.procedural) {
+        // o índice vem no fim do nome; confere regerando o nome da sala
+        char gerado[NOME_SALA_MAX];
+        const char *num = strrchr(nome, ' ');
+        char *fim;
+        unsigned long sala = num ? strtoul(num + 1, &fim, 10) : caso->mansao.raiz;
+        if (num && (*fim != '\0' || fim == num + 1)) return SALA_NENHUMA;
+        if (sala >= caso->mansao.total) return SALA_NENHUMA;
+        gerarSala(&caso->mansao, (uint32_t) sala, gerado, NULL);
+        return iguaisSemCaixa(gerado, nome) ? (uint32_t) sala : SALA_NENHUMA;
+    }
+    TextoId id = buscarTexto(nome);
+    if (id != TEXTO_NENHUM && id < ic->totalNomes && ic->salaPorNome[id] != SALA_NENHUMA)
+        return ic->salaPorNome[id];
+    for (uint32_t i = 0; i < caso->mansao.total; i++)
+        if (caso->mansao.salas[i].nome != TEXTO_NENHUM && iguaisSemCaixa(textoDe(caso->mansao.salas[i].nome), nome))
+            return i;
+    return SALA_NENHUMA;
+}
+
+// profundidade de uma sala da mansão procedural (numeração de heap)
+static uint32_t profundidadeNoHeap(uint32_t sala) {
+    uint32_t p = 0;
+    for (uint64_t x = (uint64_t) sala + 1; x > 1; x >>= 1) p++;
+    return p;
+}
+
+// ancestral de 'sala' 'subir' níveis acima, na numeração de heap
+static uint32_t subirNoHeap(uint32_t sala, uint32_t subir) {
+    return (uint32_t) ((((uint64_t) sala + 1) >> subir) - 1);
+}
+
+static uint32_t profundidadeDaSala(const Caso *caso, uint32_t sala) {
+    return caso->mansao.procedural ? profundidadeNoHeap(sala) : caso->caminhos.profundidade[sala];
+}
+
+/*
+ * ehAncestral: 1 se 'a' está no caminho da raiz até 'b' (inclusive a == b).
+ */
+int ehAncestral(const Caso *caso, uint32_t a, uint32_t b) {
+    const IndiceCaminhos *ic = &caso->caminhos;
+    if (caso->mansao.procedural) {
+        if (a >= caso->mansao.total || b >= caso->mansao.total) return 0;
+        uint32_t pa = profundidadeNoHeap(a), pb = profundidadeNoHeap(b);
+        return pa <= pb && subirNoHeap(b, pb - pa) == a;
+    }
+    if (ic->entrada[a] == SALA_NENHUMA || ic->entrada[b] == SALA_NENHUMA) return 0;
+    return ic->entrada[a] <= ic->entrada[b] && ic->saida[b] <= ic->saida[a];
+}
+
+/*
+ * ancestralComum: sala mais funda acima de 'a' e de 'b' (SALA_NENHUMA se
+ * alguma não é alcançável). Sobe de 'a' pelo salto enquanto ele não é
+ * ancestral de 'b', senão pelo pai.
+ */
+uint32_t ancestralComum(const Caso *caso, uint32_t a, uint32_t b) {
+    const IndiceCaminhos *ic = &caso->caminhos;
+    if (caso->mansao.procedural) {
+        if (a >= caso->mansao.total || b >= caso->mansao.total) return SALA_NENHUMA;
+        uint32_t pa = profundidadeNoHeap(a), pb = profundidadeNoHeap(b);
+        if (pa > pb) a = subirNoHeap(a, pa - pb);
+        else b = subirNoHeap(b, pb - pa);
+        while (a != b) {
+            a = subirNoHeap(a, 1);
+            b = subirNoHeap(b, 1);
+        }
+        return a;
+    }
+    if (ic->entrada[a] == SALA_NENHUMA || ic->entrada[b] == SALA_NENHUMA) return SALA_NENHUMA;
+    if (ehAncestral(caso, a, b)) return a;
+    if (ehAncestral(caso, b, a)) return b;
+    while (!ehAncestral(caso, ic->pai[a], b))
+        a = ehAncestral(caso, ic->salto[a], b) ? ic->pai[a] : ic->salto[a];
+    return ic->pai[a];
+}
+
+// número de corredores entre 'a' e 'b' na árvore (subindo até o ancestral comum)
+uint32_t distanciaSalas(const Caso *caso, uint32_t a, uint32_t b) {
+    uint32_t c = ancestralComum(caso, a, b);
+    if (c == SALA_NENHUMA) return SALA_NENHUMA;
+    return profundidadeDaSala(caso, a) + profundidadeDaSala(caso, b) - 2 * profundidadeDaSala(caso, c);
+}
+
+// salas com pista na subárvore de 'sala' (ela inclusive); PISTAS_DESCONHECIDAS
+// na mansão procedural, em que contar exigiria gerar a subárvore inteira
+uint32_t pistasNaSubarvore(const Caso *caso, uint32_t sala) {
+    const IndiceCaminhos *ic = &caso->caminhos;
+    if (caso->mansao.procedural) return PISTAS_DESCONHECIDAS;
+    if (ic->entrada[sala] == SALA_NENHUMA) return 0;
+    return ic->pistasAntes[ic->saida[sala]] - ic->pistasAntes[ic->entrada[sala]];
+}
+
+/*
+ * rotaAteSala: comandos ('e', 'd' e, se 'destino' não está abaixo de
+ * 'origem', um 'r' inicial) que levam de 'origem' a 'destino'. Grava até
+ * cap-1 comandos e '\0' em 'passos'; devolve o tamanho da rota ou -1 se
+ * 'destino' não é alcançável.
+ */
+long rotaAteSala(const Caso *caso, uint32_t origem, uint32_t destino, char *passos, size_t cap) {
+    const IndiceCaminhos *ic = &caso->caminhos;
+    int heap = caso->mansao.procedural;
+    if (heap ? destino >= caso->mansao.total : ic->entrada[destino] == SALA_NENHUMA) return -1;
+    uint32_t inicio = ehAncestral(caso, origem, destino) ? origem : caso->mansao.raiz;
+    size_t prefixo = inicio != origem;
+    size_t total = prefixo + profundidadeDaSala(caso, destino) - profundidadeDaSala(caso, inicio);
+    if (cap > 0) {
+        if (prefixo && cap > 1) passos[0] = 'r';
+        // do destino para cima, escrevendo de trás para frente
+        size_t k = total;
+        for (uint32_t v = destino; v != inicio; v = heap ? subirNoHeap(v, 1) : ic->pai[v]) {
+            k--;
+            if (k < cap - 1) passos[k] = heap ? (v % 2 ? 'e' : 'd') : caso->mansao.salas[ic->pai[v]].esq == v ? 'e' : 'd';
+        }
+        passos[total < cap - 1 ? total : cap - 1] = '\0';
+    }
+    return (long) total;
+}
+
+/*
+ * Sessões
+ * O caso (mansão, tabela pista->suspeito e cadastros globais de textos e
+ * suspeitos) é montado uma vez e depois só lido; cada investigação guarda
+ * apenas o seu estado numa Sessao (sala atual, caderno e placar). Assim
+ * várias sessões podem rodar ao mesmo tempo em threads diferentes sobre o
+ * mesmo caso, sem trava.
+ */
+
+/*
+ * Pistas densas
+ * As pistas do caso (pistas das salas e chaves da tabela) são numeradas de
+ * 0 a totalPistas-1 em ordem alfabética: o id denso de uma pista é a sua
+ * posição em indicePistas. Com isso o caderno de uma sessão pode ser um
+ * bitset (ver CADERNO_BITS), percorrido em ordem alfabética sem ordenar, e
+ * a contagem de pistas contra um suspeito é um popcount do caderno com a
+ * máscara do suspeito.
+ */
+#define PISTA_NENHUMA ((uint32_t) 0xFFFFFFFFu)
+#define MASCARAS_BYTES_MAX ((size_t) 64 << 20)
+
+// acrescenta o texto 'id' ao vetor do contexto (usado no percurso em ordem)
+typedef struct {
+    TextoId *ids;
+    uint32_t total;
+} ListaTextos;
+
+static void anotarPista(PistaNode *n, void *ctx) {
+    ListaTextos *l = (ListaTextos*) ctx;
+    l->ids[l->total++] = n->pista;
+}
+
+// id denso da pista ou PISTA_NENHUMA
+static uint32_t pistaDensa(const Caso *caso, TextoId pista) {
+    return pista < caso->totalDensaDaPista ? caso->densaDaPista[pista] : PISTA_NENHUMA;
+}
+
+/*
+ * montarIndicesCaso: monta indicePistas (ordenado com inserirPistaIterativa),
+ * densaDaPista (TextoId -> id denso) e suspeitoDaPista (id denso -> suspeito,
+ * com "Desconhecido" para pistas fora da tabela).
+ */
+static void montarIndicesCaso(Caso *caso) {
+    const Mansao *mansao = &caso->mansao;
+    const TabelaHash *tabela = caso->tabela;
+    Arena *arena = criarArena(0);
+    PistaNode *indice = NULL;
+    int inseriu;
+    uint32_t total = 0;
+    // na mansão procedural as pistas do catálogo já são chaves da tabela
+    for (uint32_t i = 0; !mansao->procedural && i < mansao->total; i++) {
+        if (mansao->salas[i].pista == TEXTO_NENHUM) continue;
+        indice = inserirPistaIterativa(arena, indice, mansao->salas[i].pista, &inseriu);
+        total += (uint32_t) inseriu;
+    }
+    for (size_t i = 0; i < tabela->capacidade; i++) {
+        if (!tabela->entradas[i].hash) continue;
+        indice = inserirPistaIterativa(arena, indice, tabela->entradas[i].chave, &inseriu);
+        total += (uint32_t) inseriu;
+    }
+    ListaTextos pistas = { (TextoId*) alocarMemoria((size_t) total * sizeof(TextoId) + 1, "malloc montarIndicesCaso"), 0 };
+    percorrerPistasEmOrdem(indice, anotarPista, &pistas);
+    liberarArena(arena);
+
+    uint32_t *densa = (uint32_t*) alocarMemoria((size_t) g_textos.total * sizeof(uint32_t) + 1, "malloc montarIndicesCaso");
+    memset(densa, 0xFF, (size_t) g_textos.total * sizeof(uint32_t));
+    SuspeitoId *suspeito = (SuspeitoId*) alocarMemoria((size_t) total * sizeof(SuspeitoId) + 1, "malloc montarIndicesCaso");
+    for (uint32_t d = 0; d < total; d++) {
+        densa[pistas.ids[d]] = d;
+        SuspeitoId s = encontrarSuspeitoId(tabela, pistas.ids[d]);
+        suspeito[d] = s == SUSPEITO_NENHUM ? caso->desconhecido : s;
+    }
+    caso->indicePistas = pistas.ids;
+    caso->totalPistas = total;
+    caso->densaDaPista = densa;
+    caso->totalDensaDaPista = g_textos.total;
+    caso->suspeitoDaPista = suspeito;
+}
+
+// linha P de uma pista, ordenada por (id denso, suspeito, ordem no arquivo)
+typedef struct ItemPeso {
+    uint32_t densa;
+    SuspeitoId suspeito;
+    int32_t peso;
+    uint32_t ordem;
+} ItemPeso;
+
+static int compararItensPeso(const void *a, const void *b) {
+    const ItemPeso *x = (const ItemPeso*) a, *y = (const ItemPeso*) b;
+    if (x->densa != y->densa) return x->densa < y->densa ? -1 : 1;
+    if (x->suspeito != y->suspeito) return x->suspeito < y->suspeito ? -1 : 1;
+    return (x->ordem > y->ordem) - (x->ordem < y->ordem);
+}
+
+/*
+ * montarPesos: vetores (suspeito, peso) das pistas (ver Pesos de evidência)
+ * e limiares do caso. Só as linhas P são ordenadas; a associação da tabela
+ * entra como peso 1 na passada por id denso, a menos que uma linha P do
+ * mesmo suspeito a substitua. "Desconhecido" só entra em pistas sem linha P.
+ */
+static void montarPesos(Caso *caso, const RegrasEvidencia *regras) {
+    caso->limiarSustentar = regras ? regras->limiarSustentar : PISTAS_PARA_SUSTENTAR;
+    caso->limiarInocentar = regras ? regras->limiarInocentar : LIMIAR_INOCENTAR_PADRAO;
+    caso->inicioPesos = NULL;
+    caso->pesos = NULL;
+    caso->totalPesos = 0;
+    if (!regras || regras->total == 0) return;
+
+    uint32_t n = caso->totalPistas;
+    ItemPeso *itens = (ItemPeso*) alocarMemoria((size_t) regras->total * sizeof(ItemPeso), "malloc montarPesos");
+    uint32_t totalItens = 0;
+    for (uint32_t i = 0; i < regras->total; i++) {
+        uint32_t d = pistaDensa(caso, regras->pistas[i]);
+        if (d >= n) continue; // pista fora das salas e da tabela: nunca é coletada
+        itens[totalItens].densa = d;
+        itens[totalItens].suspeito = regras->pesos[i].suspeito;
+        itens[totalItens].peso = regras->pesos[i].peso;
+        itens[totalItens].ordem = i;
+        totalItens++;
+    }
+    qsort(itens, totalItens, sizeof(ItemPeso), compararItensPeso);
+
+    uint32_t *inicio = (uint32_t*) alocarMemoria(((size_t) n + 1) * sizeof(uint32_t), "malloc montarPesos");
+    PesoEvidencia *pesos = (PesoEvidencia*) alocarMemoria(((size_t) n + totalItens) * sizeof(PesoEvidencia) + 1, "malloc montarPesos");
+    uint32_t k = 0, i = 0;
+    for (uint32_t d = 0; d < n; d++) {
+        inicio[d] = k;
+        SuspeitoId padrao = caso->suspeitoDaPista[d];
+        if (i < totalItens && itens[i].densa == d && padrao == caso->desconhecido) padrao = SUSPEITO_NENHUM;
+        while (i < totalItens && itens[i].densa == d) {
+            uint32_t ultimo = i;
+            while (ultimo + 1 < totalItens && itens[ultimo + 1].densa == d && itens[ultimo + 1].suspeito == itens[i].suspeito) ultimo++;
+            if (itens[i].suspeito == padrao) padrao = SUSPEITO_NENHUM;
+            if (itens[ultimo].peso != 0) {
+                pesos[k].suspeito = itens[ultimo].suspeito;
+                pesos[k].peso = itens[ultimo].peso;
+                k++;
+            }
+            i = ultimo + 1;
+        }
+        if (padrao != SUSPEITO_NENHUM) {
+            pesos[k].suspeito = padrao;
+            pesos[k].peso = 1;
+            k++;
+        }
+    }
+    inicio[n] = k;
+    free(itens);
+    caso->inicioPesos = inicio;
+    caso->pesos = pesos;
+    caso->totalPesos = k;
+}
+
+/*
+ * pontuarPista: soma ao placar (sinal +1) ou tira dele (-1) o vetor de pesos
+ * da pista de id denso 'densa'. Sem pesos no caso, a pista vale 1 para o
+ * seu suspeito.
+ */
+void pontuarPista(Placar *p, const Caso *caso, uint32_t densa, int sinal) {
+    if (!caso->inicioPesos) {
+        placarSomar(p, caso->suspeitoDaPista[densa], sinal);
+        return;
+    }
+    for (uint32_t k = caso->inicioPesos[densa]; k < caso->inicioPesos[densa + 1]; k++)
+        placarPontuar(p, caso->pesos[k].suspeito, sinal, sinal * caso->pesos[k].peso);
+}
+
+// situação de 's' pelos pontos do placar e os limiares do caso (O(1))
+SituacaoSuspeito situacaoSuspeito(const Placar *p, const Caso *caso, SuspeitoId s) {
+    int64_t pontos = placarPontos(p, s);
+    if (pontos >= caso->limiarSustentar) return SITUACAO_INCRIMINADO;
+    if (pontos <= caso->limiarInocentar) return SITUACAO_INOCENTADO;
+    return SITUACAO_INDEFINIDA;
+}
+
+/*
+ * montarMascaras: para cada suspeito cadastrado, bitset das pistas que o
+ * citam. Se passar de MASCARAS_BYTES_MAX fica NULL e as contagens vêm só
+ * do placar.
+ */
+static void montarMascaras(Caso *caso) {
+    caso->palavras = (caso->totalPistas + 63) / 64;
+    caso->totalMascaras = totalSuspeitos();
+    size_t bytes = (size_t) caso->palavras * caso->totalMascaras * sizeof(uint64_t);
+    if (bytes == 0 || bytes > MASCARAS_BYTES_MAX) {
+        caso->mascaras = NULL;
+        return;
+    }
+    caso->mascaras = (uint64_t*) alocarZerada(1, bytes, "calloc montarMascaras");
+    for (uint32_t d = 0; d < caso->totalPistas; d++) {
+        if (caso->inicioPesos) {
+            for (uint32_t k = caso->inicioPesos[d]; k < caso->inicioPesos[d + 1]; k++)
+                caso->mascaras[(size_t) caso->pesos[k].suspeito * caso->palavras + (d >> 6)] |= 1ull << (d & 63);
+            continue;
+        }
+        uint64_t *m = caso->mascaras + (size_t) caso->suspeitoDaPista[d] * caso->palavras;
+        m[d >> 6] |= 1ull << (d & 63);
+    }
+}
+
+// libera o que prepararCaso/abrirCaso montaram no heap (o resto é do caso ou do arquivo)
+static void liberarIndicesCaso(Caso *caso) {
+    if (!caso->mapa) {
+        free((void*) caso->indicePistas);
+        free((void*) caso->densaDaPista);
+        free((void*) caso->suspeitoDaPista);
+        free((void*) caso->inicioPesos);
+        free((void*) caso->pesos);
+    }
+    free(caso->mascaras);
+    liberarCaminhos(&caso->caminhos);
+    caso->indicePistas = NULL;
+    caso->densaDaPista = NULL;
+    caso->suspeitoDaPista = NULL;
+    caso->inicioPesos = NULL;
+    caso->pesos = NULL;
+    caso->mascaras = NULL;
+}
+
+/*
+ * prepararCaso: torna 'mansao' e 'tabela' o caso compartilhado. Cadastra
+ * "Desconhecido" (suspeito das pistas sem associação na tabela) agora, para
+ * que nenhuma sessão precise alterar o caso depois, e numera as pistas
+ * (ids densos, vetores de pesos das 'regras', se houver, e máscaras por
+ * suspeito).
+ */
+void prepararCaso(Caso *caso, const Mansao *mansao, TabelaHash *tabela, const RegrasEvidencia *regras) {
+    memset(caso, 0, sizeof(*caso));
+    caso->mansao = *mansao;
+    caso->tabela = tabela;
+    caso->desconhecido = cadastrarSuspeito("Desconhecido");
+    montarIndicesCaso(caso);
+    montarPesos(caso, regras);
+    montarMascaras(caso);
+    montarCaminhos(caso);
+    calcularImpressao(caso);
+}
+
+void iniciarSessao(Sessao *s, const Caso *caso, ModoCaderno modo) {
+    s->arena = criarArena(0);
+    s->modo = modo;
+    s->caderno = NULL;
+    s->bits = modo == CADERNO_BITS
+        ? (uint64_t*) alocarZerada((size_t) caso->palavras + 1, sizeof(uint64_t), "calloc iniciarSessao")
+        : NULL;
+    s->coletadas = 0;
+    iniciarPlacar(&s->placar);
+    s->cursor = caso->mansao.raiz;
+    s->passos = 0;
+    s->diario = -1;
+    s->cache = NULL;
+    if (caso->mansao.procedural) {
+        s->cache = (CacheSalas*) alocarMemoria(sizeof(CacheSalas), "malloc iniciarSessao");
+        iniciarCacheSalas(s->cache, caso->mansao.salasEmCache);
+    }
+}
+
+// volta a sessão ao início, reaproveitando arena, placar e salas já geradas
+void reiniciarSessao(Sessao *s, const Caso *caso) {
+    reiniciarArena(s->arena);
+    s->caderno = NULL;
+    if (s->bits) memset(s->bits, 0, (size_t) caso->palavras * sizeof(uint64_t));
+    s->coletadas = 0;
+    reiniciarPlacar(&s->placar);
+    s->cursor = caso->mansao.raiz;
+    s->passos = 0;
+}
+
+void liberarSessao(Sessao *s) {
+    if (s->diario >= 0) close(s->diario);
+    s->diario = -1;
+    liberarPlacar(&s->placar);
+    liberarArena(s->arena);
+    free(s->bits);
+    if (s->cache) liberarCacheSalas(s->cache);
+    free(s->cache);
+    s->arena = NULL;
+    s->caderno = NULL;
+    s->bits = NULL;
+    s->cache = NULL;
+}
+
+/*
+ * explorarSalas:
+ * - Navega interativamente pela árvore de salas.
+ * - Ao visitar uma sala, exibe o nome e, se existir, exibe e coleta automaticamente a pista associada.
+ * - Insere a pista na AVL de pistas coletadas (se ainda não coletada).
+ *
+ * Parâmetros:
+ *   saida: buffer de saída (texto ou JSON), descarregado uma vez por passo
+ *   sessao: estado do jogador (sala atual, caderno de pistas e placar por suspeito)
+ *   caso: mansão plana e tabela pista->suspeito; 'r' volta à sala raiz
+ *
+ * O jogador escolhe 'e' para ir à esquerda, 'd' para ir à direita, 's' para sair da exploração.
+ * "goto <sala>" (ou "ir <sala>") segue a rota do índice de caminhos até a
+ * sala, coletando as pistas das salas por onde passa. "pistas [n]" mostra a
+ * página n do caderno, "pistas <prefixo>" as pistas que começam com ele e
+ * "pistas >= <texto>" as que vêm a partir dele em ordem alfabética.
+ */
+void explorarSalas(Saida *saida, Sessao *sessao, const Caso *caso) {
+    const Mansao *mansao = &caso->mansao;
+    if (mansao->total == 0) return;
+    int json = saida->formato == SAIDA_JSON;
+    char comando[256];
+
+    if (!json) escreverSaida(saida, "\nIniciando exploracao da mansao. Comandos: [e] esquerda, [d] direita, [s] sair, goto <sala>, pistas [pagina|prefixo|>= texto].\n");
+    for (;;) {
+        uint32_t cursor = sessao->cursor;
+        int coletou = coletarPistaDaSala(sessao, caso);
+        if (json) {
+            escreverSaida(saida, "{\"evento\":\"sala\",\"passos\":%lu,\"sala\":", sessao->passos);
+            escreverJsonTexto(saida, nomeDaSala(sessao, caso, cursor));
+            if (coletou < 0) {
+                escreverSaida(saida, ",\"pista\":null}\n");
+            } else {
+                escreverSaida(saida, ",\"pista\":");
+                escreverJsonTexto(saida, textoDe(pistaNaSala(sessao, caso, cursor)));
+                escreverSaida(saida, ",\"nova\":%s}\n", coletou ? "true" : "false");
+            }
+        } else {
+            escreverSaida(saida, "\nVoce esta na sala: %s\n", nomeDaSala(sessao, caso, cursor));
+            if (coletou < 0) {
+                escreverSaida(saida, "Nenhuma pista aparente nesta sala.\n");
+            } else {
+                escreverSaida(saida, "Voce encontrou uma pista: \"%s\"\n", textoDe(pistaNaSala(sessao, caso, cursor)));
+                if (coletou) escreverSaida(saida, "Pista adicionada ao caderno.\n");
+                else escreverSaida(saida, "Pista ja constava no caderno (nao duplicada).\n");
+            }
+
+            // apresentar opções de movimento
+            escreverSaida(saida, "\nEscolhas: [e] ir para sala da esquerda, [d] ir para sala da direita, [r] voltar ao inicio, [s] sair exploracao\n");
+            escreverSaida(saida, "Digite a escolha: ");
+        }
+        descarregarSaida(saida); // um write por passo, antes de esperar o comando
+        if (!fgets(comando, sizeof(comando), stdin)) break;
+        trim_newline(comando);
+        if (strlen(comando) == 0) {
+            escreverSaida(saida, json ? "{\"evento\":\"entrada_invalida\"}\n" : "Entrada invalida. Tente novamente.\n");
+            continue;
+        }
+        const char *alvo = NULL;
+        if (strncmp(comando, "goto ", 5) == 0) alvo = comando + 5;
+        else if (strncmp(comando, "ir ", 3) == 0) alvo = comando + 3;
+        if (alvo) {
+            irParaSala(saida, sessao, caso, alvo);
+            continue;
+        }
+        if (strcmp(comando, "pistas") == 0 || strncmp(comando, "pistas ", 7) == 0) {
+            consultarCaderno(saida, sessao, caso, comando + 6);
+            continue;
+        }
+        char c = comando[0];
+        ResultadoComando r = aplicarPasso(sessao, caso, c);
+        if (r == COMANDO_SEM_SALA) {
+            int esquerda = c == 'e' || c == 'E';
+            if (json) escreverSaida(saida, "{\"evento\":\"sem_sala\",\"direcao\":\"%s\"}\n", esquerda ? "esquerda" : "direita");
+            else escreverSaida(saida, esquerda ? "Nao ha sala à esquerda.\n" : "Nao ha sala à direita.\n");
+        } else if (r == COMANDO_INICIO) {
+            escreverSaida(saida, json ? "{\"evento\":\"volta_ao_inicio\"}\n" : "Voltando à sala inicial.\n");
+        } else if (r == COMANDO_SAIR) {
+            if (json) escreverSaida(saida, "{\"evento\":\"fim_exploracao\",\"passos\":%lu,\"pistas\":%d}\n", sessao->passos, pistasColetadas(sessao));
+            else escreverSaida(saida, "Encerrando exploracao.\n");
+            break;
+        } else if (r == COMANDO_DESCONHECIDO) {
+            if (json) {
+                escreverSaida(saida, "{\"evento\":\"comando_desconhecido\",\"comando\":");
+                escreverJsonTexto(saida, comando);
+                escreverSaida(saida, "}\n");
+            } else {
+                escreverSaida(saida, "Comando desconhecido. Tente novamente.\n");
+            }
+        }
+    }
+    descarregarSaida(saida);
+}
+
+// lista de pistas como array JSON
+static void escreverJsonPistas(Saida *saida, const TextoId *pistas, uint32_t n) {
+    escreverSaida(saida, "[");
+    for (uint32_t i = 0; i < n; i++) {
+        if (i) escreverSaida(saida, ",");
+        escreverJsonTexto(saida, textoDe(pistas[i]));
+    }
+    escreverSaida(saida, "]");
+}
+
+/*
+ * consultarCaderno: comando "pistas" da exploração. Sem argumento ou com um
+ * número, mostra essa página do caderno (PAGINA_PISTAS por página); com
+ * ">= texto", as primeiras pistas a partir desse texto; com outro texto, as
+ * primeiras pistas que começam com ele (autocompletar).
+ * Não conta como passo.
+ */
+#define PAGINA_PISTAS 10
+
+void consultarCaderno(Saida *saida, const Sessao *sessao, const Caso *caso, const char *argumento) {
+    while (*argumento == ' ') argumento++;
+    int json = saida->formato == SAIDA_JSON;
+    char *fim = (char*) argumento;
+    long pagina = *argumento ? strtol(argumento, &fim, 10) : 1;
+    int ehPagina = !*argumento || *fim == '\0';
+    TextoId pistas[PAGINA_PISTAS];
+    uint32_t total, n = 0, inicio = 0;
+    if (strncmp(argumento, ">=", 2) == 0) {
+        const char *desde = argumento + 2;
+        while (*desde == ' ') desde++;
+        n = cadernoDesde(sessao, caso, desde, pistas, PAGINA_PISTAS, &total);
+        if (json) {
+            escreverSaida(saida, "{\"evento\":\"desde\",\"desde\":");
+            escreverJsonTexto(saida, desde);
+            escreverSaida(saida, ",\"total\":%u,\"pistas\":", total);
+            escreverJsonPistas(saida, pistas, n);
+            escreverSaida(saida, "}\n");
+            return;
+        }
+        if (total == 0) {
+            escreverSaida(saida, "Nenhuma pista do caderno vem a partir de \"%s\".\n", desde);
+            return;
+        }
+        escreverSaida(saida, "Pistas a partir de \"%s\" (%u):\n", desde, total);
+        for (uint32_t i = 0; i < n; i++) escreverSaida(saida, "- %s\n", textoDe(pistas[i]));
+        if (total > n) escreverSaida(saida, "... e mais %u.\n", total - n);
+        return;
+    }
+    if (ehPagina && pagina < 1) {
+        if (json) escreverSaida(saida, "{\"evento\":\"erro\",\"mensagem\":\"pagina invalida\",\"pagina\":%ld}\n", pagina);
+        else escreverSaida(saida, "Pagina invalida: as paginas do caderno comecam em 1.\n");
+        return;
+    }
+    if (ehPagina) {
+        // compara com o número de páginas antes de calcular a posição, que não cabe em 32 bits para páginas enormes
+        total = (uint32_t) pistasColetadas(sessao);
+        uint32_t paginas = (total + PAGINA_PISTAS - 1) / PAGINA_PISTAS;
+        if ((uint64_t) pagina <= paginas) {
+            inicio = (uint32_t) ((uint64_t) (pagina - 1) * PAGINA_PISTAS);
+            n = paginaDoCaderno(sessao, caso, NULL, inicio, pistas, PAGINA_PISTAS, &total);
+        }
+        if (json) {
+            escreverSaida(saida, "{\"evento\":\"caderno\",\"pagina\":%ld,\"paginas\":%u,\"total\":%u,\"pistas\":", pagina, paginas, total);
+            escreverJsonPistas(saida, pistas, n);
+            escreverSaida(saida, "}\n");
+            return;
+        }
+        if (total == 0) {
+            escreverSaida(saida, "O caderno ainda esta vazio.\n");
+            return;
+        }
+        if (n == 0) {
+            escreverSaida(saida, "O caderno tem %u pagina(s).\n", paginas);
+            return;
+        }
+        escreverSaida(saida, "Caderno, pagina %ld de %u (pistas %u-%u de %u):\n", pagina, paginas, inicio + 1, inicio + n, total);
+    } else {
+        n = paginaDoCaderno(sessao, caso, argumento, 0, pistas, PAGINA_PISTAS, &total);
+        if (json) {
+            escreverSaida(saida, "{\"evento\":\"prefixo\",\"prefixo\":");
+            escreverJsonTexto(saida, argumento);
+            escreverSaida(saida, ",\"total\":%u,\"pistas\":", total);
+            escreverJsonPistas(saida, pistas, n);
+            escreverSaida(saida, "}\n");
+            return;
+        }
+        if (total == 0) {
+            escreverSaida(saida, "Nenhuma pista do caderno comeca com \"%s\".\n", argumento);
+            return;
+        }
+        escreverSaida(saida, "Pistas que comecam com \"%s\" (%u):\n", argumento, total);
+    }
+    for (uint32_t i = 0; i < n; i++) escreverSaida(saida, "- %s\n", textoDe(pistas[i]));
+    if (!ehPagina && total > n) escreverSaida(saida, "... e mais %u.\n", total - n);
+}
+
+// mensagem de erro do "goto": texto ou {"evento":"erro",...}
+static void erroDeRota(Saida *saida, const char *mensagem, const char *sala) {
+    if (saida->formato == SAIDA_JSON) {
+        escreverSaida(saida, "{\"evento\":\"erro\",\"mensagem\":\"%s\",\"sala\":", mensagem);
+        escreverJsonTexto(saida, sala);
+        escreverSaida(saida, "}\n");
+    } else if (strcmp(mensagem, "sala inexistente") == 0) {
+        escreverSaida(saida, "Sala \"%s\" nao existe nesta mansao.\n", sala);
+    } else if (strcmp(mensagem, "sem caminho") == 0) {
+        escreverSaida(saida, "Nao ha caminho ate a sala \"%s\".\n", sala);
+    } else {
+        escreverSaida(saida, "Voce ja esta nessa sala.\n");
+    }
+}
+
+/*
+ * irParaSala: comando "goto" da exploração. Calcula a rota com rotaAteSala e
+ * a percorre com aplicarComando; as salas intermediárias têm a pista coletada
+ * aqui, a do destino no laço de explorarSalas. Cada passo conta em 'passos'.
+ */
+void irParaSala(Saida *saida, Sessao *sessao, const Caso *caso, const char *nome) {
+    while (*nome == ' ') nome++;
+    int json = saida->formato == SAIDA_JSON;
+    uint32_t destino = salaPorNome(caso, nome);
+    if (destino == SALA_NENHUMA) {
+        erroDeRota(saida, "sala inexistente", nome);
+        return;
+    }
+    char rota[256];
+    long total = rotaAteSala(caso, sessao->cursor, destino, rota, sizeof(rota));
+    if (total < 0) {
+        erroDeRota(saida, "sem caminho", nome);
+        return;
+    }
+    if (total == 0) {
+        erroDeRota(saida, "ja esta na sala", nome);
+        return;
+    }
+    char *longa = NULL;
+    if ((size_t) total >= sizeof(rota)) {
+        longa = (char*) alocarMemoria((size_t) total + 1, "malloc irParaSala");
+        rotaAteSala(caso, sessao->cursor, destino, longa, (size_t) total + 1);
+    }
+    const char *passos = longa ? longa : rota;
+    const char *nomeDestino = nomeDaSala(sessao, caso, destino);
+    uint32_t abaixo = pistasNaSubarvore(caso, destino);
+    if (json) {
+        escreverSaida(saida, "{\"evento\":\"rota\",\"destino\":");
+        escreverJsonTexto(saida, nomeDestino);
+        if (abaixo == PISTAS_DESCONHECIDAS) escreverSaida(saida, ",\"passos\":%ld,\"pistas_abaixo\":null", total);
+        else escreverSaida(saida, ",\"passos\":%ld,\"pistas_abaixo\":%u", total, abaixo);
+        escreverSaida(saida, ",\"comandos\":\"%s\"}\n", passos);
+    } else if (abaixo == PISTAS_DESCONHECIDAS) {
+        escreverSaida(saida, "Rota ate %s (%ld passos): %s\n", nomeDestino, total, passos);
+    } else {
+        escreverSaida(saida, "Rota ate %s (%ld passos, %u pistas a partir dali): %s\n", nomeDestino,
+                      total, abaixo, passos);
+    }
+    for (long i = 0; i < total; i++) {
+        aplicarPasso(sessao, caso, passos[i]);
+        if (i + 1 == total) break;
+        int coletou = coletarPistaDaSala(sessao, caso);
+        const char *nomeSala = nomeDaSala(sessao, caso, sessao->cursor);
+        if (json) {
+            escreverSaida(saida, "{\"evento\":\"passagem\",\"sala\":");
+            escreverJsonTexto(saida, nomeSala);
+            if (coletou == 1) {
+                escreverSaida(saida, ",\"pista\":");
+                escreverJsonTexto(saida, textoDe(pistaNaSala(sessao, caso, sessao->cursor)));
+            }
+            escreverSaida(saida, "}\n");
+        } else {
+            escreverSaida(saida, "  passando por: %s\n", nomeSala);
+            if (coletou == 1) escreverSaida(saida, "  pista coletada no caminho: \"%s\"\n", textoDe(pistaNaSala(sessao, caso, sessao->cursor)));
+        }
+    }
+    free(longa);
+}
+
+/*
+ * aplicarComando: move o cursor conforme o comando ('e', 'd', 'r' ou 's',
+ * sem diferenciar maiúsculas). O cursor só muda em COMANDO_MOVEU e
+ * COMANDO_INICIO ('r' volta à raiz da mansão).
+ */
+ResultadoComando aplicarComando(const Mansao *mansao, uint32_t *cursor, char comando) {
+    uint32_t destino;
+    switch (comando) {
+        case 'e': case 'E': destino = filhoDaSala(mansao, *cursor, 0); break;
+        case 'd': case 'D': destino = filhoDaSala(mansao, *cursor, 1); break;
+        case 'r': case 'R': *cursor = mansao->raiz; return COMANDO_INICIO;
+        case 's': case 'S': return COMANDO_SAIR;
+        default: return COMANDO_DESCONHECIDO;
+    }
+    if (destino == SALA_NENHUMA) return COMANDO_SEM_SALA;
+    *cursor = destino;
+    return COMANDO_MOVEU;
+}
+
+/*
+ * aplicarPasso: um comando da exploração interativa. Conta o passo, move o
+ * cursor e, com diário aberto, acrescenta o comando a ele antes de voltar
+ * (um byte por write, sem buffer do stdio: o que voltou já está no arquivo).
+ */
+ResultadoComando aplicarPasso(Sessao *sessao, const Caso *caso, char comando) {
+    sessao->passos++;
+    ResultadoComando r = aplicarComando(&caso->mansao, &sessao->cursor, comando);
+    if (sessao->diario >= 0 && write(sessao->diario, &comando, 1) != 1) {
+        perror("diario da sessao");
+        close(sessao->diario);
+        sessao->diario = -1;
+    }
+    return r;
+}
+
+/*
+ * coletarPistaDaSala: coleta a pista da sala atual da sessão no caderno
+ * (AVL ou bitset) e soma o vetor de pesos dela ao placar se ela for nova.
+ * Pistas sem associação na tabela contam para "Desconhecido"; o caso não é
+ * alterado. Na mansão procedural a sala é gerada (ou achada) no cache da
+ * sessão. Retorna 1 se a pista é nova, 0 se já constava no caderno e -1 se
+ * a sala não tem pista.
+ */
+int coletarPistaDaSala(Sessao *sessao, const Caso *caso) {
+    TextoId pista = pistaNaSala(sessao, caso, sessao->cursor);
+    if (pista == TEXTO_NENHUM) return -1;
+    if (sessao->modo == CADERNO_BITS) {
+        uint32_t d = pistaDensa(caso, pista);
+        if (d >= caso->totalPistas) return -1; // caso corrompido: pista fora do índice
+        uint64_t bit = 1ull << (d & 63);
+        if (sessao->bits[d >> 6] & bit) return 0;
+        sessao->bits[d >> 6] |= bit;
+        sessao->coletadas++;
+        pontuarPista(&sessao->placar, caso, d, +1);
+        return 1;
+    }
+    int inseriu = 0;
+    sessao->caderno = inserirPistaIterativa(sessao->arena, sessao->caderno, pista, &inseriu);
+    if (inseriu && caso->inicioPesos && pistaDensa(caso, pista) < caso->totalPistas) {
+        pontuarPista(&sessao->placar, caso, pistaDensa(caso, pista), +1);
+    } else if (inseriu) {
+        SuspeitoId sus = encontrarSuspeitoId(caso->tabela, pista);
+        placarSomar(&sessao->placar, sus == SUSPEITO_NENHUM ? caso->desconhecido : sus, +1);
+    }
+    return inseriu;
+}
+
+int pistasColetadas(const Sessao *s) {
+    return s->modo == CADERNO_BITS ? (int) s->coletadas : contarPistas(s->caderno);
+}
+
+/*
+ * cadernoOrdenado: o caderno como AVL de pistas, para mostrarPistasInOrder e
+ * listarPistasEAssociacoes. No modo bits a árvore é montada a cada chamada,
+ * na arena da sessão, percorrendo os bits ligados (já em ordem alfabética).
+ */
+PistaNode* cadernoOrdenado(Sessao *s, const Caso *caso) {
+    if (s->modo != CADERNO_BITS) return s->caderno;
+    PistaNode *raiz = NULL;
+    int inseriu;
+    for (uint32_t w = 0; w < caso->palavras; w++) {
+        for (uint64_t b = s->bits[w]; b; b &= b - 1) {
+            uint32_t d = w * 64 + (uint32_t) __builtin_ctzll(b);
+            raiz = inserirPistaIterativa(s->arena, raiz, caso->indicePistas[d], &inseriu);
+        }
+    }
+    return raiz;
+}
+
+// primeiro id denso cujo texto não é menor que 'texto' (ou, com len > 0, cujos len bytes passam de 'texto')
+static uint32_t densaDesde(const Caso *caso, const char *texto, size_t len) {
+    uint32_t lo = 0, hi = caso->totalPistas;
+    while (lo < hi) {
+        uint32_t meio = lo + (hi - lo) / 2;
+        const char *t = textoDe(caso->indicePistas[meio]);
+        if (len ? strncmp(t, texto, len) <= 0 : strcmp(t, texto) < 0) lo = meio + 1;
+        else hi = meio;
+    }
+    return lo;
+}
+
+// bits ligados em [ini, fim) do bitset
+static uint32_t contarBitsNaFaixa(const uint64_t *bits, uint32_t ini, uint32_t fim) {
+    uint32_t n = 0;
+    while (ini < fim) {
+        uint32_t w = ini >> 6, ate = (w + 1) * 64 < fim ? (w + 1) * 64 : fim;
+        uint64_t m = bits[w] >> (ini & 63);
+        if (ate - ini < 64) m &= (1ull << (ate - ini)) - 1;
+        n += (uint32_t) __builtin_popcountll(m);
+        ini = ate;
+    }
+    return n;
+}
+
+/*
+ * paginaDoCaderno: pistas do caderno (só as que começam com 'prefixo', se
+ * não for NULL nem vazio) a partir da posição 'inicio' entre elas, até
+ * 'max' em 'saida', em ordem alfabética. 'total' recebe quantas casam com o
+ * prefixo. Retorna quantas foram gravadas. Na AVL a posição sai dos tamanhos
+ * dos nós (O(log n + max)); no bitset, o prefixo vira uma faixa de ids densos
+ * (busca binária no índice do caso) e a posição é achada por popcount.
+ */
+uint32_t paginaDoCaderno(const Sessao *s, const Caso *caso, const char *prefixo, uint32_t inicio,
+                         TextoId *saida, uint32_t max, uint32_t *total) {
+    int comPrefixo = prefixo && *prefixo;
+    uint32_t n = 0;
+    if (s->modo != CADERNO_BITS) {
+        uint32_t primeira = 0;
+        *total = comPrefixo ? contarPistasComPrefixo(s->caderno, prefixo, &primeira) : tamanhoPista(s->caderno);
+        if (inicio >= *total) return 0;
+        CursorArvore c;
+        PistaNode *no;
+        abrirCursorPistasNaPosicao(&c, s->caderno, primeira + inicio);
+        while (n < max && n < *total - inicio && (no = proximaPista(&c))) saida[n++] = no->pista;
+        fecharCursor(&c);
+        return n;
+    }
+    uint32_t ini = comPrefixo ? densaDesde(caso, prefixo, 0) : 0;
+    uint32_t fim = comPrefixo ? densaDesde(caso, prefixo, strlen(prefixo)) : caso->totalPistas;
+    *total = ini < fim ? contarBitsNaFaixa(s->bits, ini, fim) : 0;
+    if (inicio >= *total) return 0;
+    // pula palavras inteiras enquanto a página não começa nelas
+    uint32_t d = ini;
+    while (d < fim) {
+        uint32_t ate = ((d >> 6) + 1) * 64 < fim ? ((d >> 6) + 1) * 64 : fim;
+        uint32_t bits = contarBitsNaFaixa(s->bits, d, ate);
+        if (bits > inicio) break;
+        inicio -= bits;
+        d = ate;
+    }
+    for (uint32_t w = d >> 6; d < fim && n < max; w++, d = w * 64) {
+        for (uint64_t b = s->bits[w] & (~0ull << (d & 63)); b && n < max; b &= b - 1) {
+            uint32_t x = w * 64 + (uint32_t) __builtin_ctzll(b);
+            if (x >= fim) return n;
+            if (inicio > 0) inicio--;
+            else saida[n++] = caso->indicePistas[x];
+        }
+    }
+    return n;
+}
+
+/*
+ * cadernoDesde: até 'max' pistas do caderno, em ordem alfabética, a partir
+ * da primeira que não é menor que 'desde'; 'total' recebe quantas vêm a
+ * partir dela. Na AVL a descida monta a pilha do cursor em O(log n); no
+ * bitset, 'desde' vira um id denso por busca binária no índice do caso.
+ */
+uint32_t cadernoDesde(const Sessao *s, const Caso *caso, const char *desde, TextoId *saida, uint32_t max, uint32_t *total) {
+    uint32_t n = 0;
+    if (s->modo != CADERNO_BITS) {
+        *total = tamanhoPista(s->caderno) - posicaoDaPista(s->caderno, desde);
+        CursorArvore c;
+        PistaNode *no;
+        abrirCursorPistasDesde(&c, s->caderno, desde);
+        while (n < max && (no = proximaPista(&c))) saida[n++] = no->pista;
+        fecharCursor(&c);
+        return n;
+    }
+    uint32_t ini = densaDesde(caso, desde, 0);
+    *total = contarBitsNaFaixa(s->bits, ini, caso->totalPistas);
+    for (uint32_t w = ini >> 6, d = ini; d < caso->totalPistas && n < max; w++, d = w * 64)
+        for (uint64_t b = s->bits[w] & (~0ull << (d & 63)); b && n < max; b &= b - 1)
+            saida[n++] = caso->indicePistas[w * 64 + (uint32_t) __builtin_ctzll(b)];
+    return n;
+}
+
+/*
+ * contagemPorMascara: pistas do caderno que apontam para 'sus', calculadas
+ * do zero como popcount(caderno & máscara do suspeito). Sem bitset ou sem
+ * máscaras, devolve o placar.
+ */
+int contagemPorMascara(const Sessao *s, const Caso *caso, SuspeitoId sus) {
+    if (s->modo != CADERNO_BITS || !caso->mascaras || sus >= caso->totalMascaras)
+        return placarContagem(&s->placar, sus);
+    const uint64_t *m = caso->mascaras + (size_t) sus * caso->palavras;
+    int n = 0;
+    for (uint32_t w = 0; w < caso->palavras; w++) n += __builtin_popcountll(s->bits[w] & m[w]);
+    return n;
+}
+
+/*
+ * Modo em lote
+ * Cada linha do roteiro é uma sessão independente: comandos e/d/r/s
+ * (espaços ignorados), opcionalmente seguidos de '|' e do nome do acusado,
+ * ex.: "e e s | Marido". Linhas vazias e iniciadas por '#' são ignoradas.
+ * Os roteiros são lidos antes; depois 'nThreads' trabalhadores pegam
+ * sessões em blocos de um contador atômico, cada um com uma única Sessao
+ * reaproveitada, e gravam o resultado na posição da sessão. A saída sai na
+ * ordem do roteiro, qualquer que seja o número de threads.
+ */
+#define LOTE_BLOCO 64
+
+typedef struct RoteiroSessao {
+    const char *comandos;   // até '|' ou fim da linha
+    const char *acusado;    // NULL se não há acusação
+} RoteiroSessao;
+
+typedef struct ResultadoSessao {
+    uint32_t salaFinal;
+    int pistas;
+    int64_t contagem;       // pontos contra o acusado (pistas, sem pesos no caso)
+    int sustentada;
+} ResultadoSessao;
+
+typedef struct TrabalhoLote {
+    const Caso *caso;
+    ModoCaderno modo;
+    const RoteiroSessao *roteiros;
+    ResultadoSessao *resultados;
+    size_t total;
+    atomic_size_t proxima;  // próxima sessão ainda não distribuída
+} TrabalhoLote;
+
+typedef struct Trabalhador {
+    pthread_t thread;
+    TrabalhoLote *trabalho;
+    unsigned long passos;
+} Trabalhador;
+
+// roda uma sessão do roteiro na sessão 's' (já reiniciada)
+static void jogarRoteiro(Sessao *s, const Caso *caso, const RoteiroSessao *r, ResultadoSessao *res) {
+    coletarPistaDaSala(s, caso);
+    for (const char *p = r->comandos; *p && *p != '|'; p++) {
+        if (isspace((unsigned char) *p)) continue;
+        s->passos++;
+        ResultadoComando rc = aplicarComando(&caso->mansao, &s->cursor, *p);
+        if (rc == COMANDO_SAIR) break;
+        if (rc == COMANDO_MOVEU || rc == COMANDO_INICIO) coletarPistaDaSala(s, caso);
+    }
+    INSTR_CADERNO(s->caderno, (uint32_t) pistasColetadas(s));
+    res->salaFinal = s->cursor;
+    res->pistas = pistasColetadas(s);
+    res->contagem = 0;
+    res->sustentada = r->acusado ? acusacaoSustentada(&s->placar, r->acusado, caso->limiarSustentar, &res->contagem) : 0;
+}
+
+static void* trabalharLote(void *arg) {
+    Trabalhador *t = (Trabalhador*) arg;
+    TrabalhoLote *lote = t->trabalho;
+    Sessao s;
+    iniciarSessao(&s, lote->caso, lote->modo);
+    for (;;) {
+        size_t ini = atomic_fetch_add(&lote->proxima, LOTE_BLOCO);
+        if (ini >= lote->total) break;
+        size_t fim = ini + LOTE_BLOCO < lote->total ? ini + LOTE_BLOCO : lote->total;
+        for (size_t i = ini; i < fim; i++) {
+            reiniciarSessao(&s, lote->caso);
+            jogarRoteiro(&s, lote->caso, &lote->roteiros[i], &lote->resultados[i]);
+            t->passos += s.passos;
+        }
+    }
+    liberarSessao(&s);
+    return NULL;
+}
+
+// separa a linha em comandos e acusado (no próprio buffer); 0 se a linha não é sessão
+static int lerRoteiro(char *linha, RoteiroSessao *r) {
+    trim_newline(linha);
+    while (isspace((unsigned char) *linha)) linha++;
+    if (*linha == '\0' || *linha == '#') return 0;
+    r->comandos = linha;
+    r->acusado = NULL;
+    char *barra = strchr(linha, '|');
+    if (barra) {
+        char *acusado = barra + 1;
+        while (isspace((unsigned char) *acusado)) acusado++;
+        char *fim = acusado + strlen(acusado);
+        while (fim > acusado && isspace((unsigned char) fim[-1])) *--fim = '\0';
+        if (*acusado) r->acusado = acusado;
+    }
+    return 1;
+}
+
+/*
+ * executarLote: roda as sessões roteirizadas de 'entrada' sobre o caso, com
+ * cadernos no 'modo' dado e 'nThreads' trabalhadores (ver Modo em lote).
+ * Se 'saida' não for NULL, escreve uma linha de resultado por sessão (para
+ * comparar execuções), em texto ou JSON, descarregando a cada SAIDA_LOTE
+ * bytes.
+ * O tempo em 'est' cobre só as sessões, não a leitura do roteiro.
+ * Retorna 0 ou -1 em erro de leitura.
+ */
+int executarLote(FILE *entrada, Saida *saida, const Caso *caso, ModoCaderno modo, int nThreads, EstatisticasLote *est) {
+    memset(est, 0, sizeof(*est));
+    if (nThreads < 1) nThreads = 1;
+
+    size_t total = 0, cap = 0;
+    char **linhas = NULL;
+    RoteiroSessao *roteiros = NULL;
+    char *linha = NULL;
+    size_t capLinha = 0;
+    while (getline(&linha, &capLinha, entrada) != -1) {
+        RoteiroSessao r;
+        if (!lerRoteiro(linha, &r)) continue;
+        if (total == cap) {
+            cap = cap ? cap * 2 : 1024;
+            linhas = (char**) realocarMemoria(linhas, cap * sizeof(char*), "realloc executarLote");
+            roteiros = (RoteiroSessao*) realocarMemoria(roteiros, cap * sizeof(RoteiroSessao), "realloc executarLote");
+        }
+        // a linha fica com a sessão; getline aloca outra na próxima leitura
+        linhas[total] = linha;
+        roteiros[total++] = r;
+        linha = NULL;
+        capLinha = 0;
+    }
+    free(linha);
+    int rc = ferror(entrada) ? -1 : 0;
+
+    if (rc == 0 && total > 0 && caso->mansao.total > 0) {
+        TrabalhoLote lote;
+        lote.caso = caso;
+        lote.modo = modo;
+        lote.roteiros = roteiros;
+        lote.resultados = (ResultadoSessao*) alocarMemoria(total * sizeof(ResultadoSessao), "malloc executarLote");
+        lote.total = total;
+        atomic_init(&lote.proxima, 0);
+        Trabalhador *trab = (Trabalhador*) alocarZerada((size_t) nThreads, sizeof(Trabalhador), "calloc executarLote");
+
+        double t0 = agoraSegundos();
+        int criadas = 0;
+        for (; criadas < nThreads; criadas++) {
+            trab[criadas].trabalho = &lote;
+            if (pthread_create(&trab[criadas].thread, NULL, trabalharLote, &trab[criadas]) != 0) break;
+        }
+        // sem threads suficientes, quem chamou também trabalha; o lote termina igual
+        if (criadas < nThreads) trabalharLote(&trab[criadas]);
+        for (int i = 0; i < criadas; i++) pthread_join(trab[i].thread, NULL);
+        for (int i = 0; i < nThreads; i++) est->passos += trab[i].passos;
+        est->segundos = agoraSegundos() - t0;
+        est->sessoes = total;
+
+        char gerada[NOME_SALA_MAX];
+        for (size_t i = 0; i < total; i++) {
+            const ResultadoSessao *res = &lote.resultados[i];
+            est->sustentadas += res->sustentada;
+            if (!saida) continue;
+            const char *salaFinal = gerada;
+            if (caso->mansao.procedural) gerarSala(&caso->mansao, res->salaFinal, gerada, NULL);
+            else salaFinal = textoDe(caso->mansao.salas[res->salaFinal].nome);
+            if (saida->formato == SAIDA_JSON) {
+                escreverSaida(saida, "{\"sessao\":%zu,\"sala_final\":", i + 1);
+                escreverJsonTexto(saida, salaFinal);
+                escreverSaida(saida, ",\"pistas\":%d", res->pistas);
+                if (roteiros[i].acusado) {
+                    escreverSaida(saida, ",\"acusado\":");
+                    escreverJsonTexto(saida, roteiros[i].acusado);
+                    escreverSaida(saida, ",\"contra\":%lld,\"sustentada\":%s", (long long) res->contagem, res->sustentada ? "true" : "false");
+                }
+                escreverSaida(saida, "}\n");
+            } else {
+                escreverSaida(saida, "sessao %zu: sala final=%s pistas=%d", i + 1, salaFinal, res->pistas);
+                if (roteiros[i].acusado)
+                    escreverSaida(saida, " acusado=%s contra=%lld %s", roteiros[i].acusado, (long long) res->contagem,
+                                  res->sustentada ? "SUSTENTADA" : "NAO_SUSTENTADA");
+                escreverSaida(saida, "\n");
+            }
+            if (saida->usado >= SAIDA_LOTE) descarregarSaida(saida);
+        }
+        if (saida) descarregarSaida(saida);
+        free(trab);
+        free(lote.resultados);
+    }
+
+    for (size_t i = 0; i < total; i++) free(linhas[i]);
+    free(linhas);
+    free(roteiros);
+    return rc;
+}
+
+/*
+ * Resolvedor
+ * Diz, para cada suspeito, se alguma exploração da mansão sustenta a
+ * acusação (pontos >= limiarSustentar, como em verificarSuspeitoFinal) e
+ * com quantos comandos, no mínimo. Como [r] volta à entrada a qualquer
+ * momento, uma exploração é um conjunto de caminhos que descem da entrada:
+ * cada caminho até a sala u custa profundidade(u) comandos, mais um [r]
+ * entre um caminho e o próximo, e as pistas coletadas são as das salas
+ * desses caminhos (cada pista conta uma vez).
+ * Uma passada pelas salas alcançáveis marca, em bitsets sobre os ids
+ * densos, as pistas alcançáveis e as que aparecem em mais de uma sala. A
+ * soma dos pesos positivos alcançáveis de um suspeito abaixo do limiar
+ * prova que a acusação é impossível (PROVA_COTA). Para os demais:
+ * - Sem pistas repetidas (PROVA_ARVORE), cada sala guarda uma tabela com o
+ *   custo mínimo, por total de pontos, dos caminhos dentro da sua
+ *   subárvore, combinada das tabelas dos filhos em O(faixa²). A faixa vai
+ *   de max(negativos, limiar - positivos) (abaixo disso nem todas as
+ *   pistas positivas chegam ao limiar) a limiar - negativos (acima disso
+ *   nenhum peso negativo derruba o total); sem pesos são limiar + 1
+ *   posições. Suspeitos são resolvidos em grupos, com as faixas lado a lado
+ *   na mesma tabela. As subárvores são repartidas entre as threads por
+ *   roubo de trabalho: uma subárvore de até 'grao' salas é resolvida
+ *   inteira por quem a pega; uma maior põe os filhos na fila como tarefas e
+ *   é combinada por quem concluir o último deles. Cada thread tira tarefas
+ *   do fim da própria fila (as mais fundas) e, sem trabalho, rouba do
+ *   início da fila de outra (as subárvores maiores).
+ * - Com pistas repetidas as tabelas contariam a mesma pista duas vezes. Com
+ *   até RESOLVER_RELEVANTES_MAX pistas relevantes, a busca é pelo menor
+ *   custo de cada conjunto de pistas coletadas (Dijkstra sobre máscaras de
+ *   64 bits), acrescentando a cada passo o caminho até uma sala com pista
+ *   positiva nova (PROVA_CONJUNTOS). Acima disso, com mais de
+ *   RESOLVER_CANDIDATAS_MAX caminhos candidatos ou além de
+ *   RESOLVER_ESTADOS_MAX conjuntos, o suspeito fica indeterminado, e
+ *   'motivo' diz qual limite ele passou.
+ * A mansão procedural não é resolvida: as salas não existem de antemão.
+ */
+#define RESOLVER_COLUNAS_MAX 4096            // custos por sala: soma das faixas de um grupo
+#define RESOLVER_BUFFER_BYTES ((size_t) 4 << 20) // tabelas de uma subárvore resolvida de uma vez
+#define RESOLVER_RELEVANTES_MAX 64
+#define RESOLVER_CANDIDATAS_MAX 4096
+#define RESOLVER_ESTADOS_MAX (1u << 20)
+#define CUSTO_INFINITO (INT64_MAX / 4)
+
+// vetor (suspeito, peso) da pista densa 'd': os pesos do caso ou a associação com peso 1
+static uint32_t vetorDaPista(const Caso *caso, uint32_t d, PesoEvidencia *um, const PesoEvidencia **vetor) {
+    if (caso->inicioPesos) {
+        *vetor = caso->pesos + caso->inicioPesos[d];
+        return caso->inicioPesos[d + 1] - caso->inicioPesos[d];
+    }
+    um->suspeito = caso->suspeitoDaPista[d];
+    um->peso = 1;
+    *vetor = um;
+    return 1;
+}
+
+// filhos de 'v' na árvore do índice de caminhos (SALA_NENHUMA se não há)
+static void filhosNaArvore(const Caso *caso, uint32_t v, uint32_t *esq, uint32_t *dir) {
+    const uint32_t *pai = caso->caminhos.pai;
+    uint32_t e = caso->mansao.salas[v].esq, d = caso->mansao.salas[v].dir;
+    *esq = e < caso->mansao.total && pai[e] == v ? e : SALA_NENHUMA;
+    *dir = d < caso->mansao.total && d != e && pai[d] == v ? d : SALA_NENHUMA;
+}
+
+// fila de tarefas de uma thread: a dona põe e tira no fim, as outras roubam do início
+typedef struct FilaTarefas {
+    uint32_t *itens;
+    size_t inicio, fim, cap;
+    pthread_mutex_t trava;
+} FilaTarefas;
+
+static void porTarefa(FilaTarefas *f, uint32_t v) {
+    pthread_mutex_lock(&f->trava);
+    if (f->fim == f->cap && f->inicio > 0 && f->inicio >= f->cap / 2) {
+        // metade ou mais já foi roubada: compactar custa no máximo o que essas tiradas custaram
+        memmove(f->itens, f->itens + f->inicio, (f->fim - f->inicio) * sizeof(uint32_t));
+        f->fim -= f->inicio;
+        f->inicio = 0;
+    } else if (f->fim == f->cap) {
+        f->cap = f->cap ? 2 * f->cap : 64;
+        f->itens = (uint32_t*) realocarMemoria(f->itens, f->cap * sizeof(uint32_t), "realloc porTarefa");
+    }
+    f->itens[f->fim++] = v;
+    pthread_mutex_unlock(&f->trava);
+}
+
+static int tirarTarefa(FilaTarefas *f, uint32_t *v, int roubo) {
+    pthread_mutex_lock(&f->trava);
+    int achou = f->inicio < f->fim;
+    if (achou) *v = roubo ? f->itens[f->inicio++] : f->itens[--f->fim];
+    if (f->inicio == f->fim) f->inicio = f->fim = 0;
+    pthread_mutex_unlock(&f->trava);
+    return achou;
+}
+
+typedef struct ArvoreResolvedor {
+    const Caso *caso;
+    const uint32_t *densaDaSala;    // pista densa de cada sala ou PISTA_NENHUMA
+    // grupo de suspeitos: a tabela de uma sala tem uma faixa de pontos por membro
+    uint32_t membros;
+    uint32_t *membroDoSuspeito;     // suspeito -> membro ou UINT32_MAX
+    uint32_t *inicio;               // começo da faixa de cada membro (membros + 1 posições)
+    int64_t *piso;                  // pontos da primeira posição da faixa
+    uint32_t colunas;
+    uint32_t grao;                  // subárvores até esse tamanho são resolvidas de uma vez
+    int64_t **tabelas;              // tabela de cada sala concluída, até o pai combinar
+    atomic_uint *pendentes;         // filhos por concluir de cada sala dividida
+    FilaTarefas *filas;
+    int nFilas;
+    atomic_int tarefas;             // tarefas postas e ainda não tiradas de alguma fila
+    atomic_int concluido;
+    pthread_mutex_t trava;          // com 'acordar', estaciona as threads sem trabalho
+    pthread_cond_t acordar;
+    int64_t *raiz;                  // tabela da raiz, ao fim
+} ArvoreResolvedor;
+
+typedef struct TrabalhadorArvore {
+    ArvoreResolvedor *r;
+    int eu;
+    int64_t *buffer;                // tabelas da subárvore resolvida de uma vez ('grao' salas)
+    int64_t *copia;                 // uma faixa, antes de somar o peso da sala
+    int64_t *peso;                  // peso da pista da sala para cada membro (zerado depois)
+    unsigned long long sorteio;
+    unsigned long tarefas, roubos;
+} TrabalhadorArvore;
+
+/*
+ * combinarSala: tabela de 'v' a partir das tabelas dos filhos (NULL se o
+ * filho não existe). Em cada faixa, a posição i vale piso + i pontos e a
+ * última vale também "isso ou mais"; o custo é a soma de profundidade + 1
+ * dos fins de caminho escolhidos.
+ */
+static void combinarSala(TrabalhadorArvore *t, uint32_t v, const int64_t *esq, const int64_t *dir, int64_t *saida) {
+    const ArvoreResolvedor *r = t->r;
+    const Caso *caso = r->caso;
+    uint32_t d = r->densaDaSala[v];
+    if (d != PISTA_NENHUMA) {
+        PesoEvidencia um;
+        const PesoEvidencia *vetor;
+        uint32_t n = vetorDaPista(caso, d, &um, &vetor);
+        for (uint32_t k = 0; k < n; k++) {
+            uint32_t m = r->membroDoSuspeito[vetor[k].suspeito];
+            if (m != UINT32_MAX) t->peso[m] += vetor[k].peso;
+        }
+    }
+    int64_t fimAqui = (int64_t) caso->caminhos.profundidade[v] + 1;
+    for (uint32_t m = 0; m < r->membros; m++) {
+        uint32_t ini = r->inicio[m];
+        int64_t largura = r->inicio[m + 1] - ini, piso = r->piso[m];
+        int64_t w = t->peso[m];
+        int64_t *o = w ? t->copia : saida + ini;
+        const int64_t *e = esq ? esq + ini : NULL, *di = dir ? dir + ini : NULL;
+        for (int64_t i = 0; i < largura; i++) o[i] = CUSTO_INFINITO;
+        // 'v' como fim de caminho: nada dos filhos, 0 pontos (piso <= 0 <= teto)
+        o[-piso] = fimAqui;
+        for (int64_t i = 0; i < largura; i++) {
+            if (e && e[i] < o[i]) o[i] = e[i];
+            if (di && di[i] < o[i]) o[i] = di[i];
+        }
+        for (int64_t i = 0; e && di && i < largura; i++) {
+            if (e[i] >= CUSTO_INFINITO) continue;
+            for (int64_t j = 0; j < largura; j++) {
+                int64_t k = i + j + piso;
+                if (di[j] >= CUSTO_INFINITO || k < 0) continue;
+                if (k >= largura) k = largura - 1;
+                if (e[i] + di[j] < o[k]) o[k] = e[i] + di[j];
+            }
+        }
+        if (!w) continue;
+        int64_t *destino = saida + ini;
+        for (int64_t i = 0; i < largura; i++) destino[i] = CUSTO_INFINITO;
+        for (int64_t i = 0; i < largura; i++) {
+            int64_t k = i + w;
+            if (o[i] >= CUSTO_INFINITO || k < 0) continue;
+            if (k >= largura) k = largura - 1;
+            if (o[i] < destino[k]) destino[k] = o[i];
+        }
+        t->peso[m] = 0;
+    }
+}
+
+// resolve a subárvore de 'v' de uma vez: pré-ordem de trás para frente (filhos antes do pai)
+static int64_t* resolverSubarvore(TrabalhadorArvore *t, uint32_t v) {
+    const ArvoreResolvedor *r = t->r;
+    const IndiceCaminhos *ic = &r->caso->caminhos;
+    uint32_t base = ic->entrada[v];
+    size_t c = r->colunas;
+    for (uint32_t j = ic->saida[v]; j-- > base;) {
+        uint32_t u = ic->ordem[j], e, d;
+        filhosNaArvore(r->caso, u, &e, &d);
+        combinarSala(t, u, e != SALA_NENHUMA ? t->buffer + (ic->entrada[e] - base) * c : NULL,
+                     d != SALA_NENHUMA ? t->buffer + (ic->entrada[d] - base) * c : NULL, t->buffer + (j - base) * c);
+    }
+    int64_t *tabela = (int64_t*) alocarMemoria(c * sizeof(int64_t), "malloc resolverSubarvore");
+    memcpy(tabela, t->buffer, c * sizeof(int64_t));
+    return tabela;
+}
+
+// entrega a tabela de 'v' ao pai; quem entrega a última combina o pai e sobe
+static void concluirSala(TrabalhadorArvore *t, uint32_t v, int64_t *tabela) {
+    ArvoreResolvedor *r = t->r;
+    const Caso *caso = r->caso;
+    for (;;) {
+        if (v == caso->mansao.raiz) {
+            r->raiz = tabela;
+            pthread_mutex_lock(&r->trava);
+            atomic_store(&r->concluido, 1);
+            pthread_cond_broadcast(&r->acordar);
+            pthread_mutex_unlock(&r->trava);
+            return;
+        }
+        uint32_t pai = caso->caminhos.pai[v], e, d;
+        r->tabelas[v] = tabela;
+        if (atomic_fetch_sub(&r->pendentes[pai], 1) != 1) return;
+        filhosNaArvore(caso, pai, &e, &d);
+        tabela = (int64_t*) alocarMemoria((size_t) r->colunas * sizeof(int64_t), "malloc concluirSala");
+        combinarSala(t, pai, e != SALA_NENHUMA ? r->tabelas[e] : NULL, d != SALA_NENHUMA ? r->tabelas[d] : NULL, tabela);
+        if (e != SALA_NENHUMA) { free(r->tabelas[e]); r->tabelas[e] = NULL; }
+        if (d != SALA_NENHUMA) { free(r->tabelas[d]); r->tabelas[d] = NULL; }
+        v = pai;
+    }
+}
+
+// põe 'v' na fila 'fila' e acorda uma thread estacionada, se houver
+static void publicarTarefa(ArvoreResolvedor *r, int fila, uint32_t v) {
+    atomic_fetch_add(&r->tarefas, 1);
+    porTarefa(&r->filas[fila], v);
+    pthread_mutex_lock(&r->trava);
+    pthread_cond_signal(&r->acordar);
+    pthread_mutex_unlock(&r->trava);
+}
+
+static void executarTarefaArvore(TrabalhadorArvore *t, uint32_t v) {
+    ArvoreResolvedor *r = t->r;
+    const IndiceCaminhos *ic = &r->caso->caminhos;
+    t->tarefas++;
+    if (ic->saida[v] - ic->entrada[v] <= r->grao) {
+        concluirSala(t, v, resolverSubarvore(t, v));
+        return;
+    }
+    uint32_t e, d;
+    filhosNaArvore(r->caso, v, &e, &d);
+    atomic_store(&r->pendentes[v], (unsigned) (e != SALA_NENHUMA) + (d != SALA_NENHUMA));
+    // a direita entra antes, para a esquerda sair primeiro do fim da fila
+    if (d != SALA_NENHUMA) publicarTarefa(r, t->eu, d);
+    if (e != SALA_NENHUMA) publicarTarefa(r, t->eu, e);
+}
+
+static void* trabalharArvore(void *arg) {
+    TrabalhadorArvore *t = (TrabalhadorArvore*) arg;
+    ArvoreResolvedor *r = t->r;
+    uint32_t v;
+    while (!atomic_load(&r->concluido)) {
+        if (tirarTarefa(&r->filas[t->eu], &v, 0)) {
+            atomic_fetch_sub(&r->tarefas, 1);
+            executarTarefaArvore(t, v);
+            continue;
+        }
+        // sem trabalho: rouba do início da fila de outra thread, a partir de uma sorteada
+        t->sorteio ^= t->sorteio << 13;
+        t->sorteio ^= t->sorteio >> 7;
+        t->sorteio ^= t->sorteio << 17;
+        int achou = 0;
+        for (int k = 0; k < r->nFilas && !achou; k++) {
+            int vitima = (int) ((t->sorteio + (unsigned) k) % (unsigned) r->nFilas);
+            if (vitima != t->eu) achou = tirarTarefa(&r->filas[vitima], &v, 1);
+        }
+        if (achou) {
+            atomic_fetch_sub(&r->tarefas, 1);
+            t->roubos++;
+            executarTarefaArvore(t, v);
+            continue;
+        }
+        // nada em fila nenhuma: dorme até publicarTarefa ou o fim
+        pthread_mutex_lock(&r->trava);
+        while (!atomic_load(&r->concluido) && atomic_load(&r->tarefas) == 0)
+            pthread_cond_wait(&r->acordar, &r->trava);
+        pthread_mutex_unlock(&r->trava);
+    }
+    return NULL;
+}
+
+/*
+ * resolverPorArvore: resolve os suspeitos de 'lista' (com as faixas já
+ * conferidas) em grupos de até RESOLVER_COLUNAS_MAX custos por sala.
+ */
+static void resolverPorArvore(const Caso *caso, const uint32_t *densaDaSala, const uint32_t *lista, uint32_t total,
+                              const int64_t *positivos, const int64_t *negativos, int nThreads, SolucaoSuspeito *solucoes) {
+    uint32_t nSus = totalSuspeitos(), n = caso->mansao.total;
+    int64_t limiar = caso->limiarSustentar;
+    ArvoreResolvedor r;
+    memset(&r, 0, sizeof(r));
+    r.caso = caso;
+    r.densaDaSala = densaDaSala;
+    r.membroDoSuspeito = (uint32_t*) alocarMemoria((size_t) nSus * sizeof(uint32_t), "malloc resolverPorArvore");
+    memset(r.membroDoSuspeito, 0xFF, (size_t) nSus * sizeof(uint32_t));
+    r.inicio = (uint32_t*) alocarMemoria(((size_t) total + 1) * sizeof(uint32_t), "malloc resolverPorArvore");
+    r.piso = (int64_t*) alocarMemoria(((size_t) total + 1) * sizeof(int64_t), "malloc resolverPorArvore");
+    r.tabelas = (int64_t**) alocarZerada(n, sizeof(int64_t*), "calloc resolverPorArvore");
+    r.pendentes = (atomic_uint*) alocarZerada(n, sizeof(atomic_uint), "calloc resolverPorArvore");
+    r.nFilas = nThreads;
+    r.filas = (FilaTarefas*) alocarZerada((size_t) nThreads, sizeof(FilaTarefas), "calloc resolverPorArvore");
+    pthread_mutex_init(&r.trava, NULL);
+    pthread_cond_init(&r.acordar, NULL);
+    TrabalhadorArvore *trab = (TrabalhadorArvore*) alocarZerada((size_t) nThreads, sizeof(TrabalhadorArvore), "calloc resolverPorArvore");
+    for (int i = 0; i < nThreads; i++) {
+        pthread_mutex_init(&r.filas[i].trava, NULL);
+        trab[i].r = &r;
+        trab[i].eu = i;
+        trab[i].sorteio = 0x9E3779B97F4A7C15ULL * (unsigned) (i + 1);
+        trab[i].copia = (int64_t*) alocarMemoria(RESOLVER_COLUNAS_MAX * sizeof(int64_t), "malloc resolverPorArvore");
+        trab[i].peso = (int64_t*) alocarZerada(RESOLVER_COLUNAS_MAX, sizeof(int64_t), "calloc resolverPorArvore");
+    }
+
+    for (uint32_t g = 0; g < total;) {
+        // monta o grupo: faixas lado a lado enquanto couberem
+        r.membros = 0;
+        r.colunas = 0;
+        for (; g < total; g++) {
+            SuspeitoId s = lista[g];
+            int64_t piso = limiar - positivos[s] > negativos[s] ? limiar - positivos[s] : negativos[s];
+            int64_t largura = limiar - negativos[s] - piso + 1;
+            if (r.membros > 0 && r.colunas + largura > RESOLVER_COLUNAS_MAX) break;
+            r.membroDoSuspeito[s] = r.membros;
+            r.inicio[r.membros] = r.colunas;
+            r.piso[r.membros++] = piso;
+            r.colunas += (uint32_t) largura;
+        }
+        r.inicio[r.membros] = r.colunas;
+        size_t bytesPorSala = (size_t) r.colunas * sizeof(int64_t);
+        r.grao = RESOLVER_BUFFER_BYTES / bytesPorSala > 0 ? (uint32_t) (RESOLVER_BUFFER_BYTES / bytesPorSala) : 1;
+        for (int i = 0; i < nThreads; i++)
+            trab[i].buffer = (int64_t*) realocarMemoria(trab[i].buffer, (size_t) r.grao * bytesPorSala, "realloc resolverPorArvore");
+        atomic_store(&r.concluido, 0);
+        atomic_store(&r.tarefas, 0);
+        r.raiz = NULL;
+        publicarTarefa(&r, 0, caso->mansao.raiz);
+        paralelizar(nThreads, trabalharArvore, trab, sizeof(TrabalhadorArvore));
+
+        for (uint32_t m = 0; m < r.membros; m++) {
+            SuspeitoId s = lista[g - r.membros + m];
+            int64_t melhor = CUSTO_INFINITO;
+            for (uint32_t i = r.inicio[m] + (uint32_t) (limiar - r.piso[m]); i < r.inicio[m + 1]; i++)
+                if (r.raiz[i] < melhor) melhor = r.raiz[i];
+            solucoes[s].prova = PROVA_ARVORE;
+            solucoes[s].situacao = melhor < CUSTO_INFINITO ? SOLUCAO_SUSTENTAVEL : SOLUCAO_IMPOSSIVEL;
+            if (melhor < CUSTO_INFINITO) solucoes[s].passos = melhor - 1; // sem o [r] antes do primeiro caminho
+            r.membroDoSuspeito[s] = UINT32_MAX;
+        }
+        free(r.raiz);
+    }
+
+    for (int i = 0; i < nThreads; i++) {
+        pthread_mutex_destroy(&r.filas[i].trava);
+        free(r.filas[i].itens);
+        free(trab[i].buffer);
+        free(trab[i].copia);
+        free(trab[i].peso);
+    }
+    pthread_cond_destroy(&r.acordar);
+    pthread_mutex_destroy(&r.trava);
+    free(trab);
+    free(r.filas);
+    free(r.pendentes);
+    free(r.tabelas);
+    free(r.piso);
+    free(r.inicio);
+    free(r.membroDoSuspeito);
+}
+
+// Busca por conjuntos de pistas (suspeitos com pistas repetidas)
+typedef struct CandidataResolvedor {
+    uint64_t mascara;       // pistas relevantes do caminho até a sala
+    int64_t custo;          // [r] + descida até a sala
+} CandidataResolvedor;
+
+typedef struct EstadoResolvedor {
+    int64_t custo;
+    uint64_t mascara;
+} EstadoResolvedor;
+
+typedef struct BuscaConjuntos {
+    const Caso *caso;
+    const uint32_t *densaDaSala;
+    const uint64_t *alcancavel;     // bitset das pistas alcançáveis
+    const uint32_t *lista;
+    uint32_t total;
+    atomic_uint proximo;
+    SolucaoSuspeito *solucoes;
+} BuscaConjuntos;
+
+typedef struct TrabalhadorConjuntos {
+    BuscaConjuntos *b;
+    uint64_t *mascara;      // por sala
+} TrabalhadorConjuntos;
+
+static int compararCandidatas(const void *a, const void *b) {
+    const CandidataResolvedor *x = (const CandidataResolvedor*) a, *y = (const CandidataResolvedor*) b;
+    if (x->mascara != y->mascara) return x->mascara < y->mascara ? -1 : 1;
+    return (x->custo > y->custo) - (x->custo < y->custo);
+}
+
+static int64_t pontosDaMascara(uint64_t m, const int64_t *pesos) {
+    int64_t p = 0;
+    for (; m; m &= m - 1) p += pesos[__builtin_ctzll(m)];
+    return p;
+}
+
+static void porEstado(EstadoResolvedor **heap, size_t *n, size_t *cap, int64_t custo, uint64_t mascara) {
+    if (*n == *cap) {
+        *cap = *cap ? 2 * *cap : 256;
+        *heap = (EstadoResolvedor*) realocarMemoria(*heap, *cap * sizeof(EstadoResolvedor), "realloc porEstado");
+    }
+    EstadoResolvedor *h = *heap;
+    size_t i = (*n)++;
+    for (; i > 0 && h[(i - 1) / 2].custo > custo; i = (i - 1) / 2) h[i] = h[(i - 1) / 2];
+    h[i].custo = custo;
+    h[i].mascara = mascara;
+}
+
+static EstadoResolvedor tirarEstado(EstadoResolvedor *h, size_t *n) {
+    EstadoResolvedor topo = h[0], ultimo = h[--*n];
+    size_t i = 0;
+    for (;;) {
+        size_t f = 2 * i + 1;
+        if (f >= *n) break;
+        if (f + 1 < *n && h[f + 1].custo < h[f].custo) f++;
+        if (h[f].custo >= ultimo.custo) break;
+        h[i] = h[f];
+        i = f;
+    }
+    if (*n > 0) h[i] = ultimo;
+    return topo;
+}
+
+// conjunto de máscaras já fechadas (endereçamento aberto; 'usada' separa a máscara 0)
+typedef struct MascarasVistas {
+    uint64_t *chaves;
+    unsigned char *usada;
+    size_t cap, total;
+} MascarasVistas;
+
+static size_t posicaoDaMascara(const MascarasVistas *v, uint64_t m) {
+    size_t i = (size_t) ((m * 0x9E3779B97F4A7C15ULL) >> 20) & (v->cap - 1);
+    while (v->usada[i] && v->chaves[i] != m) i = (i + 1) & (v->cap - 1);
+    return i;
+}
+
+static int marcarMascara(MascarasVistas *v, uint64_t m) {
+    if (2 * (v->total + 1) > v->cap) {
+        MascarasVistas maior = { NULL, NULL, v->cap ? 2 * v->cap : 1024, 0 };
+        maior.chaves = (uint64_t*) alocarMemoria(maior.cap * sizeof(uint64_t), "malloc marcarMascara");
+        maior.usada = (unsigned char*) alocarZerada(maior.cap, 1, "calloc marcarMascara");
+        for (size_t i = 0; i < v->cap; i++) {
+            if (!v->usada[i]) continue;
+            size_t j = posicaoDaMascara(&maior, v->chaves[i]);
+            maior.usada[j] = 1;
+            maior.chaves[j] = v->chaves[i];
+        }
+        maior.total = v->total;
+        free(v->chaves);
+        free(v->usada);
+        *v = maior;
+    }
+    size_t i = posicaoDaMascara(v, m);
+    if (v->usada[i]) return 0;
+    v->usada[i] = 1;
+    v->chaves[i] = m;
+    v->total++;
+    return 1;
+}
+
+/*
+ * buscarPorConjuntos: menor custo até um conjunto de pistas relevantes que
+ * sustente a acusação contra 's'. Cada candidata é o caminho da raiz até
+ * uma sala com pista positiva (descartadas as dominadas: mais caras sem
+ * trazer pista positiva a mais nem negativa a menos); o custo de um estado
+ * é a soma dos custos das candidatas usadas, menos o [r] inicial.
+ */
+static void buscarPorConjuntos(const BuscaConjuntos *b, SuspeitoId s, uint64_t *mascara, SolucaoSuspeito *sol) {
+    const Caso *caso = b->caso;
+    const IndiceCaminhos *ic = &caso->caminhos;
+    int64_t limiar = caso->limiarSustentar;
+    sol->prova = PROVA_CONJUNTOS;
+
+    // o bit k das máscaras é a k-ésima pista relevante em ordem de id denso
+    uint32_t ids[RESOLVER_RELEVANTES_MAX];
+    int64_t pesos[RESOLVER_RELEVANTES_MAX];
+    int relevantes = 0;
+    for (uint32_t d = 0; d < caso->totalPistas; d++) {
+        if (!(b->alcancavel[d >> 6] & (1ull << (d & 63)))) continue;
+        PesoEvidencia um;
+        const PesoEvidencia *vetor;
+        uint32_t n = vetorDaPista(caso, d, &um, &vetor);
+        int64_t w = 0;
+        for (uint32_t k = 0; k < n; k++)
+            if (vetor[k].suspeito == s) w += vetor[k].peso;
+        if (w == 0) continue;
+        ids[relevantes] = d;
+        pesos[relevantes++] = w;
+    }
+    uint64_t positivas = 0;
+    for (int k = 0; k < relevantes; k++)
+        if (pesos[k] > 0) positivas |= 1ull << k;
+
+    // máscara de cada sala: pistas relevantes do caminho desde a raiz (o pai vem antes na pré-ordem)
+    size_t nCand = 0, capCand = 0;
+    CandidataResolvedor *cand = NULL;
+    for (uint32_t j = 0; j < ic->alcancaveis; j++) {
+        uint32_t v = ic->ordem[j], d = b->densaDaSala[v];
+        uint64_t m = j ? mascara[ic->pai[v]] : 0;
+        int lo = 0, hi = relevantes;
+        while (d != PISTA_NENHUMA && lo < hi) {
+            int meio = (lo + hi) / 2;
+            if (ids[meio] < d) lo = meio + 1;
+            else hi = meio;
+        }
+        int propria = d != PISTA_NENHUMA && lo < relevantes && ids[lo] == d ? lo : -1;
+        if (propria >= 0) m |= 1ull << propria;
+        mascara[v] = m;
+        if (propria < 0 || pesos[propria] <= 0) continue;
+        if (nCand == capCand) {
+            capCand = capCand ? 2 * capCand : 256;
+            cand = (CandidataResolvedor*) realocarMemoria(cand, capCand * sizeof(CandidataResolvedor), "realloc buscarPorConjuntos");
+        }
+        cand[nCand].mascara = m;
+        cand[nCand++].custo = (int64_t) ic->profundidade[v] + 1;
+    }
+    // uma candidata por máscara (a mais barata), sem as dominadas
+    qsort(cand, nCand, sizeof(CandidataResolvedor), compararCandidatas);
+    size_t unicas = 0;
+    for (size_t i = 0; i < nCand; i++)
+        if (unicas == 0 || cand[unicas - 1].mascara != cand[i].mascara) cand[unicas++] = cand[i];
+    nCand = unicas;
+    if (nCand > RESOLVER_CANDIDATAS_MAX) {
+        sol->situacao = SOLUCAO_INDETERMINADA;
+        sol->motivo = MOTIVO_CANDIDATAS;
+        free(cand);
+        return;
+    }
+    unicas = 0;
+    for (size_t i = 0; i < nCand; i++) {
+        int dominada = 0;
+        for (size_t j = 0; j < nCand && !dominada; j++) {
+            if (j == i || cand[j].custo > cand[i].custo) continue;
+            dominada = !(cand[i].mascara & positivas & ~cand[j].mascara) && !(cand[j].mascara & ~positivas & ~cand[i].mascara);
+        }
+        if (!dominada) cand[unicas++] = cand[i];
+    }
+    nCand = unicas;
+
+    uint64_t inicio = mascara[caso->mansao.raiz];
+    sol->situacao = SOLUCAO_IMPOSSIVEL;
+    if (pontosDaMascara(inicio, pesos) >= limiar) {
+        sol->situacao = SOLUCAO_SUSTENTAVEL;
+        sol->passos = 0;
+        free(cand);
+        return;
+    }
+    EstadoResolvedor *heap = NULL;
+    size_t nHeap = 0, capHeap = 0;
+    MascarasVistas vistas = { NULL, NULL, 0, 0 };
+    porEstado(&heap, &nHeap, &capHeap, -1, inicio); // -1: o primeiro caminho não tem [r]
+    while (nHeap > 0) {
+        EstadoResolvedor e = tirarEstado(heap, &nHeap);
+        if (!marcarMascara(&vistas, e.mascara)) continue;
+        if (pontosDaMascara(e.mascara, pesos) >= limiar) {
+            sol->situacao = SOLUCAO_SUSTENTAVEL;
+            sol->passos = e.custo;
+            break;
+        }
+        if (vistas.total > RESOLVER_ESTADOS_MAX || nHeap > 8 * (size_t) RESOLVER_ESTADOS_MAX) {
+            sol->situacao = SOLUCAO_INDETERMINADA;
+            sol->motivo = MOTIVO_ESTADOS;
+            break;
+        }
+        for (size_t c = 0; c < nCand; c++) {
+            if (!(cand[c].mascara & positivas & ~e.mascara)) continue;
+            uint64_t m = e.mascara | cand[c].mascara;
+            // sem chance: nem com todas as positivas que faltam
+            if (pontosDaMascara(m, pesos) + pontosDaMascara(positivas & ~m, pesos) < limiar) continue;
+            if (vistas.cap && vistas.usada[posicaoDaMascara(&vistas, m)]) continue;
+            porEstado(&heap, &nHeap, &capHeap, e.custo + cand[c].custo, m);
+        }
+    }
+    free(heap);
+    free(vistas.chaves);
+    free(vistas.usada);
+    free(cand);
+}
+
+static void* trabalharConjuntos(void *arg) {
+    TrabalhadorConjuntos *t = (TrabalhadorConjuntos*) arg;
+    BuscaConjuntos *b = t->b;
+    for (;;) {
+        uint32_t i = atomic_fetch_add(&b->proximo, 1);
+        if (i >= b->total) break;
+        if (!t->mascara)
+            t->mascara = (uint64_t*) alocarMemoria((size_t) b->caso->mansao.total * sizeof(uint64_t), "malloc trabalharConjuntos");
+        buscarPorConjuntos(b, b->lista[i], t->mascara, &b->solucoes[b->lista[i]]);
+    }
+    return NULL;
+}
+
+/*
+ * resolverCaso: preenche solucoes[s] para cada suspeito cadastrado
+ * (totalSuspeitos() posições) com 'nThreads' threads. Devolve -1 se a
+ * mansão é procedural.
+ */
+int resolverCaso(const Caso *caso, int nThreads, SolucaoSuspeito *solucoes) {
+    const Mansao *m = &caso->mansao;
+    const IndiceCaminhos *ic = &caso->caminhos;
+    uint32_t nSus = totalSuspeitos();
+    memset(solucoes, 0, (size_t) nSus * sizeof(SolucaoSuspeito));
+    if (m->procedural) return -1;
+    if (nThreads < 1) nThreads = 1;
+    uint32_t alcancaveis = m->total > 0 ? ic->alcancaveis : 0;
+    int64_t limiar = caso->limiarSustentar;
+
+    // pistas alcançáveis e repetidas, em bitsets sobre os ids densos
+    size_t palavras = ((size_t) caso->totalPistas + 63) / 64 + 1;
+    uint64_t *alcancavel = (uint64_t*) alocarZerada(palavras, sizeof(uint64_t), "calloc resolverCaso");
+    uint64_t *repetida = (uint64_t*) alocarZerada(palavras, sizeof(uint64_t), "calloc resolverCaso");
+    uint32_t *densaDaSala = (uint32_t*) alocarMemoria((size_t) m->total * sizeof(uint32_t) + 1, "malloc resolverCaso");
+    memset(densaDaSala, 0xFF, (size_t) m->total * sizeof(uint32_t));
+    for (uint32_t j = 0; j < alcancaveis; j++) {
+        uint32_t v = ic->ordem[j], d = pistaDensa(caso, m->salas[v].pista);
+        if (d >= caso->totalPistas) continue;
+        densaDaSala[v] = d;
+        uint64_t bit = 1ull << (d & 63);
+        if (alcancavel[d >> 6] & bit) repetida[d >> 6] |= bit;
+        alcancavel[d >> 6] |= bit;
+    }
+    int64_t *positivos = (int64_t*) alocarZerada(nSus + 1, sizeof(int64_t), "calloc resolverCaso");
+    int64_t *negativos = (int64_t*) alocarZerada(nSus + 1, sizeof(int64_t), "calloc resolverCaso");
+    for (uint32_t d = 0; d < caso->totalPistas; d++) {
+        if (!(alcancavel[d >> 6] & (1ull << (d & 63)))) continue;
+        PesoEvidencia um;
+        const PesoEvidencia *vetor;
+        uint32_t n = vetorDaPista(caso, d, &um, &vetor);
+        for (uint32_t k = 0; k < n; k++) {
+            SuspeitoId s = vetor[k].suspeito;
+            if (s >= nSus || vetor[k].peso == 0) continue;
+            solucoes[s].relevantes++;
+            if (repetida[d >> 6] & (1ull << (d & 63))) solucoes[s].repetidas = 1;
+            if (vetor[k].peso > 0) positivos[s] += vetor[k].peso;
+            else negativos[s] += vetor[k].peso;
+        }
+    }
+
+    // cota: decide sem busca; os demais vão para a árvore ou para a busca por conjuntos
+    uint32_t *porArvore = (uint32_t*) alocarMemoria((size_t) nSus * sizeof(uint32_t) + 1, "malloc resolverCaso");
+    uint32_t *porConjuntos = (uint32_t*) alocarMemoria((size_t) nSus * sizeof(uint32_t) + 1, "malloc resolverCaso");
+    uint32_t nArvore = 0, nConjuntos = 0;
+    for (SuspeitoId s = 0; s < nSus; s++) {
+        SolucaoSuspeito *sol = &solucoes[s];
+        sol->maximo = positivos[s];
+        sol->situacao = SOLUCAO_INDETERMINADA;
+        sol->prova = PROVA_NENHUMA;
+        if (alcancaveis == 0 || positivos[s] < limiar || negativos[s] >= limiar) {
+            // sem pontos que bastem, ou nem todos os negativos juntos derrubam: a entrada já decide
+            sol->prova = PROVA_COTA;
+            sol->situacao = alcancaveis > 0 && negativos[s] >= limiar ? SOLUCAO_SUSTENTAVEL : SOLUCAO_IMPOSSIVEL;
+            continue;
+        }
+        int64_t piso = limiar - positivos[s] > negativos[s] ? limiar - positivos[s] : negativos[s];
+        if (!sol->repetidas && limiar - negativos[s] - piso + 1 <= RESOLVER_COLUNAS_MAX) porArvore[nArvore++] = s;
+        else if (sol->relevantes <= RESOLVER_RELEVANTES_MAX) porConjuntos[nConjuntos++] = s;
+        else sol->motivo = sol->repetidas ? MOTIVO_REPETIDAS : MOTIVO_FAIXA;
+    }
+
+    if (nArvore > 0) resolverPorArvore(caso, densaDaSala, porArvore, nArvore, positivos, negativos, nThreads, solucoes);
+    if (nConjuntos > 0) {
+        BuscaConjuntos b = { caso, densaDaSala, alcancavel, porConjuntos, nConjuntos, 0, solucoes };
+        atomic_init(&b.proximo, 0);
+        int n = nThreads < (int) nConjuntos ? nThreads : (int) nConjuntos;
+        TrabalhadorConjuntos *trab = (TrabalhadorConjuntos*) alocarZerada((size_t) n, sizeof(TrabalhadorConjuntos), "calloc resolverCaso");
+        for (int i = 0; i < n; i++) trab[i].b = &b;
+        paralelizar(n, trabalharConjuntos, trab, sizeof(TrabalhadorConjuntos));
+        for (int i = 0; i < n; i++) free(trab[i].mascara);
+        free(trab);
+    }
+
+    free(porConjuntos);
+    free(porArvore);
+    free(negativos);
+    free(positivos);
+    free(densaDaSala);
+    free(repetida);
+    free(alcancavel);
+    return 0;
+}
+
+static const char *const NOMES_SOLUCOES[] = { "impossivel", "sustentavel", "indeterminado" };
+static const char *const NOMES_PROVAS[] = { "cota", "arvore", "conjuntos", "nenhuma" };
+static const char *const NOMES_MOTIVOS[] = { "nenhum", "repetidas", "faixa", "candidatas", "estados" };
+
+// relatório do resolvedor, um suspeito por linha (em ordem de cadastro)
+void relatarResolucao(Saida *saida, const Caso *caso, const SolucaoSuspeito *solucoes) {
+    uint32_t nSus = totalSuspeitos();
+    int json = saida->formato == SAIDA_JSON;
+    if (!json) escreverSaida(saida, "Resolucao do caso (acusacao sustentada com %d ponto(s)):\n", caso->limiarSustentar);
+    for (SuspeitoId s = 0; s < nSus; s++) {
+        const SolucaoSuspeito *sol = &solucoes[s];
+        if (json) {
+            escreverSaida(saida, "{\"evento\":\"resolucao\",\"suspeito\":");
+            escreverJsonTexto(saida, nomeDoSuspeito(s));
+            escreverSaida(saida, ",\"situacao\":\"%s\",\"passos\":", NOMES_SOLUCOES[sol->situacao]);
+            if (sol->situacao == SOLUCAO_SUSTENTAVEL) escreverSaida(saida, "%lld", sol->passos);
+            else escreverSaida(saida, "null");
+            escreverSaida(saida, ",\"prova\":\"%s\",\"maximo\":%lld,\"pistas\":%u,\"repetidas\":%s", NOMES_PROVAS[sol->prova],
+                          sol->maximo, sol->relevantes, sol->repetidas ? "true" : "false");
+            if (sol->situacao == SOLUCAO_INDETERMINADA) escreverSaida(saida, ",\"motivo\":\"%s\"}\n", NOMES_MOTIVOS[sol->motivo]);
+            else escreverSaida(saida, "}\n");
+        } else if (sol->situacao == SOLUCAO_SUSTENTAVEL) {
+            escreverSaida(saida, "- %s: sustentavel em %lld passo(s)\n", nomeDoSuspeito(s), sol->passos);
+        } else if (sol->situacao == SOLUCAO_IMPOSSIVEL && sol->prova == PROVA_COTA) {
+            escreverSaida(saida, "- %s: impossivel (no maximo %lld ponto(s))\n", nomeDoSuspeito(s), sol->maximo);
+        } else if (sol->situacao == SOLUCAO_IMPOSSIVEL) {
+            escreverSaida(saida, "- %s: impossivel (as pistas que inocentam pesam demais)\n", nomeDoSuspeito(s));
+        } else if (sol->motivo == MOTIVO_REPETIDAS) {
+            escreverSaida(saida, "- %s: indeterminado (%u pistas relevantes, algumas repetidas)\n", nomeDoSuspeito(s), sol->relevantes);
+        } else if (sol->motivo == MOTIVO_FAIXA) {
+            escreverSaida(saida, "- %s: indeterminado (%u pistas relevantes, faixa de pontos larga demais)\n", nomeDoSuspeito(s),
+                          sol->relevantes);
+        } else if (sol->motivo == MOTIVO_CANDIDATAS) {
+            escreverSaida(saida, "- %s: indeterminado (mais de %d caminhos candidatos)\n", nomeDoSuspeito(s), RESOLVER_CANDIDATAS_MAX);
+        } else {
+            escreverSaida(saida, "- %s: indeterminado (mais de %u conjuntos de pistas na busca)\n", nomeDoSuspeito(s),
+                          RESOLVER_ESTADOS_MAX);
+        }
+        if (saida->usado >= SAIDA_LOTE) descarregarSaida(saida);
+    }
+    descarregarSaida(saida);
+}
+
+/*
+ * listarPistasEAssociacoes:
+ * - Percorre a AVL em ordem e escreve cada pista com o suspeito associado (se houver).
+ */
+void listarPistasEAssociacoes(Saida *saida, PistaNode *raiz, TabelaHash *tab) {
+    CursorArvore c;
+    PistaNode *n;
+    abrirCursorPistas(&c, raiz, ORDEM_EM);
+    while ((n = proximaPista(&c))) {
+        SuspeitoId sus = encontrarSuspeitoId(tab, n->pista);
+        const char *nome = sus == SUSPEITO_NENHUM ? "Desconhecido" : nomeDoSuspeito(sus);
+        if (saida->formato == SAIDA_JSON) {
+            escreverSaida(saida, "{\"evento\":\"associacao\",\"pista\":");
+            escreverJsonTexto(saida, textoDe(n->pista));
+            escreverSaida(saida, ",\"suspeito\":");
+            escreverJsonTexto(saida, nome);
+            escreverSaida(saida, "}\n");
+        } else {
+            escreverSaida(saida, "- \"%s\"  -> Suspeito sugerido: %s\n", textoDe(n->pista), nome);
+        }
+        if (saida->usado >= SAIDA_LOTE) descarregarSaida(saida);
+    }
+    fecharCursor(&c);
+    descarregarSaida(saida);
+}
+
+static const char *const NOMES_SITUACOES[] = { "indefinido", "incriminado", "inocentado" };
+
+/*
+ * verificarSuspeitoFinal:
+ * - Recebe o nome do suspeito acusado pelo jogador.
+ * - Lê no placar quantas pistas coletadas citam esse suspeito e quantos
+ *   pontos elas somam contra ele (O(1), sem percorrer o caderno).
+ * - Regras: pontos >= limiarSustentar do caso (sem pesos, 2 pistas) =>
+ *   acusacao sustentada; pontos <= limiarInocentar => suspeito inocentado;
+ *   caso contrário => insuficiente.
+ */
+void verificarSuspeitoFinal(Saida *saida, PistaNode *raizPistas, const Placar *placar, const Caso *caso, const char *acusado) {
+    SuspeitoId sus = buscarSuspeito(acusado);
+    int count = placarContagem(placar, sus);
+    int64_t pontos = 0;
+    int sustentada = raizPistas ? acusacaoSustentada(placar, acusado, caso->limiarSustentar, &pontos) : 0;
+    SituacaoSuspeito situacao = raizPistas ? situacaoSuspeito(placar, caso, sus) : SITUACAO_INDEFINIDA;
+    if (saida->formato == SAIDA_JSON) {
+        escreverSaida(saida, "{\"evento\":\"veredito\",\"acusado\":");
+        escreverJsonTexto(saida, acusado);
+        escreverSaida(saida, ",\"pistas\":%d,\"pontos\":%lld,\"situacao\":\"%s\",\"sustentada\":%s}\n",
+                      count, (long long) pontos, NOMES_SITUACOES[situacao], sustentada ? "true" : "false");
+    } else if (!raizPistas) {
+        escreverSaida(saida, "Nenhuma pista coletada. Impossivel sustentar acusacao.\n");
+    } else {
+        escreverSaida(saida, "\nResultado da verificacao:\n");
+        escreverSaida(saida, "Pistas que apontam para %s: %d\n", acusado, count);
+        if (caso->inicioPesos)
+            escreverSaida(saida, "Pontos das evidencias contra %s: %lld (sustenta com %d)\n", acusado, (long long) pontos, caso->limiarSustentar);
+        if (sustentada) {
+            escreverSaida(saida, "Acusacao SUSTENTADA: ha evidencias suficientes para prender %s.\n", acusado);
+        } else if (situacao == SITUACAO_INOCENTADO) {
+            escreverSaida(saida, "Acusacao NAO sustentada: as evidencias inocentam %s.\n", acusado);
+        } else {
+            escreverSaida(saida, "Acusacao NAO sustentada: nao ha pistas suficientes contra %s.\n", acusado);
+        }
+    }
+    descarregarSaida(saida);
+}
+
+/*
+ * acusacaoSustentada: 1 se as pistas do caderno somam ao menos 'limiar'
+ * pontos contra o acusado (leitura O(1) no placar). 'pontos' recebe a soma,
+ * que sem pesos no caso é o número de pistas.
+ */
+int acusacaoSustentada(const Placar *placar, const char *acusado, int limiar, int64_t *pontos) {
+    *pontos = placarPontos(placar, buscarSuspeito(acusado));
+    return *pontos >= limiar;
+}
+
+/*
+ * mostrarRankingSuspeitos: lista os suspeitos citados pelas pistas coletadas,
+ * do que soma mais pontos ao que soma menos. Com pesos no caso, mostra os
+ * pontos e marca os suspeitos que passam de um dos limiares.
+ */
+void mostrarRankingSuspeitos(Saida *saida, const Placar *placar, const Caso *caso) {
+    uint32_t n = totalSuspeitos();
+    if (n == 0) return;
+    SuspeitoId *ordem = (SuspeitoId*) alocarMemoria(n * sizeof(SuspeitoId), "malloc mostrarRankingSuspeitos");
+    rankingSuspeitos(placar, ordem);
+    uint32_t posicao = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        int pistas = placarContagem(placar, ordem[i]);
+        if (pistas == 0) continue;
+        int64_t pontos = placarPontos(placar, ordem[i]);
+        SituacaoSuspeito situacao = situacaoSuspeito(placar, caso, ordem[i]);
+        posicao++;
+        if (saida->formato == SAIDA_JSON) {
+            escreverSaida(saida, "{\"evento\":\"ranking\",\"posicao\":%u,\"suspeito\":", posicao);
+            escreverJsonTexto(saida, nomeDoSuspeito(ordem[i]));
+            escreverSaida(saida, ",\"pistas\":%d,\"pontos\":%lld,\"situacao\":\"%s\"}\n", pistas, (long long) pontos, NOMES_SITUACOES[situacao]);
+        } else if (!caso->inicioPesos) {
+            escreverSaida(saida, "%u. %s (%d pista(s))\n", posicao, nomeDoSuspeito(ordem[i]), pistas);
+        } else {
+            escreverSaida(saida, "%u. %s (%d pista(s), %lld ponto(s))%s\n", posicao, nomeDoSuspeito(ordem[i]), pistas, (long long) pontos,
+                          situacao == SITUACAO_INCRIMINADO ? " - acusacao sustentavel"
+                          : situacao == SITUACAO_INOCENTADO ? " - inocentado" : "");
+        }
+    }
+    free(ordem);
+    descarregarSaida(saida);
+}
+
+/* 
+ * contarPistasPorSuspeito: percorre a AVL e incrementa *out_count cada vez 
+ * que a pista aponta para 'acusado' (segundo a tabela hash).
+ * Recontagem completa, usada para conferir o placar.
+ */
+void contarPistasPorSuspeito(PistaNode *raiz, TabelaHash *tab, const char *acusado, int *out_count) {
+    CursorArvore c;
+    PistaNode *n;
+    abrirCursorPistas(&c, raiz, ORDEM_EM);
+    while ((n = proximaPista(&c))) {
+        SuspeitoId sus = encontrarSuspeitoId(tab, n->pista);
+        if (sus != SUSPEITO_NENHUM && iguaisSemCaixa(nomeDoSuspeito(sus), acusado)) (*out_count)++;
+    }
+    fecharCursor(&c);
+}
+
+#ifdef DQ_INSTRUMENTAR
+/*
+ * Relatório de instrumentação
+ * Junta os contadores com medidas tiradas das estruturas no fim do jogo:
+ * altura e balanceamento do caderno, altura da árvore da mansão, ocupação
+ * da tabela pista->suspeito (distância de cada entrada até a posição ideal,
+ * o equivalente ao comprimento de cadeia no endereçamento aberto, e
+ * tamanho dos agrupamentos de posições ocupadas) e chamadas a malloc.
+ * DQ_RELATORIO=json troca o texto por JSON; qualquer outro valor não vazio
+ * é tomado como caminho de arquivo (JSON se terminar em .json).
+ */
+#define INSTR_DISTANCIAS 16
+
+typedef struct MedidasArvore {
+    uint32_t nos, folhas;
+    int altura;
+    int desbalanceioMax;    // maior |altura(esq) - altura(dir)| (só caderno)
+} MedidasArvore;
+
+static void medirNoCaderno(PistaNode *n, void *ctx) {
+    MedidasArvore *m = (MedidasArvore*) ctx;
+    int fb = alturaPista(n->esq) - alturaPista(n->dir);
+    if (fb < 0) fb = -fb;
+    if (fb > m->desbalanceioMax) m->desbalanceioMax = fb;
+    m->nos++;
+    if (!n->esq && !n->dir) m->folhas++;
+}
+
+// altura da árvore da mansão plana por percurso com pilha explícita
+static MedidasArvore medirMansao(const Mansao *m) {
+    MedidasArvore r = { 0, 0, 0, 0 };
+    if (m->total == 0) return r;
+    if (m->procedural) { // árvore completa: as medidas saem do total
+        r.nos = m->total;
+        r.folhas = m->total - m->total / 2;
+        r.altura = (int) profundidadeNoHeap(m->total - 1) + 1;
+        return r;
+    }
+    uint32_t *pilha = (uint32_t*) alocarMemoria(2 * m->total * sizeof(uint32_t), "malloc medirMansao");
+    size_t topo = 0;
+    pilha[topo++] = m->raiz;
+    pilha[topo++] = 1;
+    while (topo > 0) {
+        uint32_t prof = pilha[--topo], i = pilha[--topo];
+        const SalaPlana *sala = &m->salas[i];
+        r.nos++;
+        if ((int) prof > r.altura) r.altura = (int) prof;
+        if (sala->esq == SALA_NENHUMA && sala->dir == SALA_NENHUMA) r.folhas++;
+        if (sala->esq != SALA_NENHUMA) { pilha[topo++] = sala->esq; pilha[topo++] = prof + 1; }
+        if (sala->dir != SALA_NENHUMA) { pilha[topo++] = sala->dir; pilha[topo++] = prof + 1; }
+    }
+    free(pilha);
+    return r;
+}
+
+typedef struct MedidasHash {
+    size_t capacidade, tamanho, distanciaMax, somaDistancias;
+    unsigned long distancias[INSTR_DISTANCIAS + 1]; // última faixa: >= INSTR_DISTANCIAS
+    unsigned long agrupamentos[INSTR_FAIXAS];       // por tamanho em potências de 2
+} MedidasHash;
+
+static void medirHash(const TabelaHash *tab, MedidasHash *r) {
+    memset(r, 0, sizeof(*r));
+    r->capacidade = tab->capacidade;
+    r->tamanho = tab->tamanho;
+    size_t corrida = 0;
+    for (size_t i = 0; i <= tab->capacidade; i++) {
+        const HashEntry *e = i < tab->capacidade ? &tab->entradas[i] : NULL;
+        if (e && e->hash) {
+            size_t d = distanciaHash(tab, e, i);
+            r->distancias[d < INSTR_DISTANCIAS ? d : INSTR_DISTANCIAS]++;
+            r->somaDistancias += d;
+            if (d > r->distanciaMax) r->distanciaMax = d;
+            corrida++;
+        } else if (corrida > 0) {
+            r->agrupamentos[63 - __builtin_clzll(corrida)]++;
+            corrida = 0;
+        }
+    }
+}
+
+static const char *NOMES_MEDIDAS[MEDIDAS_TOTAL] = {
+    "inserirPistaIterativa", "inserirNaHash", "inserirNaHashId", "encontrarSuspeito", "encontrarSuspeitoId"
+};
+
+// imprime faixas não vazias de um histograma como {"chave": n, ...} ou "chave:n ..."
+static void imprimirHistograma(FILE *f, int json, const unsigned long *h, int n, int potencias) {
+    int primeiro = 1;
+    fputs(json ? "{" : "", f);
+    for (int k = 0; k < n; k++) {
+        if (!h[k]) continue;
+        if (json) fprintf(f, "%s\"%lu\": %lu", primeiro ? "" : ", ", potencias ? 1UL << k : (unsigned long) k, h[k]);
+        else fprintf(f, " %s%lu:%lu", potencias ? ">=" : "", potencias ? 1UL << k : (unsigned long) k, h[k]);
+        primeiro = 0;
+    }
+    fputs(json ? "}" : "", f);
+}
+
+/*
+ * relatarInstrumentacao: escreve o relatório (stderr por padrão). 'caderno'
+ * é a AVL de pistas da sessão interativa, ou NULL no modo em lote.
+ */
+void relatarInstrumentacao(const Caso *caso, PistaNode *caderno) {
+    const char *destino = getenv("DQ_RELATORIO");
+    int json = destino && (strcmp(destino, "json") == 0 ||
+                           (strlen(destino) > 5 && strcmp(destino + strlen(destino) - 5, ".json") == 0));
+    FILE *f = stderr;
+    if (destino && *destino && strcmp(destino, "json") != 0 && strcmp(destino, "texto") != 0) {
+        f = fopen(destino, "w");
+        if (!f) { perror(destino); return; }
+    }
+
+    MedidasArvore cad = { 0, 0, alturaPista(caderno), 0 };
+    percorrerPistasEmOrdem(caderno, medirNoCaderno, &cad);
+    MedidasArvore man = medirMansao(&caso->mansao);
+    MedidasHash h;
+    medirHash(caso->tabela, &h);
+    unsigned long alturas[65], latencias[INSTR_FAIXAS];
+    for (int k = 0; k < 65; k++) alturas[k] = atomic_load(&g_alturasCaderno[k]);
+
+    fputs(json ? "{\"operacoes\": {" : "== instrumentacao ==\noperacoes (chamadas, sucessos, media/max ns, latencia ns:contagem):\n", f);
+    for (int m = 0; m < MEDIDAS_TOTAL; m++) {
+        const ContadorMedida *c = &g_medidas[m];
+        unsigned long chamadas = atomic_load(&c->chamadas);
+        double media = chamadas ? (double) atomic_load(&c->nanos) / chamadas : 0.0;
+        for (int k = 0; k < INSTR_FAIXAS; k++) latencias[k] = atomic_load(&c->faixas[k]);
+        if (json)
+            fprintf(f, "%s\"%s\": {\"chamadas\": %lu, \"sucessos\": %lu, \"ns_medio\": %.1f, \"ns_max\": %lu, \"latencias_ns\": ",
+                    m ? ", " : "", NOMES_MEDIDAS[m], chamadas, atomic_load(&c->sucessos), media, atomic_load(&c->maximo));
+        else
+            fprintf(f, "  %-22s %10lu %10lu %9.1f %9lu  ", NOMES_MEDIDAS[m], chamadas, atomic_load(&c->sucessos),
+                    media, atomic_load(&c->maximo));
+        imprimirHistograma(f, json, latencias, INSTR_FAIXAS, 1);
+        fputs(json ? "}" : "\n", f);
+    }
+    if (json) {
+        fprintf(f, "}, \"caderno\": {\"pistas\": %u, \"altura\": %d, \"folhas\": %u, \"desbalanceio_max\": %d, "
+                   "\"sessoes\": %lu, \"excesso_altura_max\": %lu, \"alturas\": ",
+                cad.nos, cad.altura, cad.folhas, cad.desbalanceioMax,
+                atomic_load(&g_cadernos), atomic_load(&g_excessoAlturaMax));
+        imprimirHistograma(f, 1, alturas, 65, 0);
+        fprintf(f, "}, \"mansao\": {\"salas\": %u, \"altura\": %d, \"folhas\": %u}", man.nos, man.altura, man.folhas);
+        fprintf(f, ", \"hash\": {\"capacidade\": %zu, \"entradas\": %zu, \"carga\": %.3f, \"distancia_media\": %.3f, "
+                   "\"distancia_max\": %zu, \"distancias\": ",
+                h.capacidade, h.tamanho, h.capacidade ? (double) h.tamanho / h.capacidade : 0.0,
+                h.tamanho ? (double) h.somaDistancias / h.tamanho : 0.0, h.distanciaMax);
+        imprimirHistograma(f, 1, h.distancias, INSTR_DISTANCIAS + 1, 0);
+        fputs(", \"agrupamentos\": ", f);
+        imprimirHistograma(f, 1, h.agrupamentos, INSTR_FAIXAS, 1);
+        fprintf(f, "}, \"memoria\": {\"chamadas_malloc\": %zu, \"textos\": %u, \"suspeitos\": %u}}\n",
+                (size_t) g_chamadasMalloc, g_textos.total, totalSuspeitos());
+    } else {
+        fprintf(f, "caderno: %u pistas, altura %d, %u folhas, desbalanceio max %d\n",
+                cad.nos, cad.altura, cad.folhas, cad.desbalanceioMax);
+        fprintf(f, "cadernos de sessoes: %lu, excesso de altura max %lu, altura:sessoes",
+                atomic_load(&g_cadernos), atomic_load(&g_excessoAlturaMax));
+        imprimirHistograma(f, 0, alturas, 65, 0);
+        fprintf(f, "\nmansao: %u salas, altura %d, %u folhas\n", man.nos, man.altura, man.folhas);
+        fprintf(f, "hash: capacidade %zu, %zu entradas (carga %.3f), distancia media %.3f max %zu\n",
+                h.capacidade, h.tamanho, h.capacidade ? (double) h.tamanho / h.capacidade : 0.0,
+                h.tamanho ? (double) h.somaDistancias / h.tamanho : 0.0, h.distanciaMax);
+        fputs("  distancia:entradas", f);
+        imprimirHistograma(f, 0, h.distancias, INSTR_DISTANCIAS + 1, 0);
+        fputs("\n  agrupamento:quantidade", f);
+        imprimirHistograma(f, 0, h.agrupamentos, INSTR_FAIXAS, 1);
+        fprintf(f, "\nmemoria: %zu chamadas a malloc/calloc, %u textos, %u suspeitos\n",
+                (size_t) g_chamadasMalloc, g_textos.total, totalSuspeitos());
+    }
+    if (f != stderr) fclose(f);
+}
+#endif /* DQ_INSTRUMENTAR */
+
+/*
+ * montarCasoExemplo: monta o mapa fixo da mansão com criarSala, popula a
+ * tabela hash com as associações pré-definidas e gera a mansão plana.
+ */
+void montarCasoExemplo(Arena *arena, TabelaHash *tabela, Mansao *mansao) {
+    /* --- montar mapa fixo da mansao (árvore binária) ---
+     * Exemplo (manual):
+     *                   Entrada
+     *                  /       \
+     *           Sala de Estar   Cozinha
+     *            /     \           \
+     *      Biblioteca QuartoP   Escritorio
+     *        /                       \
+     *    Jardim                    Banheiro
+     */
+
+    Sala *root = criarSala(arena, "Entrada");
+    root->esq = criarSala(arena, "Sala de Estar");
+    root->dir = criarSala(arena, "Cozinha");
+
+    root->esq->esq = criarSala(arena, "Biblioteca");
+    root->esq->dir = criarSala(arena, "Quarto Principal");
+
+    root->dir->dir = criarSala(arena, "Escritorio");
+
+    root->esq->esq->esq = criarSala(arena, "Jardim");
+    root->dir->dir->dir = criarSala(arena, "Banheiro");
+
+    // --- popular tabela hash com associações pista->suspeito ---
+
+    // Exemplo de associações conhecidas (pré-definidas no jogo)
+    inserirNaHash(tabela, "pegadas molhadas", "Jardineiro");
+    inserirNaHash(tabela, "charuto queimado", "Marido");
+    inserirNaHash(tabela, "marcador de livro rasgado", "Bibliotecaria");
+    inserirNaHash(tabela, "pegador de panelas sujo", "Cozinheiro");
+    inserirNaHash(tabela, "fio de tecido vermelho", "Marido");
+    inserirNaHash(tabela, "batom no lavatório", "Mulher da festa");
+    inserirNaHash(tabela, "recibo rasgado", "Contador");
+    inserirNaHash(tabela, "sementes pisoteadas", "Jardineiro");
+    // Podemos deixar outras pistas mapeadas para "Desconhecido" por default se necessário.
+
+    // --- forma plana usada durante o jogo ---
+    mansaoDeSalas(mansao, root);
+}
+
+/*
+ * Arquivo de caso (.dqc)
+ * Formato binário versionado com tudo o que um jogo precisa para começar:
+ * pool de textos (com offsets, hashes e a tabela de busca), cadastro de
+ * suspeitos, tabela pista->suspeito, mansão plana e os índices de pistas
+ * densas (ver montarIndicesCaso), com os vetores de pesos e os limiares
+ * (versão 4); só as máscaras por suspeito são montadas na abertura. Só há
+ * offsets e ids, nunca ponteiros, então o arquivo é mapeado somente leitura
+ * e usado no lugar: abrirCaso confere o cabeçalho, os limites das seções e
+ * cada índice guardado nelas (uma passada, sem copiar nada) e aponta as
+ * estruturas para as seções. Uma estrutura mapeada é copiada para a
+ * memória do processo só se for alterada (ex.: "Desconhecido" na hash).
+ * Hashes gravados dependem de hashString: mudar a função exige nova versão.
+ */
+#define CASO_MAGICO "DQCASO\0"
+#define CASO_VERSAO 5
+#define CASO_MARCA_ORDEM 0x01020304u
+
+enum {
+    SECAO_POOL,
+    SECAO_OFFSETS,
+    SECAO_HASHES,
+    SECAO_SLOTS_TEXTOS,
+    SECAO_NOMES_SUSPEITOS,
+    SECAO_CHAVES_SUSPEITOS,
+    SECAO_TABELA,
+    SECAO_SALAS,
+    SECAO_INDICE_PISTAS,
+    SECAO_PISTA_DENSA,
+    SECAO_SUSPEITO_DA_PISTA,
+    SECAO_INICIO_PESOS,     // vazias se o caso não tem pesos
+    SECAO_PESOS,
+    TOTAL_SECOES
+};
+
+typedef struct SecaoCaso {
+    uint64_t offset;
+    uint64_t bytes;
+} SecaoCaso;
+
+typedef struct CabecalhoCaso {
+    char magico[8];
+    uint32_t versao;
+    uint32_t marcaOrdem;            // detecta arquivo de outra arquitetura
+    uint32_t tamanhoSalaPlana;
+    uint32_t tamanhoHashEntry;
+    uint32_t raiz;
+    uint32_t totalSecoes;
+    uint64_t tamanhoTabela;         // entradas ocupadas na tabela pista->suspeito
+    uint64_t tamanhoChavesSuspeitos;
+    int32_t limiarSustentar;
+    int32_t limiarInocentar;
+    SecaoCaso secoes[TOTAL_SECOES];
+} CabecalhoCaso;
+
+static int gravarSecao(FILE *f, CabecalhoCaso *cab, int secao, const void *dados, size_t bytes) {
+    static const char zeros[8] = { 0 };
+    long pos = ftell(f);
+    if (pos < 0) return -1;
+    size_t pad = (size_t) ((8 - (pos % 8)) % 8);
+    if (pad && fwrite(zeros, 1, pad, f) != pad) return -1;
+    cab->secoes[secao].offset = (uint64_t) pos + pad;
+    cab->secoes[secao].bytes = bytes;
+    if (bytes && fwrite(dados, 1, bytes, f) != bytes) return -1;
+    return 0;
+}
+
+/*
+ * gravarCaso: "compila" o caso montado em memória (mansão plana, tabela
+ * pista->suspeito, pesos e limiares das 'regras' e os cadastros globais de
+ * textos e suspeitos) no formato .dqc, junto com os índices de
+ * prepararCaso. Grava num arquivo temporário e renomeia, para nunca deixar
+ * um caso pela metade. Retorna 0 ou -1.
+ */
+int gravarCaso(const char *caminho, const Mansao *mansao, const TabelaHash *tabela, const RegrasEvidencia *regras) {
+    // prepararCaso só lê a tabela; "Desconhecido" já cadastrado evita copiar
+    // os textos mapeados durante o jogo
+    Caso indices;
+    prepararCaso(&indices, mansao, (TabelaHash*) tabela, regras);
+
+    CabecalhoCaso cab;
+    memset(&cab, 0, sizeof(cab));
+    memcpy(cab.magico, CASO_MAGICO, sizeof(cab.magico));
+    cab.versao = CASO_VERSAO;
+    cab.marcaOrdem = CASO_MARCA_ORDEM;
+    cab.tamanhoSalaPlana = sizeof(SalaPlana);
+    cab.tamanhoHashEntry = sizeof(HashEntry);
+    cab.raiz = mansao->raiz;
+    cab.totalSecoes = TOTAL_SECOES;
+    cab.tamanhoTabela = tabela->tamanho;
+    const TabelaHash *chavesSus = g_suspeitos.porChave;
+    cab.tamanhoChavesSuspeitos = chavesSus ? chavesSus->tamanho : 0;
+    cab.limiarSustentar = indices.limiarSustentar;
+    cab.limiarInocentar = indices.limiarInocentar;
+
+    size_t lenTmp = strlen(caminho) + 5;
+    char *tmp = (char*) alocarMemoria(lenTmp, "malloc gravarCaso");
+    snprintf(tmp, lenTmp, "%s.tmp", caminho);
+    FILE *f = fopen(tmp, "wb");
+    int rc = -1;
+    if (f &&
+        fwrite(&cab, sizeof(cab), 1, f) == 1 &&
+        gravarSecao(f, &cab, SECAO_POOL, g_textos.pool, g_textos.poolUsado) == 0 &&
+        gravarSecao(f, &cab, SECAO_OFFSETS, g_textos.offsets, g_textos.total * sizeof(uint32_t)) == 0 &&
+        gravarSecao(f, &cab, SECAO_HASHES, g_textos.hashes, g_textos.total * sizeof(uint64_t)) == 0 &&
+        gravarSecao(f, &cab, SECAO_SLOTS_TEXTOS, g_textos.slots, g_textos.capSlots * sizeof(TextoId)) == 0 &&
+        gravarSecao(f, &cab, SECAO_NOMES_SUSPEITOS, g_suspeitos.nomes, g_suspeitos.total * sizeof(TextoId)) == 0 &&
+        gravarSecao(f, &cab, SECAO_CHAVES_SUSPEITOS, chavesSus ? chavesSus->entradas : NULL,
+                    chavesSus ? chavesSus->capacidade * sizeof(HashEntry) : 0) == 0 &&
+        gravarSecao(f, &cab, SECAO_TABELA, tabela->entradas, tabela->capacidade * sizeof(HashEntry)) == 0 &&
+        gravarSecao(f, &cab, SECAO_SALAS, mansao->salas, (size_t) mansao->total * sizeof(SalaPlana)) == 0 &&
+        gravarSecao(f, &cab, SECAO_INDICE_PISTAS, indices.indicePistas, (size_t) indices.totalPistas * sizeof(TextoId)) == 0 &&
+        gravarSecao(f, &cab, SECAO_PISTA_DENSA, indices.densaDaPista, (size_t) indices.totalDensaDaPista * sizeof(uint32_t)) == 0 &&
+        gravarSecao(f, &cab, SECAO_SUSPEITO_DA_PISTA, indices.suspeitoDaPista, (size_t) indices.totalPistas * sizeof(SuspeitoId)) == 0 &&
+        gravarSecao(f, &cab, SECAO_INICIO_PESOS, indices.inicioPesos,
+                    indices.inicioPesos ? ((size_t) indices.totalPistas + 1) * sizeof(uint32_t) : 0) == 0 &&
+        gravarSecao(f, &cab, SECAO_PESOS, indices.pesos, (size_t) indices.totalPesos * sizeof(PesoEvidencia)) == 0 &&
+        fseek(f, 0, SEEK_SET) == 0 &&
+        fwrite(&cab, sizeof(cab), 1, f) == 1) {
+        rc = 0;
+    }
+    if (f && fclose(f) != 0) rc = -1;
+    if (rc == 0 && rename(tmp, caminho) != 0) rc = -1;
+    if (rc != 0) {
+        perror(caminho);
+        remove(tmp);
+    }
+    free(tmp);
+    liberarIndicesCaso(&indices);
+    return rc;
+}
+
+// potência de 2 (ou zero) - exigido das capacidades das tabelas mapeadas
+static int potenciaDeDois(uint64_t v) {
+    return (v & (v - 1)) == 0;
+}
+
+// tabela hash mapeada: chaves são textos, valores são suspeitos e sobra ao menos uma posição vazia
+static int tabelaMapeadaValida(const HashEntry *e, uint64_t cap, uint64_t totalTextos, uint64_t totalSuspeitos) {
+    uint64_t ocupadas = 0;
+    for (uint64_t i = 0; i < cap; i++) {
+        if (e[i].hash == 0) continue;
+        if (e[i].chave >= totalTextos || e[i].valor >= totalSuspeitos) return 0;
+        ocupadas++;
+    }
+    return ocupadas < cap;
+}
+
+/*
+ * dadosDoCasoValidos: confere os índices guardados nas seções (já dentro do
+ * arquivo): offsets dentro do pool, textos, suspeitos, salas e pistas
+ * densas que existem, entrada da mansão entre as salas. Sem isso um arquivo
+ * adulterado faz o jogo ler e escrever fora dos vetores.
+ */
+static int dadosDoCasoValidos(const unsigned char *base, const CabecalhoCaso *cab) {
+    const SecaoCaso *sec = cab->secoes;
+    uint64_t totalTextos = sec[SECAO_OFFSETS].bytes / sizeof(uint32_t);
+    uint64_t totalSuspeitos = sec[SECAO_NOMES_SUSPEITOS].bytes / sizeof(TextoId);
+    uint64_t totalSalas = sec[SECAO_SALAS].bytes / sizeof(SalaPlana);
+    uint64_t totalPistas = sec[SECAO_INDICE_PISTAS].bytes / sizeof(TextoId);
+
+    const uint32_t *offsets = (const uint32_t*) (base + sec[SECAO_OFFSETS].offset);
+    for (uint64_t i = 0; i < totalTextos; i++)
+        if (offsets[i] >= sec[SECAO_POOL].bytes) return 0; // o pool termina em '\0'
+    const TextoId *slots = (const TextoId*) (base + sec[SECAO_SLOTS_TEXTOS].offset);
+    for (uint64_t i = 0; i < sec[SECAO_SLOTS_TEXTOS].bytes / sizeof(TextoId); i++)
+        if (slots[i] != TEXTO_NENHUM && slots[i] >= totalTextos) return 0;
+    const TextoId *nomes = (const TextoId*) (base + sec[SECAO_NOMES_SUSPEITOS].offset);
+    for (uint64_t i = 0; i < totalSuspeitos; i++)
+        if (nomes[i] >= totalTextos) return 0;
+    if (!tabelaMapeadaValida((const HashEntry*) (base + sec[SECAO_TABELA].offset),
+                             sec[SECAO_TABELA].bytes / sizeof(HashEntry), totalTextos, totalSuspeitos) ||
+        (sec[SECAO_CHAVES_SUSPEITOS].bytes > 0 &&
+         !tabelaMapeadaValida((const HashEntry*) (base + sec[SECAO_CHAVES_SUSPEITOS].offset),
+                              sec[SECAO_CHAVES_SUSPEITOS].bytes / sizeof(HashEntry), totalTextos, totalSuspeitos)))
+        return 0;
+
+    if (cab->raiz >= totalSalas) return 0;
+    const SalaPlana *salas = (const SalaPlana*) (base + sec[SECAO_SALAS].offset);
+    for (uint64_t i = 0; i < totalSalas; i++) {
+        const SalaPlana *sala = &salas[i];
+        if ((sala->esq != SALA_NENHUMA && sala->esq >= totalSalas) || (sala->dir != SALA_NENHUMA && sala->dir >= totalSalas) ||
+            (sala->nome != TEXTO_NENHUM && sala->nome >= totalTextos) || (sala->pista != TEXTO_NENHUM && sala->pista >= totalTextos))
+            return 0;
+    }
+
+    const TextoId *indice = (const TextoId*) (base + sec[SECAO_INDICE_PISTAS].offset);
+    for (uint64_t d = 0; d < totalPistas; d++)
+        if (indice[d] >= totalTextos) return 0;
+    const uint32_t *densa = (const uint32_t*) (base + sec[SECAO_PISTA_DENSA].offset);
+    for (uint64_t i = 0; i < sec[SECAO_PISTA_DENSA].bytes / sizeof(uint32_t); i++)
+        if (densa[i] != PISTA_NENHUMA && densa[i] >= totalPistas) return 0;
+    return 1;
+}
+
+/*
+ * abrirCaso: mapeia um arquivo .dqc e aponta para ele a mansão, a tabela
+ * pista->suspeito, o índice de pistas e os cadastros globais de textos e
+ * suspeitos (que precisam estar vazios). Não copia os dados; confere o
+ * cabeçalho, as seções e os índices dentro delas (dadosDoCasoValidos).
+ * Retorna 0 ou -1 (com mensagem em stderr).
+ */
+int abrirCaso(const char *caminho, Caso *caso) {
+    memset(caso, 0, sizeof(*caso));
+    if (g_textos.total != 0 || g_suspeitos.total != 0) {
+        fprintf(stderr, "%s: cadastros de textos/suspeitos precisam estar vazios\n", caminho);
+        return -1;
+    }
+    int fd = open(caminho, O_RDONLY);
+    if (fd < 0) { perror(caminho); return -1; }
+    struct stat st;
+    if (fstat(fd, &st) != 0) { perror(caminho); close(fd); return -1; }
+    size_t tam = (size_t) st.st_size;
+    if (tam < sizeof(CabecalhoCaso)) {
+        fprintf(stderr, "%s: arquivo de caso truncado\n", caminho);
+        close(fd);
+        return -1;
+    }
+    void *mapa = mmap(NULL, tam, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapa == MAP_FAILED) { perror(caminho); return -1; }
+
+    const unsigned char *base = (const unsigned char*) mapa;
+    const CabecalhoCaso *cab = (const CabecalhoCaso*) mapa;
+    const char *problema = NULL;
+    if (memcmp(cab->magico, CASO_MAGICO, sizeof(cab->magico)) != 0) problema = "nao e um arquivo de caso";
+    else if (cab->versao != CASO_VERSAO) problema = "versao de caso nao suportada";
+    else if (cab->marcaOrdem != CASO_MARCA_ORDEM || cab->tamanhoSalaPlana != sizeof(SalaPlana) ||
+             cab->tamanhoHashEntry != sizeof(HashEntry) || cab->totalSecoes != TOTAL_SECOES)
+        problema = "caso gravado para outra arquitetura";
+    for (int i = 0; !problema && i < TOTAL_SECOES; i++) {
+        const SecaoCaso *sec = &cab->secoes[i];
+        if (sec->offset % 8 != 0 || sec->offset > tam || sec->bytes > tam - sec->offset)
+            problema = "secao fora do arquivo";
+    }
+    const SecaoCaso *sec = cab->secoes;
+    uint64_t totalTextos = problema ? 0 : sec[SECAO_OFFSETS].bytes / sizeof(uint32_t);
+    uint64_t capSlots = problema ? 0 : sec[SECAO_SLOTS_TEXTOS].bytes / sizeof(TextoId);
+    uint64_t capTabela = problema ? 0 : sec[SECAO_TABELA].bytes / sizeof(HashEntry);
+    uint64_t capChavesSus = problema ? 0 : sec[SECAO_CHAVES_SUSPEITOS].bytes / sizeof(HashEntry);
+    if (!problema && (sec[SECAO_HASHES].bytes != totalTextos * sizeof(uint64_t) ||
+                      !potenciaDeDois(capSlots) || !potenciaDeDois(capTabela) || capTabela == 0 ||
+                      !potenciaDeDois(capChavesSus) || totalTextos >= capSlots ||
+                      sec[SECAO_PISTA_DENSA].bytes > totalTextos * sizeof(uint32_t) ||
+                      sec[SECAO_SUSPEITO_DA_PISTA].bytes / sizeof(SuspeitoId) != sec[SECAO_INDICE_PISTAS].bytes / sizeof(TextoId) ||
+                      (sec[SECAO_INICIO_PESOS].bytes != 0 &&
+                       sec[SECAO_INICIO_PESOS].bytes / sizeof(uint32_t) != sec[SECAO_INDICE_PISTAS].bytes / sizeof(TextoId) + 1) ||
+                      sec[SECAO_PESOS].bytes % sizeof(PesoEvidencia) != 0 || cab->limiarInocentar >= cab->limiarSustentar ||
+                      (sec[SECAO_POOL].bytes > 0 && base[sec[SECAO_POOL].offset + sec[SECAO_POOL].bytes - 1] != '\0') ||
+                      !dadosDoCasoValidos(base, cab)))
+        problema = "secoes inconsistentes";
+    if (problema) {
+        fprintf(stderr, "%s: %s\n", caminho, problema);
+        munmap(mapa, tam);
+        return -1;
+    }
+
+    g_textos.pool = (char*) (base + sec[SECAO_POOL].offset);
+    g_textos.poolUsado = g_textos.poolCap = sec[SECAO_POOL].bytes;
+    g_textos.offsets = (uint32_t*) (base + sec[SECAO_OFFSETS].offset);
+    g_textos.hashes = (uint64_t*) (base + sec[SECAO_HASHES].offset);
+    g_textos.total = g_textos.capIds = (uint32_t) totalTextos;
+    g_textos.slots = (TextoId*) (base + sec[SECAO_SLOTS_TEXTOS].offset);
+    g_textos.capSlots = capSlots;
+    g_textos.mapeado = 1;
+
+    g_suspeitos.nomes = (TextoId*) (base + sec[SECAO_NOMES_SUSPEITOS].offset);
+    g_suspeitos.total = g_suspeitos.cap = (uint32_t) (sec[SECAO_NOMES_SUSPEITOS].bytes / sizeof(TextoId));
+    g_suspeitos.mapeado = 1;
+    if (capChavesSus > 0) {
+        TabelaHash *t = (TabelaHash*) alocarZerada(1, sizeof(TabelaHash), "calloc abrirCaso");
+        t->entradas = (HashEntry*) (base + sec[SECAO_CHAVES_SUSPEITOS].offset);
+        t->capacidade = capChavesSus;
+        t->tamanho = cab->tamanhoChavesSuspeitos;
+        t->mapeada = 1;
+        g_suspeitos.porChave = t;
+    }
+
+    caso->tabela = (TabelaHash*) alocarZerada(1, sizeof(TabelaHash), "calloc abrirCaso");
+    caso->tabela->entradas = (HashEntry*) (base + sec[SECAO_TABELA].offset);
+    caso->tabela->capacidade = capTabela;
+    caso->tabela->tamanho = cab->tamanhoTabela;
+    caso->tabela->mapeada = 1;
+
+    caso->mansao.salas = (SalaPlana*) (base + sec[SECAO_SALAS].offset);
+    caso->mansao.total = caso->mansao.cap = (uint32_t) (sec[SECAO_SALAS].bytes / sizeof(SalaPlana));
+    caso->mansao.raiz = cab->raiz;
+    caso->mansao.mapeada = 1;
+    caso->desconhecido = cadastrarSuspeito("Desconhecido"); // gravado pelo gravarCaso
+
+    caso->indicePistas = (const TextoId*) (base + sec[SECAO_INDICE_PISTAS].offset);
+    caso->totalPistas = (uint32_t) (sec[SECAO_INDICE_PISTAS].bytes / sizeof(TextoId));
+    caso->densaDaPista = (const uint32_t*) (base + sec[SECAO_PISTA_DENSA].offset);
+    caso->totalDensaDaPista = (uint32_t) (sec[SECAO_PISTA_DENSA].bytes / sizeof(uint32_t));
+    caso->suspeitoDaPista = (const SuspeitoId*) (base + sec[SECAO_SUSPEITO_DA_PISTA].offset);
+    if (sec[SECAO_INICIO_PESOS].bytes) {
+        caso->inicioPesos = (const uint32_t*) (base + sec[SECAO_INICIO_PESOS].offset);
+        caso->pesos = (const PesoEvidencia*) (base + sec[SECAO_PESOS].offset);
+        caso->totalPesos = (uint32_t) (sec[SECAO_PESOS].bytes / sizeof(PesoEvidencia));
+    }
+    caso->limiarSustentar = cab->limiarSustentar;
+    caso->limiarInocentar = cab->limiarInocentar;
+    caso->mapa = mapa;
+    caso->tamanhoMapa = tam;
+    for (uint32_t d = 0; d < caso->totalPistas; d++) {
+        if (caso->suspeitoDaPista[d] >= g_suspeitos.total) {
+            fprintf(stderr, "%s: pista aponta para suspeito inexistente\n", caminho);
+            fecharCaso(caso);
+            return -1;
+        }
+    }
+    // vetores de pesos: inícios crescentes dentro da seção e suspeitos cadastrados
+    for (uint32_t d = 0; caso->inicioPesos && d <= caso->totalPistas; d++) {
+        uint32_t ini = caso->inicioPesos[d];
+        if ((d == 0 && ini != 0) || (d > 0 && ini < caso->inicioPesos[d - 1]) || ini > caso->totalPesos ||
+            (d == caso->totalPistas && ini != caso->totalPesos)) {
+            fprintf(stderr, "%s: pesos de evidencia inconsistentes\n", caminho);
+            fecharCaso(caso);
+            return -1;
+        }
+    }
+    for (uint32_t k = 0; caso->inicioPesos && k < caso->totalPesos; k++) {
+        if (caso->pesos[k].suspeito >= g_suspeitos.total) {
+            fprintf(stderr, "%s: pista aponta para suspeito inexistente\n", caminho);
+            fecharCaso(caso);
+            return -1;
+        }
+    }
+    montarMascaras(caso);
+    montarCaminhos(caso);
+    calcularImpressao(caso);
+    return 0;
+}
+
+/*
+ * buscarPistaNoCaso: posição da pista no índice ordenado do caso (busca
+ * binária) ou -1 se o caso não conhece a pista.
+ */
+long buscarPistaNoCaso(const Caso *caso, const char *pista) {
+    long ini = 0, fim = (long) caso->totalPistas - 1;
+    while (ini <= fim) {
+        long meio = ini + (fim - ini) / 2;
+        int cmp = strcmp(pista, textoDe(caso->indicePistas[meio]));
+        if (cmp == 0) return meio;
+        if (cmp < 0) fim = meio - 1;
+        else ini = meio + 1;
+    }
+    return -1;
+}
+
+/*
+ * fecharCaso: libera a mansão, a tabela do caso e os cadastros globais de
+ * textos e suspeitos e, se o caso veio de um .dqc, desfaz o mapeamento.
+ */
+void fecharCaso(Caso *caso) {
+    liberarIndicesCaso(caso);
+    if (caso->tabela) liberarTabelaHash(caso->tabela);
+    liberarMansao(&caso->mansao);
+    liberarSuspeitos();
+    liberarTextos();
+    if (caso->mapa) munmap(caso->mapa, caso->tamanhoMapa);
+    memset(caso, 0, sizeof(*caso));
+}
+
+/*
+ * Sessão salva
+ * A fotografia (.dqs) guarda o estado de uma sessão: sala atual, passos e
+ * pistas coletadas como ids densos do caso, em bitset ou em lista ordenada
+ * (o que for menor). O placar não é gravado: é refeito das pistas, inclusive
+ * as que contam para "Desconhecido" (pistas fora da tabela não alteram o
+ * caso, então não há entradas da hash a salvar). A impressão do caso no
+ * cabeçalho impede restaurar sobre outro caso.
+ * O diário (.dqj) é só de acréscimo: um byte por comando (aplicarPasso), de
+ * modo que uma queda perde no máximo o passo em andamento. O cabeçalho do
+ * diário guarda os passos da fotografia em que ele começa; compactarSessao
+ * grava uma fotografia nova e só então recomeça o diário, e um diário que não
+ * casa com a fotografia (queda entre as duas coisas) já está contido nela.
+ */
+#define SESSAO_MAGICO "DQSESS\0"
+#define DIARIO_MAGICO "DQDIAR\0"
+#define SESSAO_VERSAO 2            // 2: a impressão inclui a numeração das salas
+
+enum { SESSAO_BITSET, SESSAO_LISTA };
+
+typedef struct CabecalhoSessao {
+    char magico[8];
+    uint32_t versao;
+    uint32_t marcaOrdem;
+    uint64_t impressao;         // Caso.impressao
+    uint64_t passos;
+    uint32_t cursor;
+    uint32_t totalPistas;       // do caso: tamanho do bitset
+    uint32_t coletadas;
+    uint32_t formato;           // SESSAO_BITSET ou SESSAO_LISTA
+    uint64_t verificacao;       // hashBytes do conteúdo
+} CabecalhoSessao;
+
+typedef struct CabecalhoDiario {
+    char magico[8];
+    uint32_t versao;
+    uint32_t marcaOrdem;
+    uint64_t impressao;
+    uint64_t passosBase;        // passos da fotografia em que o diário começa
+} CabecalhoDiario;
+
+// ids densos das pistas do caderno, em ordem crescente; devolve quantos
+static uint32_t pistasDensasDaSessao(const Sessao *s, const Caso *caso, uint32_t *saida) {
+    uint32_t n = 0;
+    if (s->modo == CADERNO_BITS) {
+        for (uint32_t w = 0; w < caso->palavras; w++)
+            for (uint64_t b = s->bits[w]; b; b &= b - 1)
+                saida[n++] = w * 64 + (uint32_t) __builtin_ctzll(b);
+        return n;
+    }
+    CursorArvore c;
+    abrirCursorPistas(&c, s->caderno, ORDEM_EM);
+    for (PistaNode *no; (no = proximaPista(&c)) != NULL;) {
+        uint32_t d = pistaDensa(caso, no->pista);
+        if (d < caso->totalPistas) saida[n++] = d;
+    }
+    fecharCursor(&c);
+    return n;
+}
+
+/*
+ * gravarSessao: grava a fotografia da sessão em 'caminho' (arquivo
+ * temporário e rename, como gravarCaso). Retorna 0 ou -1.
+ */
+int gravarSessao(const char *caminho, const Sessao *s, const Caso *caso) {
+    uint32_t coletadas = (uint32_t) pistasColetadas(s);
+    size_t bytesBitset = (size_t) caso->palavras * sizeof(uint64_t);
+    size_t bytesLista = (size_t) coletadas * sizeof(uint32_t);
+    int formato = bytesLista < bytesBitset ? SESSAO_LISTA : SESSAO_BITSET;
+    size_t bytes = formato == SESSAO_LISTA ? bytesLista : bytesBitset;
+
+    CabecalhoSessao cab;
+    memset(&cab, 0, sizeof(cab));
+    unsigned char *buf = (unsigned char*) alocarMemoria(sizeof(cab) + bytes + sizeof(uint64_t), "malloc gravarSessao");
+    unsigned char *dados = buf + sizeof(cab);
+    if (formato == SESSAO_BITSET && s->modo == CADERNO_BITS) {
+        memcpy(dados, s->bits, bytes);
+    } else {
+        uint32_t *ids = (uint32_t*) alocarMemoria(bytesLista + sizeof(uint32_t), "malloc gravarSessao");
+        coletadas = pistasDensasDaSessao(s, caso, ids);
+        if (formato == SESSAO_LISTA) {
+            bytes = (size_t) coletadas * sizeof(uint32_t);
+            memcpy(dados, ids, bytes);
+        } else {
+            uint64_t *bits = (uint64_t*) dados;
+            memset(bits, 0, bytes);
+            for (uint32_t k = 0; k < coletadas; k++) bits[ids[k] >> 6] |= 1ull << (ids[k] & 63);
+        }
+        free(ids);
+    }
+
+    memcpy(cab.magico, SESSAO_MAGICO, sizeof(cab.magico));
+    cab.versao = SESSAO_VERSAO;
+    cab.marcaOrdem = CASO_MARCA_ORDEM;
+    cab.impressao = caso->impressao;
+    cab.passos = s->passos;
+    cab.cursor = s->cursor;
+    cab.totalPistas = caso->totalPistas;
+    cab.coletadas = coletadas;
+    cab.formato = (uint32_t) formato;
+    cab.verificacao = hashBytes(dados, bytes);
+    memcpy(buf, &cab, sizeof(cab));
+
+    size_t lenTmp = strlen(caminho) + 5;
+    char *tmp = (char*) alocarMemoria(lenTmp, "malloc gravarSessao");
+    snprintf(tmp, lenTmp, "%s.tmp", caminho);
+    FILE *f = fopen(tmp, "wb");
+    int rc = f && fwrite(buf, 1, sizeof(cab) + bytes, f) == sizeof(cab) + bytes ? 0 : -1;
+    if (f && fclose(f) != 0) rc = -1;
+    if (rc == 0 && rename(tmp, caminho) != 0) rc = -1;
+    if (rc != 0) {
+        perror(caminho);
+        remove(tmp);
+    }
+    free(tmp);
+    free(buf);
+    return rc;
+}
+
+// lê o arquivo inteiro (NULL com errno se não der); *tam recebe o tamanho
+static unsigned char* lerArquivoInteiro(const char *caminho, size_t *tam) {
+    FILE *f = fopen(caminho, "rb");
+    if (!f) return NULL;
+    unsigned char *buf = NULL;
+    size_t usado = 0, cap = 0, lido;
+    do {
+        if (usado == cap) {
+            cap = cap ? cap * 2 : 4096;
+            buf = (unsigned char*) realocarMemoria(buf, cap, "realloc lerArquivoInteiro");
+        }
+        lido = fread(buf + usado, 1, cap - usado, f);
+        usado += lido;
+    } while (lido > 0);
+    int erro = ferror(f);
+    fclose(f);
+    if (erro) { free(buf); errno = EIO; return NULL; }
+    *tam = usado;
+    return buf;
+}
+
+/*
+ * restaurarSessao: volta a sessão (já iniciada, em qualquer modo de caderno)
+ * ao estado da fotografia. No modo AVL o caderno é montado já balanceado a
+ * partir dos ids ordenados, sem inserções. Retorna 0 ou -1 (com mensagem em
+ * stderr; errno == ENOENT se o arquivo não existe).
+ */
+int restaurarSessao(const char *caminho, Sessao *s, const Caso *caso) {
+    size_t tam;
+    unsigned char *buf = lerArquivoInteiro(caminho, &tam);
+    if (!buf) {
+        if (errno != ENOENT) perror(caminho);
+        return -1;
+    }
+    CabecalhoSessao cab;
+    const char *problema = NULL;
+    if (tam < sizeof(cab)) {
+        problema = "fotografia de sessao truncada";
+    } else {
+        memcpy(&cab, buf, sizeof(cab));
+        size_t bytes = tam - sizeof(cab);
+        if (memcmp(cab.magico, SESSAO_MAGICO, sizeof(cab.magico)) != 0) problema = "nao e uma sessao salva";
+        else if (cab.versao != SESSAO_VERSAO || cab.marcaOrdem != CASO_MARCA_ORDEM) problema = "versao de sessao nao suportada";
+        else if (cab.impressao != caso->impressao || cab.totalPistas != caso->totalPistas) problema = "sessao salva de outro caso";
+        else if (cab.cursor >= caso->mansao.total) problema = "sala atual fora da mansao";
+        else if (cab.formato == SESSAO_BITSET ? bytes != (size_t) caso->palavras * sizeof(uint64_t)
+                                                : cab.formato != SESSAO_LISTA || bytes != (size_t) cab.coletadas * sizeof(uint32_t))
+            problema = "sessao salva truncada";
+        else if (hashBytes(buf + sizeof(cab), bytes) != cab.verificacao) problema = "sessao salva corrompida";
+    }
+    if (problema) {
+        fprintf(stderr, "%s: %s\n", caminho, problema);
+        free(buf);
+        errno = EINVAL;
+        return -1;
+    }
+
+    reiniciarSessao(s, caso);
+    s->cursor = cab.cursor;
+    s->passos = (unsigned long) cab.passos;
+    if (cab.formato == SESSAO_BITSET && s->modo == CADERNO_BITS && caso->mascaras) {
+        // bitset direto no caderno; placar por popcount com as máscaras (com
+        // pesos, pelos vetores das pistas coletadas)
+        memcpy(s->bits, buf + sizeof(cab), (size_t) caso->palavras * sizeof(uint64_t));
+        if (caso->palavras > 0) s->bits[caso->palavras - 1] &= ~0ull >> ((64 - caso->totalPistas % 64) % 64);
+        for (uint32_t w = 0; w < caso->palavras; w++) s->coletadas += (uint32_t) __builtin_popcountll(s->bits[w]);
+        for (uint32_t w = 0; caso->inicioPesos && w < caso->palavras; w++)
+            for (uint64_t b = s->bits[w]; b; b &= b - 1) pontuarPista(&s->placar, caso, w * 64 + (uint32_t) __builtin_ctzll(b), +1);
+        for (SuspeitoId sus = 0; !caso->inicioPesos && sus < caso->totalMascaras; sus++) {
+            int c = contagemPorMascara(s, caso, sus);
+            if (c) placarSomar(&s->placar, sus, c);
+        }
+        free(buf);
+        return 0;
+    }
+
+    // ids densos em ordem crescente
+    uint32_t *ids;
+    uint32_t n = 0;
+    if (cab.formato == SESSAO_LISTA) {
+        ids = (uint32_t*) (buf + sizeof(cab));
+        n = cab.coletadas;
+        for (uint32_t k = 0; k < n; k++) {
+            if (ids[k] >= caso->totalPistas || (k > 0 && ids[k] <= ids[k - 1])) {
+                fprintf(stderr, "%s: sessao salva corrompida\n", caminho);
+                free(buf);
+                reiniciarSessao(s, caso);
+                errno = EINVAL;
+                return -1;
+            }
+        }
+    } else {
+        const uint64_t *bits = (const uint64_t*) (buf + sizeof(cab));
+        ids = (uint32_t*) alocarMemoria((size_t) caso->totalPistas * sizeof(uint32_t) + 1, "malloc restaurarSessao");
+        for (uint32_t w = 0; w < caso->palavras; w++)
+            for (uint64_t b = bits[w]; b; b &= b - 1) {
+                uint32_t d = w * 64 + (uint32_t) __builtin_ctzll(b);
+                if (d < caso->totalPistas) ids[n++] = d;
+            }
+    }
+
+    if (s->modo == CADERNO_BITS) {
+        for (uint32_t k = 0; k < n; k++) s->bits[ids[k] >> 6] |= 1ull << (ids[k] & 63);
+        s->coletadas = n;
+    } else if (n > 0) {
+        PistaNode *nos = (PistaNode*) arenaAlocar(s->arena, (size_t) n * sizeof(PistaNode));
+        for (uint32_t k = 0; k < n; k++) nos[k].pista = caso->indicePistas[ids[k]];
+        s->caderno = montarIndiceBalanceado(nos, n);
+    }
+    for (uint32_t k = 0; k < n; k++) pontuarPista(&s->placar, caso, ids[k], +1);
+    if (cab.formato != SESSAO_LISTA) free(ids);
+    free(buf);
+    return 0;
+}
+
+/*
+ * abrirDiario: (re)começa o diário em 'caminho' a partir do estado atual da
+ * sessão e o liga a ela; os próximos aplicarPasso são acrescentados.
+ * Retorna 0 ou -1.
+ */
+int abrirDiario(const char *caminho, Sessao *s, const Caso *caso) {
+    if (s->diario >= 0) close(s->diario);
+    s->diario = -1;
+    int fd = open(caminho, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) { perror(caminho); return -1; }
+    CabecalhoDiario cab;
+    memset(&cab, 0, sizeof(cab));
+    memcpy(cab.magico, DIARIO_MAGICO, sizeof(cab.magico));
+    cab.versao = SESSAO_VERSAO;
+    cab.marcaOrdem = CASO_MARCA_ORDEM;
+    cab.impressao = caso->impressao;
+    cab.passosBase = s->passos;
+    if (write(fd, &cab, sizeof(cab)) != (ssize_t) sizeof(cab)) {
+        perror(caminho);
+        close(fd);
+        return -1;
+    }
+    s->diario = fd;
+    return 0;
+}
+
+/*
+ * reproduzirDiario: reaplica à sessão os comandos do diário, se ele começa
+ * exatamente no estado atual dela. Retorna os passos reaplicados (0 se o
+ * diário não existe ou não casa) ou -1 se ele é de outro caso.
+ */
+long reproduzirDiario(const char *caminho, Sessao *s, const Caso *caso) {
+    size_t tam;
+    unsigned char *buf = lerArquivoInteiro(caminho, &tam);
+    if (!buf) {
+        if (errno != ENOENT) perror(caminho);
+        return 0;
+    }
+    CabecalhoDiario cab;
+    long passos = 0;
+    if (tam >= sizeof(cab)) memcpy(&cab, buf, sizeof(cab));
+    if (tam < sizeof(cab) || memcmp(cab.magico, DIARIO_MAGICO, sizeof(cab.magico)) != 0 ||
+        cab.versao != SESSAO_VERSAO || cab.marcaOrdem != CASO_MARCA_ORDEM) {
+        fprintf(stderr, "%s: diario de sessao invalido (ignorado)\n", caminho);
+    } else if (cab.impressao != caso->impressao) {
+        fprintf(stderr, "%s: diario de outro caso\n", caminho);
+        passos = -1;
+    } else if (cab.passosBase == s->passos) {
+        int diario = s->diario;
+        s->diario = -1;
+        coletarPistaDaSala(s, caso);
+        for (size_t i = sizeof(cab); i < tam; i++, passos++) {
+            ResultadoComando r = aplicarPasso(s, caso, (char) buf[i]);
+            if (r == COMANDO_MOVEU || r == COMANDO_INICIO) coletarPistaDaSala(s, caso);
+        }
+        s->diario = diario;
+    }
+    free(buf);
+    return passos;
+}
+
+// caminhos da fotografia e do diário de uma sessão salva com nome 'base'
+static void caminhosDaSessao(const char *base, char **fotografia, char **diario) {
+    size_t len = strlen(base) + 5;
+    *fotografia = (char*) alocarMemoria(len, "malloc caminhosDaSessao");
+    *diario = (char*) alocarMemoria(len, "malloc caminhosDaSessao");
+    snprintf(*fotografia, len, "%s.dqs", base);
+    snprintf(*diario, len, "%s.dqj", base);
+}
+
+/*
+ * compactarSessao: grava a fotografia de 'base' e recomeça o diário a partir
+ * dela. Retorna 0 ou -1.
+ */
+int compactarSessao(const char *base, Sessao *s, const Caso *caso) {
+    char *fotografia, *diario;
+    caminhosDaSessao(base, &fotografia, &diario);
+    int rc = gravarSessao(fotografia, s, caso);
+    if (rc == 0) rc = abrirDiario(diario, s, caso);
+    free(fotografia);
+    free(diario);
+    return rc;
+}
+
+/*
+ * retomarSessao: restaura a fotografia de 'base' (se existir), reaplica o
+ * diário e compacta. Sem sessão salva, começa uma nova. Retorna 0 ou -1.
+ */
+int retomarSessao(const char *base, Sessao *s, const Caso *caso) {
+    char *fotografia, *diario;
+    caminhosDaSessao(base, &fotografia, &diario);
+    int rc = 0;
+    if (restaurarSessao(fotografia, s, caso) != 0 && errno != ENOENT) rc = -1;
+    if (rc == 0 && reproduzirDiario(diario, s, caso) < 0) rc = -1;
+    free(fotografia);
+    free(diario);
+    return rc == 0 ? compactarSessao(base, s, caso) : -1;
+}
+
+// fecha o diário e apaga a sessão salva (caso encerrado)
+void descartarSessao(const char *base, Sessao *s) {
+    char *fotografia, *diario;
+    caminhosDaSessao(base, &fotografia, &diario);
+    if (s->diario >= 0) close(s->diario);
+    s->diario = -1;
+    unlink(fotografia);
+    unlink(diario);
+    free(fotografia);
+    free(diario);
+}
+
+#ifdef DQ_BENCH
+/* -------------------------
+   Benchmarks (compilar com -DDQ_BENCH)
+   ------------------------- */
+
+#include <sys/wait.h>
+
+// descarta suspeitos e textos entre um benchmark e outro
+static void reiniciarTextos(void) {
+    liberarSuspeitos();
+    liberarTextos();
+}
+
+// xorshift64: gerador determinístico para embaralhar as cargas de teste
+static unsigned long long proximoAleatorio(unsigned long long *estado) {
+    unsigned long long x = *estado;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *estado = x;
+}
+
+/*
+ * benchInsercaoPistas: insere n pistas distintas na AVL em ordem crescente
+ * (como chegam os pacotes de caso gerados) e em ordem aleatória, medindo o
+ * tempo de inserção, a altura final e o percurso em ordem.
+ */
+static void benchInsercaoPistas(int n) {
+    TextoId *chaves = (TextoId*) malloc((size_t) n * sizeof(TextoId));
+    if (!chaves) { perror("malloc benchInsercaoPistas"); exit(EXIT_FAILURE); }
+    for (int i = 0; i < n; i++) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "pista %08d", i);
+        chaves[i] = internar(buf);
+    }
+
+    for (int modo = 0; modo < 2; modo++) {
+        if (modo == 1) {
+            unsigned long long estado = 0x9E3779B97F4A7C15ULL;
+            for (int i = n - 1; i > 0; i--) {
+                int j = (int) (proximoAleatorio(&estado) % (unsigned long long) (i + 1));
+                TextoId t = chaves[i]; chaves[i] = chaves[j]; chaves[j] = t;
+            }
+        }
+        Arena *arena = criarArena(0);
+        PistaNode *raiz = NULL;
+        int inseriu;
+        double t0 = agoraSegundos();
+        for (int i = 0; i < n; i++)
+            raiz = inserirPistaIterativa(arena, raiz, chaves[i], &inseriu);
+        double t1 = agoraSegundos();
+        int total = contarPistas(raiz);
+        double t2 = agoraSegundos();
+        printf("%-10s n=%d  insercao=%.3fs (%.0f ns/op)  altura=%d  percurso=%.3fs  contadas=%d\n",
+               modo == 0 ? "ordenada" : "aleatoria", n, t1 - t0, (t1 - t0) * 1e9 / n,
+               alturaPista(raiz), t2 - t1, total);
+        liberarArena(arena);
+    }
+
+    free(chaves);
+    reiniciarTextos();
+}
+
+/*
+ * benchTabelaHash: n associações pista -> suspeito inseridas a partir da
+ * capacidade mínima (forçando os redimensionamentos), seguidas de n buscas
+ * com sucesso e n sem sucesso.
+ */
+static void benchTabelaHash(int n) {
+    static const char *suspeitos[] = { "Jardineiro", "Marido", "Bibliotecaria", "Cozinheiro", "Contador" };
+    char buf[32];
+    TabelaHash *tab = criarTabelaHash(0);
+
+    double t0 = agoraSegundos();
+    for (int i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf), "pista %d", i);
+        inserirNaHash(tab, buf, suspeitos[i % 5]);
+    }
+    double t1 = agoraSegundos();
+    int achados = 0;
+    for (int i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf), "pista %d", i);
+        if (encontrarSuspeito(tab, buf)) achados++;
+    }
+    double t2 = agoraSegundos();
+    for (int i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf), "ausente %d", i);
+        if (encontrarSuspeito(tab, buf)) achados++;
+    }
+    double t3 = agoraSegundos();
+
+    size_t distMax = 0;
+    for (size_t i = 0; i < tab->capacidade; i++) {
+        if (!tab->entradas[i].hash) continue;
+        size_t d = distanciaHash(tab, &tab->entradas[i], i);
+        if (d > distMax) distMax = d;
+    }
+    printf("n=%d  capacidade=%zu  carga=%.2f  distMax=%zu\n", n, tab->capacidade,
+           (double) tab->tamanho / (double) tab->capacidade, distMax);
+    printf("  insercao=%.0f ns/op  busca(hit)=%.0f ns/op  busca(miss)=%.0f ns/op  achados=%d\n",
+           (t1 - t0) * 1e9 / n, (t2 - t1) * 1e9 / n, (t3 - t2) * 1e9 / n, achados);
+    liberarTabelaHash(tab);
+    reiniciarTextos();
+}
+
+// memória residente atual do processo, em KiB (0 se /proc indisponível)
+static long lerRssKiB(void) {
+    long paginas = 0, residentes = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    if (fscanf(f, "%ld %ld", &paginas, &residentes) != 2) residentes = 0;
+    fclose(f);
+    return residentes * 4;
+}
+
+/*
+ * benchMemoria: monta uma mansão completa de n salas, n pistas coletadas e
+ * n associações na hash, com a arena em modo individual (um malloc por nó,
+ * como antes da arena) e em modo agrupado, comparando chamadas a
+ * malloc, RSS e tempos de montagem e de desmontagem. Cada modo roda num
+ * processo filho para que o RSS de um não contamine o outro.
+ */
+static void benchMemoria(int n) {
+    for (int individual = 1; individual >= 0; individual--) {
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0) { perror("fork benchMemoria"); exit(EXIT_FAILURE); }
+        if (pid > 0) {
+            waitpid(pid, NULL, 0);
+            continue;
+        }
+
+        Sala **salas = (Sala**) malloc((size_t) n * sizeof(Sala*));
+        if (!salas) { perror("malloc benchMemoria"); exit(EXIT_FAILURE); }
+        char buf[32];
+        size_t mallocAntes = g_chamadasMalloc;
+        long rssAntes = lerRssKiB();
+        double t0 = agoraSegundos();
+
+        Arena *arena = criarArena(individual);
+        for (int i = 0; i < n; i++) {
+            snprintf(buf, sizeof(buf), "Sala %d", i);
+            salas[i] = criarSala(arena, buf);
+            if (i > 0) {
+                if (i % 2) salas[(i - 1) / 2]->esq = salas[i];
+                else salas[(i - 1) / 2]->dir = salas[i];
+            }
+        }
+        PistaNode *raiz = NULL;
+        TabelaHash *tab = criarTabelaHash(0);
+        int inseriu;
+        for (int i = 0; i < n; i++) {
+            snprintf(buf, sizeof(buf), "pista %d", i);
+            raiz = inserirPistaIterativa(arena, raiz, internar(buf), &inseriu);
+            inserirNaHash(tab, buf, (i % 2) ? "Marido" : "Jardineiro");
+        }
+
+        double t1 = agoraSegundos();
+        long rssDepois = lerRssKiB();
+        size_t chamadas = g_chamadasMalloc - mallocAntes;
+        liberarTabelaHash(tab);
+        liberarArena(arena);
+        reiniciarTextos();
+        double t2 = agoraSegundos();
+
+        printf("%-10s n=%d  malloc=%zu  rss=+%ld KiB  montagem=%.3fs  desmontagem=%.4fs\n",
+               individual ? "individual" : "arena", n, chamadas, rssDepois - rssAntes,
+               t1 - t0, t2 - t1);
+        free(salas);
+        exit(EXIT_SUCCESS);
+    }
+}
+
+/*
+ * benchInternacao: n referências a pistas com fator de duplicação 'dup'
+ * (n/dup pistas distintas), cada uma guardada na AVL e na hash com um de
+ * cinco suspeitos. Compara os bytes de texto que seriam copiados guardando
+ * uma cópia por referência (AVL + chave + valor) com o pool internado.
+ */
+static void benchInternacao(int n, int dup) {
+    static const char *suspeitos[] = { "Jardineiro", "Marido", "Bibliotecaria", "Cozinheiro", "Contador" };
+    Arena *arena = criarArena(0);
+    TabelaHash *tab = criarTabelaHash(0);
+    PistaNode *raiz = NULL;
+    size_t bytesCopias = 0;
+    char buf[48];
+    int inseriu;
+    int distintas = n / dup > 0 ? n / dup : 1;
+
+    double t0 = agoraSegundos();
+    for (int i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf), "pista encontrada numero %d", i % distintas);
+        const char *sus = suspeitos[(i % distintas) % 5];
+        TextoId id = internar(buf);
+        raiz = inserirPistaIterativa(arena, raiz, id, &inseriu);
+        inserirNaHash(tab, buf, sus);
+        bytesCopias += 2 * (strlen(buf) + 1) + strlen(sus) + 1;
+    }
+    double t1 = agoraSegundos();
+
+    printf("n=%d dup=%d  textos=%u  pool=%zu bytes  copias=%zu bytes (%.1fx)  %.0f ns/ref\n",
+           n, dup, g_textos.total, g_textos.poolUsado, bytesCopias,
+           (double) bytesCopias / (double) g_textos.poolUsado, (t1 - t0) * 1e9 / n);
+    liberarTabelaHash(tab);
+    liberarArena(arena);
+    reiniciarTextos();
+}
+
+/*
+ * benchVeredito: caderno com n pistas distribuídas entre 'nSuspeitos'
+ * suspeitos; compara o custo de uma acusação pela recontagem completa
+ * (contarPistasPorSuspeito) com a leitura do placar, e confere os dois.
+ */
+static void benchVeredito(int n, int nSuspeitos) {
+    Arena *arena = criarArena(0);
+    TabelaHash *tab = criarTabelaHash(0);
+    PistaNode *raiz = NULL;
+    Placar placar;
+    iniciarPlacar(&placar);
+    char buf[48], sus[32];
+    int inseriu;
+
+    for (int i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf), "pista %d", i);
+        snprintf(sus, sizeof(sus), "Suspeito %d", i % nSuspeitos);
+        inserirNaHash(tab, buf, sus);
+        TextoId id = internar(buf);
+        raiz = inserirPistaIterativa(arena, raiz, id, &inseriu);
+        if (inseriu) placarSomar(&placar, encontrarSuspeitoId(tab, id), +1);
+    }
+
+    int acusacoes = 20, divergencias = 0;
+    double tScan = 0, tPlacar = 0;
+    for (int a = 0; a < acusacoes; a++) {
+        snprintf(sus, sizeof(sus), "SUSPEITO %d", a % nSuspeitos);
+        int porScan = 0;
+        double t0 = agoraSegundos();
+        contarPistasPorSuspeito(raiz, tab, sus, &porScan);
+        double t1 = agoraSegundos();
+        int porPlacar = placarContagem(&placar, buscarSuspeito(sus));
+        double t2 = agoraSegundos();
+        tScan += t1 - t0;
+        tPlacar += t2 - t1;
+        if (porScan != porPlacar) divergencias++;
+    }
+    printf("n=%d suspeitos=%d  recontagem=%.3f ms/acusacao  placar=%.0f ns/acusacao  divergencias=%d\n",
+           n, nSuspeitos, tScan * 1e3 / acusacoes, tPlacar * 1e9 / acusacoes, divergencias);
+
+    liberarPlacar(&placar);
+    liberarTabelaHash(tab);
+    liberarArena(arena);
+    reiniciarTextos();
+}
+
+/*
+ * escreverMansaoTeste: grava em 'caminho' (criado com mkstemp) uma mansão
+ * completa de n salas no formato de carregarMansao; metade das salas tem
+ * pista. Com nSuspeitos > 0 cada pista ganha uma linha H. Retorna 0 ou -1.
+ */
+static int escreverMansaoTeste(char *caminho, int n, int nSuspeitos) {
+    int fd = mkstemp(caminho);
+    if (fd < 0) { perror("mkstemp escreverMansaoTeste"); return -1; }
+    FILE *f = fdopen(fd, "w");
+    fprintf(f, "M|%d\n", n);
+    for (int i = 0; i < n; i++) {
+        fprintf(f, "S|%d|Sala %d|", i, i);
+        if (i % 2 == 0) fprintf(f, "pista %d", i);
+        fputc('|', f);
+        if (2 * i + 1 < n) fprintf(f, "%d", 2 * i + 1);
+        fputc('|', f);
+        if (2 * i + 2 < n) fprintf(f, "%d", 2 * i + 2);
+        fputc('\n', f);
+    }
+    for (int i = 0; nSuspeitos > 0 && i < n; i += 2)
+        fprintf(f, "H|pista %d|Suspeito %d\n", i, (i / 2) % nSuspeitos);
+    fclose(f);
+    return 0;
+}
+
+/*
+ * benchCarregarMansao: grava a descrição de uma mansão completa de n salas
+ * (metade com pista) num arquivo temporário e compara carregarMansao com a
+ * montagem pela árvore de Sala (criarSala + mansaoDeSalas).
+ */
+static void benchCarregarMansao(int n) {
+    char caminho[] = "/tmp/dq_mansaoXXXXXX";
+    if (escreverMansaoTeste(caminho, n, 0) != 0) return;
+
+    Mansao m;
+    double t0 = agoraSegundos();
+    int rc = carregarMansao(caminho, &m, NULL, NULL);
+    double t1 = agoraSegundos();
+    unlink(caminho);
+    if (rc != 0) return;
+    printf("arquivo    n=%d  %.3fs (%.0f salas/s)  %zu bytes/sala + pool %zu bytes\n",
+           n, t1 - t0, n / (t1 - t0), sizeof(SalaPlana), g_textos.poolUsado);
+    liberarMansao(&m);
+    reiniciarTextos();
+
+    Arena *arena = criarArena(0);
+    Sala **salas = (Sala**) malloc((size_t) n * sizeof(Sala*));
+    char buf[32];
+    t0 = agoraSegundos();
+    for (int i = 0; i < n; i++) {
+        snprintf(buf, sizeof(buf), "Sala %d", i);
+        salas[i] = criarSala(arena, buf);
+        if (i > 0) {
+            if (i % 2) salas[(i - 1) / 2]->esq = salas[i];
+            else salas[(i - 1) / 2]->dir = salas[i];
+        }
+    }
+    mansaoDeSalas(&m, salas[0]);
+    t1 = agoraSegundos();
+    printf("criarSala  n=%d  %.3fs (%.0f salas/s)  %zu bytes/sala na arvore de Sala\n",
+           n, t1 - t0, n / (t1 - t0), sizeof(Sala));
+    free(salas);
+    liberarMansao(&m);
+    liberarArena(arena);
+    reiniciarTextos();
+}
+
+// pista pela cadeia de strcmp que pistaDaSala usava (referência do benchmark)
+static TextoId pistaPorComparacao(const char *nomeSala) {
+    for (size_t i = 0; i < sizeof(CATALOGO_PISTAS) / sizeof(CATALOGO_PISTAS[0]); i++)
+        if (strcmp(nomeSala, CATALOGO_PISTAS[i][0]) == 0) return internar(CATALOGO_PISTAS[i][1]);
+    return TEXTO_NENHUM;
+}
+
+/*
+ * benchPassos: passeio aleatório pela mansão (desce por um filho sorteado,
+ * volta à raiz nas folhas) resolvendo a pista da sala a cada passo de três
+ * formas: cadeia de strcmp, catálogo indexado por id e campo da sala.
+ */
+static void benchPassos(int n) {
+    Arena *arena = criarArena(0);
+    Sala **salas = (Sala**) malloc((size_t) n * sizeof(Sala*));
+    char buf[32];
+    size_t nCatalogo = sizeof(CATALOGO_PISTAS) / sizeof(CATALOGO_PISTAS[0]);
+    for (int i = 0; i < n; i++) {
+        // metade das salas com nome do catálogo, metade sem pista (pior caso da cadeia)
+        if (i % 2 == 0) snprintf(buf, sizeof(buf), "%s", CATALOGO_PISTAS[(i / 2) % nCatalogo][0]);
+        else snprintf(buf, sizeof(buf), "Sala %d", i);
+        salas[i] = criarSala(arena, buf);
+        if (i > 0) {
+            if (i % 2) salas[(i - 1) / 2]->esq = salas[i];
+            else salas[(i - 1) / 2]->dir = salas[i];
+        }
+    }
+    Mansao m;
+    mansaoDeSalas(&m, salas[0]);
+    free(salas);
+
+    const long passos = 20000000;
+    const char *nomes[] = { "strcmp", "catalogo", "campo" };
+    for (int modo = 0; modo < 3; modo++) {
+        unsigned long long estado = 42;
+        uint32_t cursor = m.raiz;
+        unsigned long long soma = 0;
+        double t0 = agoraSegundos();
+        for (long k = 0; k < passos; k++) {
+            const SalaPlana *sala = &m.salas[cursor];
+            TextoId pista = modo == 0 ? pistaPorComparacao(textoDe(sala->nome))
+                          : modo == 1 ? pistaDaSala(sala->nome)
+                          : sala->pista;
+            soma += pista;
+            uint32_t prox = (proximoAleatorio(&estado) & 1) ? sala->esq : sala->dir;
+            cursor = prox != SALA_NENHUMA ? prox : m.raiz;
+        }
+        double t1 = agoraSegundos();
+        printf("%-9s n=%d  %.0f passos/s  (soma %llu)\n", nomes[modo], n, passos / (t1 - t0), soma);
+    }
+    liberarMansao(&m);
+    liberarArena(arena);
+    reiniciarTextos();
+}
+
+/*
+ * primeirosPassos: desce 'passos' salas pela direita a partir da raiz
+ * consultando o suspeito de cada pista, como o início de uma sessão.
+ */
+static uint32_t primeirosPassos(const Mansao *m, TabelaHash *tab, int passos) {
+    uint32_t achados = 0;
+    for (uint32_t s = m->raiz; s != SALA_NENHUMA && passos-- > 0; s = m->salas[s].dir)
+        achados += encontrarSuspeitoId(tab, m->salas[s].pista) != SUSPEITO_NENHUM;
+    return achados;
+}
+
+static void benchCasoMapeado(int n) {
+    char texto[] = "/tmp/dq_mansaoXXXXXX";
+    char binario[] = "/tmp/dq_casoXXXXXX";
+    if (escreverMansaoTeste(texto, n, 50) != 0) return;
+    int fd = mkstemp(binario);
+    if (fd < 0) { perror("mkstemp benchCasoMapeado"); unlink(texto); return; }
+    close(fd);
+
+    Mansao m;
+    TabelaHash *tab = criarTabelaHash(0);
+    double t0 = agoraSegundos();
+    int rc = carregarMansao(texto, &m, tab, NULL);
+    uint32_t achados = rc == 0 ? primeirosPassos(&m, tab, 20) : 0;
+    double t1 = agoraSegundos();
+    if (rc == 0) {
+        printf("texto      n=%d  pronto em %.4fs (%u pistas nos primeiros passos)\n", n, t1 - t0, achados);
+        rc = gravarCaso(binario, &m, tab, NULL);
+        liberarMansao(&m);
+    }
+    liberarTabelaHash(tab);
+    reiniciarTextos();
+    unlink(texto);
+    if (rc != 0) { unlink(binario); return; }
+
+    // tira o arquivo do cache de páginas para medir a partida a frio
+    fd = open(binario, O_RDONLY);
+    struct stat st;
+    fstat(fd, &st);
+    fsync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+
+    for (int rodada = 0; rodada < 2; rodada++) {
+        Caso caso;
+        t0 = agoraSegundos();
+        if (abrirCaso(binario, &caso) != 0) break;
+        achados = primeirosPassos(&caso.mansao, caso.tabela, 20);
+        t1 = agoraSegundos();
+        printf("caso .dqc  n=%d  pronto em %.4fs (%s, %u pistas nos primeiros passos)  arquivo %lld bytes\n",
+               n, t1 - t0, rodada == 0 ? "frio" : "em cache", achados, (long long) st.st_size);
+        fecharCaso(&caso);
+    }
+    unlink(binario);
+}
+
+// caso de teste compartilhado: mansão completa de n salas, 50 suspeitos
+static int montarCasoTeste(int n, Caso *caso) {
+    char texto[] = "/tmp/dq_mansaoXXXXXX";
+    if (escreverMansaoTeste(texto, n, 50) != 0) return -1;
+    TabelaHash *tab = criarTabelaHash(0);
+    Mansao m;
+    int rc = carregarMansao(texto, &m, tab, NULL);
+    unlink(texto);
+    if (rc != 0) { liberarTabelaHash(tab); reiniciarTextos(); return -1; }
+    prepararCaso(caso, &m, tab, NULL);
+    return 0;
+}
+
+// roteiros aleatórios para executarLote (tmpfile), ou NULL
+static FILE* escreverRoteirosTeste(long sessoes) {
+    FILE *roteiros = tmpfile();
+    if (!roteiros) { perror("tmpfile escreverRoteirosTeste"); return NULL; }
+    unsigned long long estado = 7;
+    for (long i = 0; i < sessoes; i++) {
+        int passos = 5 + (int) (proximoAleatorio(&estado) % 36);
+        for (int k = 0; k < passos; k++) {
+            unsigned long long r = proximoAleatorio(&estado) % 16;
+            fputc(r < 7 ? 'e' : r < 14 ? 'd' : 'r', roteiros);
+        }
+        fprintf(roteiros, " s | Suspeito %d\n", (int) (proximoAleatorio(&estado) % 50));
+    }
+    return roteiros;
+}
+
+/*
+ * benchServidor: as mesmas sessões aleatórias (passeios de 5 a 40 comandos
+ * e uma acusação) rodadas com 1, 2, 4, ... threads sobre um caso de n salas
+ * compartilhado, até o dobro dos núcleos disponíveis.
+ */
+static void benchServidor(int n) {
+    Caso caso;
+    if (montarCasoTeste(n, &caso) != 0) return;
+    FILE *roteiros = escreverRoteirosTeste(200000);
+    if (!roteiros) { fecharCaso(&caso); return; }
+
+    long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nucleos < 1) nucleos = 1;
+    double base = 0;
+    for (int t = 1; t <= 2 * nucleos || t == 1; t *= 2) {
+        rewind(roteiros);
+        EstatisticasLote est;
+        if (executarLote(roteiros, NULL, &caso, CADERNO_AVL, t, &est) != 0) break;
+        double taxa = est.sessoes / est.segundos;
+        if (t == 1) base = taxa;
+        printf("threads=%-3d %lu sessoes  %.0f sessoes/s  %.0f passos/s  (x%.2f; %ld nucleo(s))\n",
+               t, est.sessoes, taxa, est.passos / est.segundos, taxa / base, nucleos);
+    }
+    fclose(roteiros);
+    fecharCaso(&caso);
+}
+
+/*
+ * benchCaderno: as mesmas sessões com caderno AVL e com bitset (vazão e
+ * bytes de caderno por sessão) e conferência das contagens por popcount
+ * contra o placar, para todos os suspeitos, ao fim de cada sessão.
+ */
+static void benchCaderno(int n) {
+    Caso caso;
+    if (montarCasoTeste(n, &caso) != 0) return;
+    FILE *roteiros = escreverRoteirosTeste(200000);
+    if (!roteiros) { fecharCaso(&caso); return; }
+
+    const char *nomes[] = { "avl", "bits" };
+    for (int modo = CADERNO_AVL; modo <= CADERNO_BITS; modo++) {
+        rewind(roteiros);
+        EstatisticasLote est;
+        if (executarLote(roteiros, NULL, &caso, (ModoCaderno) modo, 1, &est) != 0) break;
+        printf("caderno %-4s  %.0f sessoes/s  %.0f passos/s\n", nomes[modo],
+               est.sessoes / est.segundos, est.passos / est.segundos);
+    }
+
+    // sessões longas (200 comandos aleatórios): tamanho do caderno e popcount
+    unsigned long long estado = 11, bytesAvl = 0, divergencias = 0;
+    const int sessoes = 2000;
+    Sessao s;
+    iniciarSessao(&s, &caso, CADERNO_BITS);
+    double tPop = 0;
+    for (int i = 0; i < sessoes; i++) {
+        reiniciarSessao(&s, &caso);
+        coletarPistaDaSala(&s, &caso);
+        for (int k = 0; k < 200; k++) {
+            unsigned long long r = proximoAleatorio(&estado) % 16;
+            if (aplicarComando(&caso.mansao, &s.cursor, r < 7 ? 'e' : r < 14 ? 'd' : 'r') != COMANDO_SEM_SALA)
+                coletarPistaDaSala(&s, &caso);
+        }
+        bytesAvl += (unsigned long long) s.coletadas * ((sizeof(PistaNode) + ARENA_ALINHAMENTO - 1) & ~(size_t) (ARENA_ALINHAMENTO - 1));
+        double t0 = agoraSegundos();
+        for (SuspeitoId sus = 0; sus < caso.totalMascaras; sus++)
+            divergencias += contagemPorMascara(&s, &caso, sus) != placarContagem(&s.placar, sus);
+        tPop += agoraSegundos() - t0;
+    }
+    liberarSessao(&s);
+    printf("caderno por sessao: avl ~%llu bytes (media, so nos)  bits %zu bytes (%u pistas no caso)\n",
+           bytesAvl / sessoes, (size_t) caso.palavras * sizeof(uint64_t), caso.totalPistas);
+    printf("contagens por popcount: %.0f ns/suspeito  divergencias do placar=%llu\n",
+           tPop * 1e9 / ((double) sessoes * caso.totalMascaras), divergencias);
+    fclose(roteiros);
+    fecharCaso(&caso);
+}
+
+/*
+ * benchCargaEmLote: n pares pista -> suspeito (20% de pistas repetidas, 50
+ * suspeitos) inseridos um a um (inserirNaHash + inserirPistaIterativa) e
+ * por carregarEvidencias com 1, 2, 4, ... threads. Confere que a tabela e o
+ * índice saem iguais: mesmas pistas, mesma ordem e mesmo suspeito por pista.
+ */
+static void benchCargaEmLote(int n) {
+    char *textos = (char*) alocarMemoria((size_t) n * 40 + 1, "malloc benchCargaEmLote");
+    ParEvidencia *pares = (ParEvidencia*) alocarMemoria((size_t) n * sizeof(ParEvidencia), "malloc benchCargaEmLote");
+    unsigned long long estado = 13;
+    char *p = textos;
+    for (int i = 0; i < n; i++) {
+        int pista = (i > 0 && proximoAleatorio(&estado) % 5 == 0) ? (int) (proximoAleatorio(&estado) % (unsigned) i) : i;
+        pares[i].pista = p;
+        p += sprintf(p, "pista %d", pista) + 1;
+        pares[i].suspeito = p;
+        p += sprintf(p, "Suspeito %d", (int) (proximoAleatorio(&estado) % 50)) + 1;
+    }
+
+    // referência: um a um
+    size_t malloc0 = g_chamadasMalloc;
+    Arena *arena = criarArena(0);
+    TabelaHash *ref = criarTabelaHash(0);
+    PistaNode *indiceRef = NULL;
+    int inseriu;
+    double t0 = agoraSegundos();
+    for (int i = 0; i < n; i++) {
+        inserirNaHash(ref, pares[i].pista, pares[i].suspeito);
+        indiceRef = inserirPistaIterativa(arena, indiceRef, buscarTexto(pares[i].pista), &inseriu);
+    }
+    double tRef = agoraSegundos() - t0;
+    printf("um a um     %.3fs (%.0f pares/s)  %d pistas  altura=%d  mallocs=%zu\n", tRef, n / tRef,
+           contarPistas(indiceRef), alturaPista(indiceRef), (size_t) g_chamadasMalloc - malloc0);
+
+    // a carga em lote começa dos mesmos cadastros vazios, como um caso novo
+    TextoId *ordemRef = (TextoId*) alocarMemoria(((size_t) contarPistas(indiceRef) + 1) * sizeof(TextoId), "malloc benchCargaEmLote");
+    char **nomeRef = (char**) alocarMemoria(((size_t) contarPistas(indiceRef) + 1) * sizeof(char*), "malloc benchCargaEmLote");
+    size_t total = 0;
+    CursorArvore c;
+    PistaNode *no;
+    abrirCursorPistas(&c, indiceRef, ORDEM_EM);
+    while ((no = proximaPista(&c))) {
+        ordemRef[total] = no->pista;
+        nomeRef[total++] = strdup(nomeDoSuspeito(encontrarSuspeitoId(ref, no->pista)));
+    }
+    fecharCursor(&c);
+    liberarTabelaHash(ref);
+    liberarArena(arena);
+    reiniciarTextos();
+
+    long nucleos = sysconf(_SC_NPROCESSORS_ONLN);
+    if (nucleos < 1) nucleos = 1;
+    for (int t = 1; t <= 2 * nucleos || t <= 4; t *= 2) {
+        malloc0 = g_chamadasMalloc;
+        arena = criarArena(0);
+        PistaNode *indice = NULL;
+        t0 = agoraSegundos();
+        TabelaHash *tab = carregarEvidencias(pares, (size_t) n, t, arena, &indice);
+        double tLote = agoraSegundos() - t0;
+        size_t divergencias = (size_t) contarPistas(indice) != total, k = 0;
+        abrirCursorPistas(&c, indice, ORDEM_EM);
+        while ((no = proximaPista(&c)) && k < total) {
+            if (no->pista != ordemRef[k] || strcmp(nomeDoSuspeito(encontrarSuspeitoId(tab, no->pista)), nomeRef[k]) != 0)
+                divergencias++;
+            k++;
+        }
+        fecharCursor(&c);
+        printf("lote %2d thr %.3fs (%.0f pares/s, %.1fx)  altura=%d  carga=%.2f  mallocs=%zu  divergencias=%zu\n",
+               t, tLote, n / tLote, tRef / tLote, alturaPista(indice), (double) tab->tamanho / tab->capacidade,
+               (size_t) g_chamadasMalloc - malloc0, divergencias);
+        liberarTabelaHash(tab);
+        liberarArena(arena);
+        reiniciarTextos();
+    }
+    for (size_t k = 0; k < total; k++) free(nomeRef[k]);
+    free(nomeRef);
+    free(ordemRef);
+    free(pares);
+    free(textos);
+}
+
+/*
+ * Gerador de casos sintéticos
+ * Descreve uma mansão de n salas por índices (forma balanceada, cadeia
+ * degenerada ou aleatória), uma pista por sala com fração configurável de
+ * repetições e um suspeito por pista distinta. Repetições e suspeitos são
+ * sorteados de modo uniforme ou com distribuição do tipo Zipf (aproximada
+ * por log-uniforme: densidade ~1/k, sem depender de libm). Tudo é função da
+ * semente, então os números de execuções diferentes são comparáveis.
+ */
+typedef enum { FORMA_BALANCEADA, FORMA_CADEIA, FORMA_ALEATORIA } FormaMansao;
+typedef enum { CHAVES_UNIFORME, CHAVES_ZIPF } DistribuicaoChaves;
+
+static const char *NOMES_FORMAS[] = { "balanceada", "cadeia", "aleatoria" };
+static const char *NOMES_DISTRIBUICOES[] = { "uniforme", "zipf" };
+
+typedef struct ConfigGerador {
+    FormaMansao forma;
+    uint32_t salas;
+    unsigned duplicacao;        // % de salas cuja pista repete uma já usada
+    DistribuicaoChaves dist;    // sorteio das pistas repetidas e dos suspeitos
+    uint32_t suspeitos;
+    unsigned long long semente;
+} ConfigGerador;
+
+typedef struct CasoSintetico {
+    uint32_t salas;
+    uint32_t *esq, *dir;        // filhos por índice ou SALA_NENHUMA
+    uint32_t *pista;            // pista (índice denso) de cada sala
+    uint32_t pistas;            // pistas distintas
+    uint32_t *suspeitoDaPista;
+} CasoSintetico;
+
+// índice em [0, n) com a distribuição pedida
+static uint32_t sortearIndice(unsigned long long *estado, uint32_t n, DistribuicaoChaves dist) {
+    if (n <= 1) return 0;
+    unsigned long long r = proximoAleatorio(estado);
+    if (dist == CHAVES_UNIFORME) return (uint32_t) (r % n);
+    // faixa [2^b - 1, 2^(b+1) - 1) com b uniforme: cada faixa recebe a mesma massa
+    int bits = 64 - __builtin_clzll((unsigned long long) n);
+    int b = (int) (r % (unsigned) bits);
+    unsigned long long ini = (1ULL << b) - 1, largura = 1ULL << b;
+    unsigned long long k = ini + (proximoAleatorio(estado) % largura);
+    return k < n ? (uint32_t) k : (uint32_t) (r % n);
+}
+
+static void gerarCasoSintetico(const ConfigGerador *cfg, CasoSintetico *c) {
+    uint32_t n = cfg->salas;
+    unsigned long long estado = cfg->semente ? cfg->semente : 1;
+    c->salas = n;
+    c->esq = (uint32_t*) alocarMemoria((size_t) n * sizeof(uint32_t), "malloc gerarCasoSintetico");
+    c->dir = (uint32_t*) alocarMemoria((size_t) n * sizeof(uint32_t), "malloc gerarCasoSintetico");
+    c->pista = (uint32_t*) alocarMemoria((size_t) n * sizeof(uint32_t), "malloc gerarCasoSintetico");
+    for (uint32_t i = 0; i < n; i++) c->esq[i] = c->dir[i] = SALA_NENHUMA;
+
+    if (cfg->forma == FORMA_ALEATORIA) {
+        // vagas livres (sala*2 + lado); cada sala nova ocupa uma vaga sorteada
+        uint32_t *vagas = (uint32_t*) alocarMemoria(((size_t) n + 1) * 2 * sizeof(uint32_t), "malloc gerarCasoSintetico");
+        size_t total = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            if (i > 0) {
+                size_t k = (size_t) (proximoAleatorio(&estado) % total);
+                uint32_t v = vagas[k];
+                vagas[k] = vagas[--total];
+                if (v & 1) c->dir[v >> 1] = i;
+                else c->esq[v >> 1] = i;
+            }
+            vagas[total++] = 2 * i;
+            vagas[total++] = 2 * i + 1;
+        }
+        free(vagas);
+    } else {
+        for (uint32_t i = 1; i < n; i++) {
+            if (cfg->forma == FORMA_CADEIA) c->esq[i - 1] = i;
+            else if (i % 2) c->esq[(i - 1) / 2] = i;
+            else c->dir[(i - 1) / 2] = i;
+        }
+    }
+
+    c->pistas = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        if (c->pistas > 0 && proximoAleatorio(&estado) % 100 < cfg->duplicacao)
+            c->pista[i] = sortearIndice(&estado, c->pistas, cfg->dist);
+        else
+            c->pista[i] = c->pistas++;
+    }
+    c->suspeitoDaPista = (uint32_t*) alocarMemoria(((size_t) c->pistas + 1) * sizeof(uint32_t), "malloc gerarCasoSintetico");
+    for (uint32_t k = 0; k < c->pistas; k++)
+        c->suspeitoDaPista[k] = sortearIndice(&estado, cfg->suspeitos, cfg->dist);
+}
+
+static void liberarCasoSintetico(CasoSintetico *c) {
+    free(c->esq);
+    free(c->dir);
+    free(c->pista);
+    free(c->suspeitoDaPista);
+}
+
+// grava no formato de carregarMansao (M, S e H), para uso com --mansao
+static void gravarCasoSintetico(FILE *f, const CasoSintetico *c) {
+    fprintf(f, "M|%u\n", c->salas);
+    for (uint32_t i = 0; i < c->salas; i++) {
+        fprintf(f, "S|%u|Sala %u|pista %u|", i, i, c->pista[i]);
+        if (c->esq[i] != SALA_NENHUMA) fprintf(f, "%u", c->esq[i]);
+        fputc('|', f);
+        if (c->dir[i] != SALA_NENHUMA) fprintf(f, "%u", c->dir[i]);
+        fputc('\n', f);
+    }
+    for (uint32_t k = 0; k < c->pistas; k++)
+        fprintf(f, "H|pista %u|Suspeito %u\n", k, c->suspeitoDaPista[k]);
+}
+
+/*
+ * nomeAcusado: acusação sorteada para a carga de trabalho: 10% de nomes
+ * que não existem e o resto com a grafia trocada de vez em quando
+ * ("SUSPEITO 7", "suspeito 7"), como digitado por jogadores.
+ */
+static void nomeAcusado(char *buf, size_t cap, unsigned long long *estado, const ConfigGerador *cfg) {
+    unsigned long long r = proximoAleatorio(estado) % 10;
+    uint32_t k = sortearIndice(estado, cfg->suspeitos, cfg->dist);
+    snprintf(buf, cap, r == 0 ? "Ninguem %u" : r == 1 ? "SUSPEITO %u" : r == 2 ? "suspeito %u" : "Suspeito %u", k);
+}
+
+// roteiros de --lote: passeios de 5 a 40 comandos e uma acusação
+static void gravarRoteirosSinteticos(FILE *f, long sessoes, const ConfigGerador *cfg) {
+    unsigned long long estado = (cfg->semente ? cfg->semente : 1) ^ 0xA5A5A5A5ULL;
+    char acusado[48];
+    for (long i = 0; i < sessoes; i++) {
+        int passos = 5 + (int) (proximoAleatorio(&estado) % 36);
+        for (int k = 0; k < passos; k++) {
+            unsigned long long r = proximoAleatorio(&estado) % 16;
+            fputc(r < 7 ? 'e' : r < 14 ? 'd' : 'r', f);
+        }
+        nomeAcusado(acusado, sizeof(acusado), &estado, cfg);
+        fprintf(f, " s | %s\n", acusado);
+    }
+}
+
+/*
+ * benchEscala: para n = 10^3, 10^4, ... até 'maximo', mede com casos
+ * sintéticos a montagem da árvore por criarSala (nas três formas), a
+ * inserção das pistas visitadas no caderno (inserirPistaIterativa), a
+ * tabela pista->suspeito (inserirNaHash e encontrarSuspeito, 10% de buscas
+ * sem sucesso) e acusações pelo placar (acusacaoSustentada, o núcleo de
+ * verificarSuspeitoFinal) com duplicação 0%/50% e chaves uniformes/Zipf.
+ * Memória: bytes de arena por sala, RSS e chamadas a malloc acrescentadas.
+ */
+static void benchEscala(long maximo, unsigned long long semente) {
+    char nome[48], sus[48];
+    printf("semente=%llu\n", semente);
+    printf("%-9s %-10s %12s %8s %10s %10s %8s\n", "n", "forma", "criarSala", "plana", "altura", "arena B/s", "RSS KiB");
+    for (long n = 1000; n <= maximo; n *= 10) {
+        for (int forma = FORMA_BALANCEADA; forma <= FORMA_ALEATORIA; forma++) {
+            ConfigGerador cfg = { (FormaMansao) forma, (uint32_t) n, 0, CHAVES_UNIFORME, 50, semente };
+            CasoSintetico c;
+            gerarCasoSintetico(&cfg, &c);
+            long rss0 = lerRssKiB();
+            Arena *arena = criarArena(0);
+            Sala **salas = (Sala**) alocarMemoria((size_t) n * sizeof(Sala*), "malloc benchEscala");
+            double t0 = agoraSegundos();
+            for (uint32_t i = 0; i < c.salas; i++) {
+                snprintf(nome, sizeof(nome), "Sala %u", i);
+                salas[i] = criarSala(arena, nome);
+            }
+            for (uint32_t i = 0; i < c.salas; i++) {
+                if (c.esq[i] != SALA_NENHUMA) salas[i]->esq = salas[c.esq[i]];
+                if (c.dir[i] != SALA_NENHUMA) salas[i]->dir = salas[c.dir[i]];
+            }
+            double t1 = agoraSegundos();
+            Mansao m;
+            mansaoDeSalas(&m, salas[0]);
+            double t2 = agoraSegundos();
+            int altura = 0;
+            {   // altura por níveis sobre os índices gerados
+                uint32_t *nivel = (uint32_t*) alocarMemoria((size_t) n * sizeof(uint32_t), "malloc benchEscala");
+                nivel[0] = 1;
+                for (uint32_t i = 0; i < c.salas; i++) {
+                    if ((int) nivel[i] > altura) altura = (int) nivel[i];
+                    if (c.esq[i] != SALA_NENHUMA) nivel[c.esq[i]] = nivel[i] + 1;
+                    if (c.dir[i] != SALA_NENHUMA) nivel[c.dir[i]] = nivel[i] + 1;
+                }
+                free(nivel);
+            }
+            printf("%-9ld %-10s %9.0f ns %5.0f ns %10d %10.1f %8ld\n", n, NOMES_FORMAS[forma],
+                   (t1 - t0) * 1e9 / n, (t2 - t1) * 1e9 / n, altura,
+                   (double) arena->bytesReservados / n, lerRssKiB() - rss0);
+            liberarMansao(&m);
+            free(salas);
+            liberarArena(arena);
+            liberarCasoSintetico(&c);
+            reiniciarTextos();
+        }
+    }
+
+    printf("\n%-9s %-8s %4s %9s %8s %8s %8s %8s %6s %8s %6s %8s %9s\n", "n", "chaves", "dup", "distintas",
+           "avl ns", "altura", "hash ns", "busca ns", "achou", "acusa ns", "sust", "RSS KiB", "mallocs");
+    for (long n = 1000; n <= maximo; n *= 10) {
+        for (int dist = CHAVES_UNIFORME; dist <= CHAVES_ZIPF; dist++) {
+            for (unsigned dup = 0; dup <= 50; dup += 50) {
+                ConfigGerador cfg = { FORMA_ALEATORIA, (uint32_t) n, dup, (DistribuicaoChaves) dist, 50, semente };
+                CasoSintetico c;
+                gerarCasoSintetico(&cfg, &c);
+                long rss0 = lerRssKiB();
+                size_t malloc0 = g_chamadasMalloc;
+
+                // ids das pistas internados antes, para medir só a AVL
+                TextoId *ids = (TextoId*) alocarMemoria(((size_t) c.pistas + 1) * sizeof(TextoId), "malloc benchEscala");
+                for (uint32_t k = 0; k < c.pistas; k++) {
+                    snprintf(nome, sizeof(nome), "pista %u", k);
+                    ids[k] = internar(nome);
+                }
+
+                TabelaHash *tab = criarTabelaHash(0);
+                double t0 = agoraSegundos();
+                for (uint32_t k = 0; k < c.pistas; k++) {
+                    snprintf(nome, sizeof(nome), "pista %u", k);
+                    snprintf(sus, sizeof(sus), "Suspeito %u", c.suspeitoDaPista[k]);
+                    inserirNaHash(tab, nome, sus);
+                }
+                double t1 = agoraSegundos();
+
+                // caderno: pistas na ordem das salas (com as repetições), placar junto
+                Arena *arena = criarArena(0);
+                PistaNode *caderno = NULL;
+                Placar placar;
+                iniciarPlacar(&placar);
+                int inseriu;
+                double t2 = agoraSegundos();
+                for (uint32_t i = 0; i < c.salas; i++) {
+                    TextoId id = ids[c.pista[i]];
+                    caderno = inserirPistaIterativa(arena, caderno, id, &inseriu);
+                    if (inseriu) placarSomar(&placar, encontrarSuspeitoId(tab, id), +1);
+                }
+                double t3 = agoraSegundos();
+
+                unsigned long long estado = semente ^ (unsigned long long) n;
+                long buscas = n < 1000000 ? n : 1000000, achados = 0;
+                double t4 = agoraSegundos();
+                for (long b = 0; b < buscas; b++) {
+                    if (proximoAleatorio(&estado) % 10 == 0)
+                        snprintf(nome, sizeof(nome), "ausente %ld", b);
+                    else
+                        snprintf(nome, sizeof(nome), "pista %u", sortearIndice(&estado, c.pistas, cfg.dist));
+                    achados += encontrarSuspeito(tab, nome) != NULL;
+                }
+                double t5 = agoraSegundos();
+                long sustentadas = 0;
+                for (long b = 0; b < buscas; b++) {
+                    int64_t contagem;
+                    nomeAcusado(sus, sizeof(sus), &estado, &cfg);
+                    sustentadas += acusacaoSustentada(&placar, sus, PISTAS_PARA_SUSTENTAR, &contagem);
+                }
+                double t6 = agoraSegundos();
+
+                printf("%-9ld %-8s %3u%% %9u %8.0f %8d %8.0f %8.0f %5.1f%% %8.0f %5.1f%% %8ld %9zu\n", n,
+                       NOMES_DISTRIBUICOES[dist], dup, c.pistas, (t3 - t2) * 1e9 / n, alturaPista(caderno),
+                       (t1 - t0) * 1e9 / (c.pistas ? c.pistas : 1), (t5 - t4) * 1e9 / buscas,
+                       100.0 * achados / buscas, (t6 - t5) * 1e9 / buscas, 100.0 * sustentadas / buscas,
+                       lerRssKiB() - rss0, (size_t) g_chamadasMalloc - malloc0);
+                liberarPlacar(&placar);
+                liberarArena(arena);
+                liberarTabelaHash(tab);
+                free(ids);
+                liberarCasoSintetico(&c);
+                reiniciarTextos();
+            }
+        }
+    }
+}
+
+/*
+ * gerarParaArquivo: grava um caso sintético (--mansao) e, com sessoes > 0,
+ * roteiros de acusação para --lote no arquivo 'roteiros'.
+ */
+static int gerarParaArquivo(const ConfigGerador *cfg, const char *saida, const char *roteiros, long sessoes) {
+    FILE *f = fopen(saida, "w");
+    if (!f) { perror(saida); return -1; }
+    CasoSintetico c;
+    gerarCasoSintetico(cfg, &c);
+    gravarCasoSintetico(f, &c);
+    fclose(f);
+    printf("%s: %u salas (%s), %u pistas distintas, %u suspeitos, semente %llu\n", saida, c.salas,
+           NOMES_FORMAS[cfg->forma], c.pistas, cfg->suspeitos, cfg->semente);
+    liberarCasoSintetico(&c);
+    if (roteiros && sessoes > 0) {
+        f = fopen(roteiros, "w");
+        if (!f) { perror(roteiros); return -1; }
+        gravarRoteirosSinteticos(f, sessoes, cfg);
+        fclose(f);
+        printf("%s: %ld sessoes\n", roteiros, sessoes);
+    }
+    return 0;
+}
+
+// índice de 'valor' em 'nomes' (n itens) ou -1
+static int opcaoDaLista(const char *valor, const char **nomes, int n) {
+    for (int i = 0; i < n; i++)
+        if (strcmp(valor, nomes[i]) == 0) return i;
+    return -1;
+}
+
+/*
+ * benchTextosSimd: hash e comparação sem caixa por comprimento de string,
+ * djb2 / minusculo+strcmp (versões anteriores) contra as implementações
+ * escalar, SSE2 e AVX2. Confere que todos os níveis dão o mesmo hash.
+ */
+static uint64_t hashDjb2(const char *s) {
+    uint64_t h = 5381;
+    int c;
+    while ((c = (unsigned char) *s++)) h = ((h << 5) + h) + (uint64_t) c;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static int iguaisPorMinusculo(const char *a, const char *b) {
+    char x[1100], y[1100];
+    strcpy(x, a); strcpy(y, b);
+    for (char *p = x; *p; ++p) *p = (char) tolower((unsigned char) *p);
+    for (char *p = y; *p; ++p) *p = (char) tolower((unsigned char) *p);
+    return strcmp(x, y) == 0;
+}
+
+static void benchTextosSimd(int n) {
+    enum { AMOSTRAS = 64 };
+    static const size_t comprimentos[] = { 4, 8, 16, 32, 64, 128, 256, 1024 };
+    NivelSimd maximo = nivelSimdDisponivel();
+    unsigned long long estado = 5, divergencias = 0, colisoesTroca = 0;
+    volatile uint64_t sorvedouro = 0;
+    printf("nivel disponivel: %s\n", nomeNivelSimd(maximo));
+    printf("%6s %10s", "bytes", "djb2");
+    for (int nv = SIMD_ESCALAR; nv <= (int) maximo; nv++) printf(" %10s", nomeNivelSimd((NivelSimd) nv));
+    printf("  |%10s", "minusc+cmp");
+    for (int nv = SIMD_ESCALAR; nv <= (int) maximo; nv++) printf(" %10s", nomeNivelSimd((NivelSimd) nv));
+    printf("   (ns/string)\n");
+
+    for (size_t c = 0; c < sizeof comprimentos / sizeof comprimentos[0]; c++) {
+        size_t len = comprimentos[c];
+        char *a[AMOSTRAS], *b[AMOSTRAS];
+        for (int i = 0; i < AMOSTRAS; i++) {
+            a[i] = (char*) alocarMemoria(len + 1, "malloc benchTextosSimd");
+            b[i] = (char*) alocarMemoria(len + 1, "malloc benchTextosSimd");
+            for (size_t k = 0; k < len; k++) {
+                char ch = (char) ('a' + proximoAleatorio(&estado) % 26);
+                a[i][k] = (proximoAleatorio(&estado) & 1) ? (char) (ch - 32) : ch;
+                b[i][k] = (proximoAleatorio(&estado) & 1) ? (char) (ch - 32) : ch;
+            }
+            a[i][len] = b[i][len] = '\0';
+        }
+        long reps = (long) n / (long) len + 1;
+        if (reps < 200) reps = 200;
+
+        double t0 = agoraSegundos();
+        for (long r = 0; r < reps; r++)
+            for (int i = 0; i < AMOSTRAS; i++) sorvedouro += hashDjb2(a[i]);
+        printf("%6zu %10.1f", len, (agoraSegundos() - t0) * 1e9 / ((double) reps * AMOSTRAS));
+
+        uint64_t referencia[AMOSTRAS];
+        for (int nv = SIMD_ESCALAR; nv <= (int) maximo; nv++) {
+            forcarNivelSimd((NivelSimd) nv);
+            for (int i = 0; i < AMOSTRAS; i++) {
+                uint64_t h = hashString(a[i]);
+                if (nv == SIMD_ESCALAR) referencia[i] = h;
+                else divergencias += h != referencia[i];
+                // os dois primeiros blocos trocados devem mudar o hash
+                if (len >= 2 * HASH_BLOCO && memcmp(a[i], a[i] + HASH_BLOCO, HASH_BLOCO) != 0) {
+                    char *trocado = (char*) alocarMemoria(len, "malloc benchTextosSimd");
+                    memcpy(trocado, a[i] + HASH_BLOCO, HASH_BLOCO);
+                    memcpy(trocado + HASH_BLOCO, a[i], HASH_BLOCO);
+                    memcpy(trocado + 2 * HASH_BLOCO, a[i] + 2 * HASH_BLOCO, len - 2 * HASH_BLOCO);
+                    colisoesTroca += hashBytes(trocado, len) == h;
+                    free(trocado);
+                }
+            }
+            t0 = agoraSegundos();
+            for (long r = 0; r < reps; r++)
+                for (int i = 0; i < AMOSTRAS; i++) sorvedouro += hashString(a[i]);
+            printf(" %10.1f", (agoraSegundos() - t0) * 1e9 / ((double) reps * AMOSTRAS));
+        }
+
+        t0 = agoraSegundos();
+        for (long r = 0; r < reps; r++)
+            for (int i = 0; i < AMOSTRAS; i++) sorvedouro += iguaisPorMinusculo(a[i], b[i]);
+        printf("  |%10.1f", (agoraSegundos() - t0) * 1e9 / ((double) reps * AMOSTRAS));
+        for (int nv = SIMD_ESCALAR; nv <= (int) maximo; nv++) {
+            forcarNivelSimd((NivelSimd) nv);
+            for (int i = 0; i < AMOSTRAS; i++) divergencias += !iguaisSemCaixa(a[i], b[i]);
+            t0 = agoraSegundos();
+            for (long r = 0; r < reps; r++)
+                for (int i = 0; i < AMOSTRAS; i++) sorvedouro += iguaisSemCaixa(a[i], b[i]);
+            printf(" %10.1f", (agoraSegundos() - t0) * 1e9 / ((double) reps * AMOSTRAS));
+        }
+        printf("\n");
+        for (int i = 0; i < AMOSTRAS; i++) { free(a[i]); free(b[i]); }
+    }
+    forcarNivelSimd(maximo);
+    printf("divergencias entre niveis=%llu, colisoes com blocos trocados=%llu\n", divergencias, colisoesTroca);
+    (void) sorvedouro;
+}
+
+/*
+ * Uso:
+ *   detective_bench [n]                  suíte completa com n elementos
+ *   detective_bench --escala [max]       casos sintéticos de 10^3 até max (10^6)
+ *   detective_bench --gerar saida.txt [--forma balanceada|cadeia|aleatoria]
+ *       [--salas n] [--dup pct] [--chaves uniforme|zipf] [--suspeitos k]
+ *       [--roteiros arquivo --sessoes s]
+ * --semente fixa o gerador (padrão 42) em --escala e --gerar.
+ */
+static int mainGerador(int argc, char **argv) {
+    ConfigGerador cfg = { FORMA_ALEATORIA, 1000, 30, CHAVES_ZIPF, 50, 42 };
+    const char *saida = NULL, *roteiros = NULL;
+    long sessoes = 0, maximo = 1000000;
+    int escala = 0;
+    for (int i = 1; i < argc; i++) {
+        const char *v = i + 1 < argc ? argv[i + 1] : NULL;
+        int k;
+        if (strcmp(argv[i], "--escala") == 0) {
+            escala = 1;
+            if (v && atol(v) > 0) maximo = atol(argv[++i]);
+        } else if (strcmp(argv[i], "--gerar") == 0 && v) saida = argv[++i];
+        else if (strcmp(argv[i], "--roteiros") == 0 && v) roteiros = argv[++i];
+        else if (strcmp(argv[i], "--sessoes") == 0 && v && atol(v) > 0) sessoes = atol(argv[++i]);
+        else if (strcmp(argv[i], "--salas") == 0 && v && atol(v) > 0) cfg.salas = (uint32_t) atol(argv[++i]);
+        else if (strcmp(argv[i], "--dup") == 0 && v && atoi(v) >= 0 && atoi(v) <= 100) cfg.duplicacao = (unsigned) atoi(argv[++i]);
+        else if (strcmp(argv[i], "--suspeitos") == 0 && v && atol(v) > 0) cfg.suspeitos = (uint32_t) atol(argv[++i]);
+        else if (strcmp(argv[i], "--semente") == 0 && v) cfg.semente = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--forma") == 0 && v && (k = opcaoDaLista(v, NOMES_FORMAS, 3)) >= 0) {
+            cfg.forma = (FormaMansao) k;
+            i++;
+        } else if (strcmp(argv[i], "--chaves") == 0 && v && (k = opcaoDaLista(v, NOMES_DISTRIBUICOES, 2)) >= 0) {
+            cfg.dist = (DistribuicaoChaves) k;
+            i++;
+        } else {
+            fprintf(stderr, "opcao invalida: %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (escala) {
+        printf("== Escala: casos sinteticos ==\n");
+        benchEscala(maximo, cfg.semente);
+    }
+    if (saida && gerarParaArquivo(&cfg, saida, roteiros, sessoes) != 0) return EXIT_FAILURE;
+    return EXIT_SUCCESS;
+}
+
+/*
+ * benchCaminhos: índice de caminhos (montarCaminhos) em mansões sintéticas
+ * de n salas, balanceada, cadeia e aleatória. Compara ancestral, ancestral
+ * comum e pistas da subárvore pelo índice com a versão ingênua (subir pelos
+ * pais / percorrer a subárvore). Na cadeia a versão ingênua é O(n) por
+ * consulta, então ela roda menos consultas.
+ */
+static uint32_t ancestralComumIngenuo(const IndiceCaminhos *ic, uint32_t a, uint32_t b) {
+    while (ic->profundidade[a] > ic->profundidade[b]) a = ic->pai[a];
+    while (ic->profundidade[b] > ic->profundidade[a]) b = ic->pai[b];
+    while (a != b) { a = ic->pai[a]; b = ic->pai[b]; }
+    return a;
+}
+
+static uint32_t pistasNaSubarvoreIngenuo(const Mansao *m, uint32_t sala, uint32_t *pilha) {
+    uint32_t topo = 0, pistas = 0;
+    pilha[topo++] = sala;
+    while (topo > 0) {
+        const SalaPlana *s = &m->salas[pilha[--topo]];
+        pistas += s->pista != TEXTO_NENHUM;
+        if (s->esq != SALA_NENHUMA) pilha[topo++] = s->esq;
+        if (s->dir != SALA_NENHUMA) pilha[topo++] = s->dir;
+    }
+    return pistas;
+}
+
+static void benchCaminhos(int n) {
+    printf("%-10s %9s %8s %9s %9s %9s %9s %9s %9s\n", "forma", "altura", "montar", "anc ns", "ingenuo",
+           "lca ns", "ingenuo", "sub ns", "ingenuo");
+    for (int forma = FORMA_BALANCEADA; forma <= FORMA_ALEATORIA; forma++) {
+        ConfigGerador cfg = { (FormaMansao) forma, (uint32_t) n, 30, CHAVES_UNIFORME, 50, 42 };
+        CasoSintetico c;
+        gerarCasoSintetico(&cfg, &c);
+        Caso caso;
+        memset(&caso, 0, sizeof(caso));
+        Mansao *m = &caso.mansao;
+        iniciarMansao(m);
+        m->salas = (SalaPlana*) alocarMemoria((size_t) n * sizeof(SalaPlana), "malloc benchCaminhos");
+        m->total = m->cap = (uint32_t) n;
+        for (uint32_t i = 0; i < c.salas; i++) {
+            // um terço das salas sem pista, para a contagem por subárvore não ser trivial
+            m->salas[i].nome = TEXTO_NENHUM;
+            m->salas[i].pista = c.pista[i] % 3 ? (TextoId) c.pista[i] : TEXTO_NENHUM;
+            m->salas[i].esq = c.esq[i];
+            m->salas[i].dir = c.dir[i];
+        }
+        double t0 = agoraSegundos();
+        montarCaminhos(&caso);
+        double t1 = agoraSegundos();
+        const IndiceCaminhos *ic = &caso.caminhos;
+        uint32_t altura = 0;
+        for (int i = 0; i < n; i++) if (ic->profundidade[i] > altura) altura = ic->profundidade[i];
+
+        long consultas = 1000000, ingenuas = forma == FORMA_CADEIA ? 200 : consultas;
+        uint32_t *pares = (uint32_t*) alocarMemoria((size_t) consultas * 2 * sizeof(uint32_t), "malloc benchCaminhos");
+        unsigned long long estado = 99;
+        for (long q = 0; q < 2 * consultas; q++) pares[q] = (uint32_t) (proximoAleatorio(&estado) % (unsigned) n);
+        // metade dos pares com 'a' ancestral de 'b', para o teste não ser quase sempre falso
+        for (long q = 0; q < consultas; q += 2) {
+            uint32_t a = pares[2 * q + 1];
+            for (uint32_t sobe = (uint32_t) (proximoAleatorio(&estado) % 32); sobe > 0 && ic->pai[a] != SALA_NENHUMA; sobe--)
+                a = ic->pai[a];
+            pares[2 * q] = a;
+        }
+
+        volatile uint32_t soma = 0;
+        uint32_t conferencia = 0;
+        double t2 = agoraSegundos();
+        for (long q = 0; q < consultas; q++) soma += (uint32_t) ehAncestral(&caso, pares[2 * q], pares[2 * q + 1]);
+        double t3 = agoraSegundos();
+        for (long q = 0; q < ingenuas; q++) {
+            uint32_t a = pares[2 * q], b = pares[2 * q + 1];
+            while (ic->profundidade[b] > ic->profundidade[a]) b = ic->pai[b];
+            soma += a == b;
+        }
+        double t4 = agoraSegundos();
+        for (long q = 0; q < consultas; q++) soma += ancestralComum(&caso, pares[2 * q], pares[2 * q + 1]);
+        double t5 = agoraSegundos();
+        for (long q = 0; q < ingenuas; q++) {
+            uint32_t x = ancestralComumIngenuo(ic, pares[2 * q], pares[2 * q + 1]);
+            soma += x;
+            conferencia += x != ancestralComum(&caso, pares[2 * q], pares[2 * q + 1]);
+        }
+        double t6 = agoraSegundos();
+        for (long q = 0; q < consultas; q++) soma += pistasNaSubarvore(&caso, pares[2 * q]);
+        double t7 = agoraSegundos();
+        uint32_t *pilha = (uint32_t*) alocarMemoria((size_t) n * sizeof(uint32_t), "malloc benchCaminhos");
+        long subIngenuas = ingenuas < 200 ? ingenuas : 200;
+        for (long q = 0; q < subIngenuas; q++) {
+            uint32_t x = pistasNaSubarvoreIngenuo(m, pares[2 * q], pilha);
+            soma += x;
+            conferencia += x != pistasNaSubarvore(&caso, pares[2 * q]);
+        }
+        double t8 = agoraSegundos();
+
+        printf("%-10s %9u %6.0f ms %9.1f %9.1f %9.1f %9.1f %9.1f %9.0f%s\n", NOMES_FORMAS[forma], altura,
+               (t1 - t0) * 1e3, (t3 - t2) * 1e9 / consultas, (t4 - t3) * 1e9 / ingenuas,
+               (t5 - t4) * 1e9 / consultas, (t6 - t5) * 1e9 / ingenuas, (t7 - t6) * 1e9 / consultas,
+               (t8 - t7) * 1e9 / subIngenuas, conferencia ? "  DIVERGENTE" : "");
+        free(pilha);
+        free(pares);
+        liberarCaminhos(&caso.caminhos);
+        liberarMansao(m);
+        liberarCasoSintetico(&c);
+    }
+}
+
+/*
+ * benchSessaoSalva: fotografia de sessões com cadernos de 100 pistas, 1% e
+ * 100% das pistas de um caso de n salas, nos dois modos de caderno: tamanho,
+ * tempo de gravarSessao e de restaurarSessao (conferindo pistas e placar).
+ * Depois, custo por passo do diário (aplicarPasso com e sem diário).
+ */
+static void benchSessaoSalva(int n) {
+    Caso caso;
+    if (montarCasoTeste(n, &caso) != 0) return;
+    char arquivo[] = "/tmp/dq_sessaoXXXXXX";
+    int fd = mkstemp(arquivo);
+    if (fd < 0) { perror("mkstemp benchSessaoSalva"); fecharCaso(&caso); return; }
+    close(fd);
+
+    const char *nomes[] = { "avl", "bits" };
+    uint32_t tamanhos[] = { 100, caso.mansao.total / 100, caso.mansao.total };
+    printf("%-5s %9s %10s %10s %11s %12s\n", "modo", "pistas", "bytes", "gravar us", "restaurar us", "divergencias");
+    for (int modo = CADERNO_AVL; modo <= CADERNO_BITS; modo++) {
+        for (int t = 0; t < 3; t++) {
+            Sessao s, r;
+            iniciarSessao(&s, &caso, (ModoCaderno) modo);
+            iniciarSessao(&r, &caso, (ModoCaderno) modo);
+            uint32_t passo = caso.mansao.total / (tamanhos[t] ? tamanhos[t] : 1);
+            for (uint32_t i = 0; i < caso.mansao.total; i += passo ? passo : 1) {
+                s.cursor = i;
+                coletarPistaDaSala(&s, &caso);
+            }
+            const int reps = 20;
+            double t0 = agoraSegundos();
+            for (int k = 0; k < reps; k++) gravarSessao(arquivo, &s, &caso);
+            double t1 = agoraSegundos();
+            for (int k = 0; k < reps; k++) restaurarSessao(arquivo, &r, &caso);
+            double t2 = agoraSegundos();
+            struct stat st;
+            stat(arquivo, &st);
+            unsigned long divergencias = pistasColetadas(&r) != pistasColetadas(&s) || r.cursor != s.cursor;
+            for (SuspeitoId sus = 0; sus < totalSuspeitos(); sus++)
+                divergencias += placarContagem(&r.placar, sus) != placarContagem(&s.placar, sus);
+            printf("%-5s %9d %10lld %10.1f %11.1f %12lu\n", nomes[modo], pistasColetadas(&s), (long long) st.st_size,
+                   (t1 - t0) * 1e6 / reps, (t2 - t1) * 1e6 / reps, divergencias);
+            liberarSessao(&r);
+            liberarSessao(&s);
+        }
+    }
+
+    // diário: passos aleatórios com e sem um byte acrescentado por passo
+    const long passos = 200000;
+    for (int comDiario = 0; comDiario <= 1; comDiario++) {
+        Sessao s;
+        iniciarSessao(&s, &caso, CADERNO_BITS);
+        if (comDiario) abrirDiario(arquivo, &s, &caso);
+        unsigned long long estado = 5;
+        double t0 = agoraSegundos();
+        for (long k = 0; k < passos; k++) {
+            unsigned long long x = proximoAleatorio(&estado) % 16;
+            ResultadoComando rc = aplicarPasso(&s, &caso, x < 7 ? 'e' : x < 14 ? 'd' : 'r');
+            if (rc == COMANDO_MOVEU || rc == COMANDO_INICIO) coletarPistaDaSala(&s, &caso);
+        }
+        double t1 = agoraSegundos();
+        printf("passo %s diario: %.0f ns/passo\n", comDiario ? "com" : "sem", (t1 - t0) * 1e9 / passos);
+        if (comDiario) {
+            // o diário reaplicado sobre uma sessão nova reproduz o estado
+            Sessao r;
+            iniciarSessao(&r, &caso, CADERNO_BITS);
+            double t2 = agoraSegundos();
+            long reaplicados = reproduzirDiario(arquivo, &r, &caso);
+            double t3 = agoraSegundos();
+            printf("diario de %ld passos reaplicado em %.1f ms (%s)\n", reaplicados, (t3 - t2) * 1e3,
+                   r.cursor == s.cursor && r.coletadas == s.coletadas && r.passos == s.passos ? "estado igual" : "DIVERGENTE");
+            liberarSessao(&r);
+        }
+        liberarSessao(&s);
+    }
+    unlink(arquivo);
+    fecharCaso(&caso);
+}
+
+/*
+ * benchConsultasCaderno: caderno com todas as pistas de um caso de n salas
+ * ("pista <i>", então prefixos como "pista 12" casam faixas de tamanhos
+ * variados), nos dois modos. Mede páginas de PAGINA_PISTAS em posições
+ * aleatórias e autocompletar de prefixos com paginaDoCaderno, e listagens
+ * "a partir de" com cadernoDesde, contra pular ou filtrar o percurso em
+ * ordem completo, e confere os resultados.
+ */
+static uint32_t paginaPorPercurso(PistaNode *raiz, const char *prefixo, uint32_t inicio, TextoId *saida,
+                                  uint32_t max, uint32_t *total) {
+    CursorArvore c;
+    PistaNode *no;
+    size_t len = prefixo ? strlen(prefixo) : 0;
+    uint32_t n = 0;
+    *total = 0;
+    abrirCursorPistas(&c, raiz, ORDEM_EM);
+    while ((no = proximaPista(&c))) {
+        if (len && strncmp(textoDe(no->pista), prefixo, len) != 0) continue;
+        if ((*total)++ >= inicio && n < max) saida[n++] = no->pista;
+    }
+    fecharCursor(&c);
+    return n;
+}
+
+// referência para cadernoDesde: filtra o percurso em ordem completo
+static uint32_t desdePorPercurso(PistaNode *raiz, const char *desde, TextoId *saida, uint32_t max, uint32_t *total) {
+    CursorArvore c;
+    PistaNode *no;
+    uint32_t n = 0;
+    *total = 0;
+    abrirCursorPistas(&c, raiz, ORDEM_EM);
+    while ((no = proximaPista(&c))) {
+        if (strcmp(textoDe(no->pista), desde) < 0) continue;
+        if ((*total)++ < max) saida[n++] = no->pista;
+    }
+    fecharCursor(&c);
+    return n;
+}
+
+static void benchConsultasCaderno(int n) {
+    Caso caso;
+    if (montarCasoTeste(n, &caso) != 0) return;
+    const char *nomes[] = { "avl", "bits" };
+    Sessao s[2];
+    for (int modo = CADERNO_AVL; modo <= CADERNO_BITS; modo++) {
+        iniciarSessao(&s[modo], &caso, (ModoCaderno) modo);
+        for (uint32_t i = 0; i < caso.mansao.total; i++) {
+            s[modo].cursor = i;
+            coletarPistaDaSala(&s[modo], &caso);
+        }
+    }
+    PistaNode *caderno = s[CADERNO_AVL].caderno;
+    uint32_t pistas = tamanhoPista(caderno);
+    const int consultas = 100000, ingenuas = 50;
+    TextoId pagina[PAGINA_PISTAS], conferencia[PAGINA_PISTAS];
+    char prefixos[64][24];
+    unsigned long long estado = 3;
+    for (int k = 0; k < 64; k++) {
+        // prefixo de uma pista sorteada, com 7 a 12 bytes ("pista " + 1 a 6 dígitos)
+        const char *t = textoDe(pistaNaPosicao(caderno, (uint32_t) (proximoAleatorio(&estado) % pistas))->pista);
+        size_t len = 7 + proximoAleatorio(&estado) % 6;
+        snprintf(prefixos[k], sizeof(prefixos[k]), "%.*s", (int) len, t);
+    }
+
+    printf("%u pistas no caderno, paginas de %d\n", pistas, PAGINA_PISTAS);
+    printf("%-5s %12s %12s %14s %14s %12s %12s %12s\n", "modo", "pagina ns", "percurso ns", "prefixo ns", "filtro ns",
+           "desde ns", "filtro ns", "divergencias");
+    for (int modo = CADERNO_AVL; modo <= CADERNO_BITS; modo++) {
+        uint32_t total, totalRef, obtidas;
+        unsigned long divergencias = 0;
+        volatile uint32_t soma = 0;
+        estado = 17;
+        double t0 = agoraSegundos();
+        for (int q = 0; q < consultas; q++)
+            soma += paginaDoCaderno(&s[modo], &caso, NULL, (uint32_t) (proximoAleatorio(&estado) % pistas), pagina, PAGINA_PISTAS, &total);
+        double t1 = agoraSegundos();
+        estado = 17;
+        for (int q = 0; q < ingenuas; q++) {
+            uint32_t inicio = (uint32_t) (proximoAleatorio(&estado) % pistas);
+            soma += paginaPorPercurso(caderno, NULL, inicio, conferencia, PAGINA_PISTAS, &totalRef);
+            obtidas = paginaDoCaderno(&s[modo], &caso, NULL, inicio, pagina, PAGINA_PISTAS, &total);
+            divergencias += total != totalRef || memcmp(pagina, conferencia, obtidas * sizeof(TextoId)) != 0;
+        }
+        double t2 = agoraSegundos();
+        for (int q = 0; q < consultas; q++)
+            soma += paginaDoCaderno(&s[modo], &caso, prefixos[q & 63], 0, pagina, PAGINA_PISTAS, &total);
+        double t3 = agoraSegundos();
+        for (int q = 0; q < ingenuas; q++) {
+            soma += paginaPorPercurso(caderno, prefixos[q & 63], 0, conferencia, PAGINA_PISTAS, &totalRef);
+            obtidas = paginaDoCaderno(&s[modo], &caso, prefixos[q & 63], 0, pagina, PAGINA_PISTAS, &total);
+            divergencias += total != totalRef || memcmp(pagina, conferencia, obtidas * sizeof(TextoId)) != 0;
+        }
+        double t4 = agoraSegundos();
+        for (int q = 0; q < consultas; q++)
+            soma += cadernoDesde(&s[modo], &caso, prefixos[q & 63], pagina, PAGINA_PISTAS, &total);
+        double t5 = agoraSegundos();
+        for (int q = 0; q < ingenuas; q++) {
+            soma += desdePorPercurso(caderno, prefixos[q & 63], conferencia, PAGINA_PISTAS, &totalRef);
+            obtidas = cadernoDesde(&s[modo], &caso, prefixos[q & 63], pagina, PAGINA_PISTAS, &total);
+            divergencias += total != totalRef || memcmp(pagina, conferencia, obtidas * sizeof(TextoId)) != 0;
+        }
+        double t6 = agoraSegundos();
+        printf("%-5s %12.0f %12.0f %14.0f %14.0f %12.0f %12.0f %12lu\n", nomes[modo], (t1 - t0) * 1e9 / consultas,
+               (t2 - t1) * 1e9 / ingenuas, (t3 - t2) * 1e9 / consultas, (t4 - t3) * 1e9 / ingenuas,
+               (t5 - t4) * 1e9 / consultas, (t6 - t5) * 1e9 / ingenuas, divergencias);
+    }
+    // posição e k-ésima são inversas
+    unsigned long erros = 0;
+    for (uint32_t k = 0; k < pistas; k += 1 + pistas / 1000)
+        erros += posicaoDaPista(caderno, textoDe(pistaNaPosicao(caderno, k)->pista)) != k;
+    printf("posicaoDaPista(pistaNaPosicao(k)) != k: %lu\n", erros);
+    liberarSessao(&s[0]);
+    liberarSessao(&s[1]);
+    fecharCaso(&caso);
+}
+
+/*
+ * benchSaida: custo de escrever em /dev/null a listagem de um caderno com
+ * todas as pistas de um caso de n salas e os passos de uma exploração.
+ * Antes: um fprintf por linha, com o FILE em buffer de linha (como num
+ * terminal, um write por linha) ou cheio (como num pipe). Agora: a Saida, em
+ * texto e em JSON, com um write por listagem / por passo.
+ */
+static void benchSaida(int n) {
+    Caso caso;
+    if (montarCasoTeste(n, &caso) != 0) return;
+    Sessao s;
+    iniciarSessao(&s, &caso, CADERNO_AVL);
+    for (uint32_t i = 0; i < caso.mansao.total; i++) {
+        s.cursor = i;
+        coletarPistaDaSala(&s, &caso);
+    }
+    uint32_t pistas = tamanhoPista(s.caderno);
+    int fd = open("/dev/null", O_WRONLY);
+    FILE *f = fdopen(dup(fd), "w");
+    if (fd < 0 || !f) { perror("/dev/null"); exit(EXIT_FAILURE); }
+
+    printf("listagem de %u pistas com suspeito:\n", pistas);
+    for (int buffer = 0; buffer < 2; buffer++) {
+        setvbuf(f, NULL, buffer ? _IOFBF : _IOLBF, BUFSIZ);
+        CursorArvore c;
+        PistaNode *no;
+        double t0 = agoraSegundos();
+        abrirCursorPistas(&c, s.caderno, ORDEM_EM);
+        while ((no = proximaPista(&c))) {
+            SuspeitoId sus = encontrarSuspeitoId(caso.tabela, no->pista);
+            fprintf(f, "- \"%s\"  -> Suspeito sugerido: %s\n", textoDe(no->pista),
+                    sus == SUSPEITO_NENHUM ? "Desconhecido" : nomeDoSuspeito(sus));
+        }
+        fecharCursor(&c);
+        fflush(f);
+        double t1 = agoraSegundos();
+        printf("  fprintf, buffer %-5s %8.0f ns/linha\n", buffer ? "cheio" : "linha", (t1 - t0) * 1e9 / pistas);
+    }
+    for (int formato = SAIDA_TEXTO; formato <= SAIDA_JSON; formato++) {
+        Saida saida;
+        iniciarSaida(&saida, fd, (FormatoSaida) formato);
+        double t0 = agoraSegundos();
+        listarPistasEAssociacoes(&saida, s.caderno, caso.tabela);
+        double t1 = agoraSegundos();
+        printf("  Saida %-5s            %8.0f ns/linha  %lu write(s), buffer %zu KiB\n", formato == SAIDA_JSON ? "json" : "texto",
+               (t1 - t0) * 1e9 / pistas, saida.escritas, saida.cap >> 10);
+        liberarSaida(&saida);
+    }
+
+    // passos: as linhas de um passo de explorarSalas, descarregadas antes do próximo comando
+    const long passos = 200000;
+    printf("%ld passos de exploracao:\n", passos);
+    for (int buffer = 0; buffer < 2; buffer++) {
+        setvbuf(f, NULL, buffer ? _IOFBF : _IOLBF, BUFSIZ);
+        reiniciarSessao(&s, &caso);
+        unsigned long long estado = 9;
+        double t0 = agoraSegundos();
+        for (long k = 0; k < passos; k++) {
+            const SalaPlana *sala = &caso.mansao.salas[s.cursor];
+            fprintf(f, "\nVoce esta na sala: %s\n", textoDe(sala->nome));
+            if (sala->pista == TEXTO_NENHUM) fprintf(f, "Nenhuma pista aparente nesta sala.\n");
+            else fprintf(f, "Voce encontrou uma pista: \"%s\"\n", textoDe(sala->pista));
+            fprintf(f, "\nEscolhas: [e] ir para sala da esquerda, [d] ir para sala da direita, [r] voltar ao inicio, [s] sair exploracao\n");
+            fprintf(f, "Digite a escolha: ");
+            fflush(f);
+            unsigned long long x = proximoAleatorio(&estado) % 16;
+            aplicarComando(&caso.mansao, &s.cursor, x < 7 ? 'e' : x < 14 ? 'd' : 'r');
+        }
+        double t1 = agoraSegundos();
+        printf("  fprintf, buffer %-5s %8.0f ns/passo\n", buffer ? "cheio" : "linha", (t1 - t0) * 1e9 / passos);
+    }
+    // explorarSalas de verdade, com os comandos vindo de um arquivo no lugar do stdin
+    FILE *comandos = tmpfile();
+    unsigned long long estado = 9;
+    for (long k = 0; k < passos; k++) {
+        unsigned long long x = proximoAleatorio(&estado) % 16;
+        fputs(x < 7 ? "e\n" : x < 14 ? "d\n" : "r\n", comandos);
+    }
+    int stdinOriginal = dup(STDIN_FILENO);
+    for (int formato = SAIDA_TEXTO; formato <= SAIDA_JSON; formato++) {
+        rewind(comandos);
+        dup2(fileno(comandos), STDIN_FILENO);
+        clearerr(stdin);
+        reiniciarSessao(&s, &caso);
+        Saida saida;
+        iniciarSaida(&saida, fd, (FormatoSaida) formato);
+        double t0 = agoraSegundos();
+        explorarSalas(&saida, &s, &caso);
+        double t1 = agoraSegundos();
+        printf("  explorarSalas, Saida %-5s %8.0f ns/passo  %.2f write(s)/passo\n", formato == SAIDA_JSON ? "json" : "texto",
+               (t1 - t0) * 1e9 / passos, (double) saida.escritas / passos);
+        liberarSaida(&saida);
+    }
+    dup2(stdinOriginal, STDIN_FILENO);
+    close(stdinOriginal);
+    clearerr(stdin);
+    fclose(comandos);
+    fclose(f);
+    close(fd);
+    liberarSessao(&s);
+    fecharCaso(&caso);
+}
+
+/*
+ * benchPontuacao: caso de n salas (50 suspeitos) sem pesos e com 1 a 3 pesos
+ * extras por pista, entre -2 e 3. Mede a coleta de todas as pistas (placar
+ * incremental), o ranking com a situação de cada suspeito lida do placar e
+ * a recontagem dos pontos percorrendo o caderno, que o placar evita.
+ */
+static void benchPontuacao(int n) {
+    for (int comPesos = 0; comPesos < 2; comPesos++) {
+        char texto[] = "/tmp/dq_mansaoXXXXXX";
+        if (escreverMansaoTeste(texto, n, 50) != 0) return;
+        TabelaHash *tab = criarTabelaHash(0);
+        Mansao m;
+        RegrasEvidencia regras;
+        iniciarRegras(&regras);
+        int rc = carregarMansao(texto, &m, tab, &regras);
+        unlink(texto);
+        if (rc != 0) { liberarTabelaHash(tab); reiniciarTextos(); return; }
+        unsigned long long estado = 5;
+        char pista[32], sus[32];
+        for (int i = 0; comPesos && i < n; i += 2) {
+            snprintf(pista, sizeof(pista), "pista %d", i);
+            int extras = 1 + (int) (proximoAleatorio(&estado) % 3);
+            for (int k = 0; k < extras; k++) {
+                snprintf(sus, sizeof(sus), "Suspeito %d", (int) (proximoAleatorio(&estado) % 50));
+                adicionarPeso(&regras, pista, sus, (int32_t) (proximoAleatorio(&estado) % 6) - 2);
+            }
+        }
+        if (comPesos) regras.limiarSustentar = 4;
+        Caso caso;
+        double t0 = agoraSegundos();
+        prepararCaso(&caso, &m, tab, &regras);
+        double t1 = agoraSegundos();
+        liberarRegras(&regras);
+        printf("%s: %u pistas, %.2f pesos/pista, prepararCaso %.1f ms\n", comPesos ? "com pesos" : "sem pesos", caso.totalPistas,
+               caso.inicioPesos ? (double) caso.totalPesos / caso.totalPistas : 1.0, (t1 - t0) * 1e3);
+
+        uint32_t nSus = totalSuspeitos();
+        SuspeitoId *ordem = (SuspeitoId*) alocarMemoria(nSus * sizeof(SuspeitoId), "malloc benchPontuacao");
+        int64_t *pontos = (int64_t*) alocarMemoria(nSus * sizeof(int64_t), "malloc benchPontuacao");
+        for (int modo = CADERNO_AVL; modo <= CADERNO_BITS; modo++) {
+            Sessao s;
+            iniciarSessao(&s, &caso, (ModoCaderno) modo);
+            double t2 = agoraSegundos();
+            for (uint32_t i = 0; i < caso.mansao.total; i++) {
+                s.cursor = i;
+                coletarPistaDaSala(&s, &caso);
+            }
+            double t3 = agoraSegundos();
+
+            const int rodadas = 1000;
+            long incriminados = 0;
+            double t4 = agoraSegundos();
+            for (int r = 0; r < rodadas; r++) {
+                rankingSuspeitos(&s.placar, ordem);
+                for (uint32_t k = 0; k < nSus; k++) incriminados += situacaoSuspeito(&s.placar, &caso, ordem[k]) == SITUACAO_INCRIMINADO;
+            }
+            double t5 = agoraSegundos();
+
+            // referência: soma os vetores de todas as pistas do caderno
+            PistaNode *caderno = cadernoOrdenado(&s, &caso);
+            int recontagens = n >= 100000 ? 3 : 30;
+            double t6 = agoraSegundos();
+            for (int r = 0; r < recontagens; r++) {
+                memset(pontos, 0, nSus * sizeof(int64_t));
+                CursorArvore c;
+                PistaNode *no;
+                abrirCursorPistas(&c, caderno, ORDEM_EM);
+                while ((no = proximaPista(&c))) {
+                    uint32_t d = pistaDensa(&caso, no->pista);
+                    if (!caso.inicioPesos) {
+                        pontos[caso.suspeitoDaPista[d]]++;
+                        continue;
+                    }
+                    for (uint32_t k = caso.inicioPesos[d]; k < caso.inicioPesos[d + 1]; k++)
+                        pontos[caso.pesos[k].suspeito] += caso.pesos[k].peso;
+                }
+                fecharCursor(&c);
+            }
+            double t7 = agoraSegundos();
+            int divergencias = 0;
+            for (uint32_t k = 0; k < nSus; k++) divergencias += pontos[k] != placarPontos(&s.placar, k);
+            printf("  %-5s coleta %5.0f ns/pista  ranking+situacao (%u suspeitos) %6.2f us  recontagem %8.3f ms  incriminados=%ld divergencias=%d\n",
+                   modo == CADERNO_BITS ? "bits" : "AVL", (t3 - t2) * 1e9 / pistasColetadas(&s), nSus, (t5 - t4) * 1e6 / rodadas,
+                   (t7 - t6) * 1e3 / recontagens, incriminados / rodadas, divergencias);
+            liberarSessao(&s);
+        }
+        free(ordem);
+        free(pontos);
+        fecharCaso(&caso);
+    }
+}
+
+/*
+ * benchMansaoProcedural: partida de uma mansão procedural de um bilhão de
+ * salas x a mesma mansão de n salas materializada inteira (todas as salas
+ * geradas e internadas antes de jogar), e passeios aleatórios de n passos
+ * ('r' em 1/8 dos passos) com caches de salas pequeno e grande.
+ */
+static void benchMansaoProcedural(int n) {
+    const uint32_t bilhao = 1000000000u;
+    // a procedural primeiro, para a memória dela não vir da mansão inteira já liberada
+    for (int procedural = 1; procedural >= 0; procedural--) {
+        long rss0 = lerRssKiB();
+        double t0 = agoraSegundos();
+        TabelaHash *tab = criarTabelaHash(0);
+        Mansao m;
+        mansaoProcedural(&m, tab, procedural ? bilhao : (uint32_t) n, 3, SALAS_EM_CACHE_PADRAO);
+        if (!procedural) {
+            // mesma mansão, com todas as salas geradas de antemão
+            Mansao inteira;
+            iniciarMansao(&inteira);
+            inteira.total = inteira.cap = m.total;
+            inteira.salas = (SalaPlana*) alocarMemoria((size_t) m.total * sizeof(SalaPlana), "malloc benchMansaoProcedural");
+            char nome[NOME_SALA_MAX];
+            for (uint32_t i = 0; i < m.total; i++) {
+                gerarSala(&m, i, nome, &inteira.salas[i].pista);
+                inteira.salas[i].nome = internar(nome);
+                inteira.salas[i].esq = filhoDaSala(&m, i, 0);
+                inteira.salas[i].dir = filhoDaSala(&m, i, 1);
+            }
+            liberarMansao(&m);
+            m = inteira;
+        }
+        Caso caso;
+        prepararCaso(&caso, &m, tab, NULL);
+        double t1 = agoraSegundos();
+        long rss1 = lerRssKiB();
+        printf("%-11s %10u salas: partida %8.2f ms, +%ld KiB\n", procedural ? "procedural" : "explicita",
+               caso.mansao.total, (t1 - t0) * 1e3, rss1 - rss0);
+
+        uint32_t caches[2] = { 64, 65536 };
+        for (int k = 0; k < (procedural ? 2 : 1); k++) {
+            caso.mansao.salasEmCache = caches[k];
+            Sessao s;
+            iniciarSessao(&s, &caso, CADERNO_BITS);
+            unsigned long long estado = 11;
+            double t2 = agoraSegundos();
+            for (int passo = 0; passo < n; passo++) {
+                unsigned x = (unsigned) (proximoAleatorio(&estado) % 8);
+                if (aplicarComando(&caso.mansao, &s.cursor, x == 0 ? 'r' : x & 1 ? 'e' : 'd') != COMANDO_SEM_SALA)
+                    coletarPistaDaSala(&s, &caso);
+                else
+                    s.cursor = caso.mansao.raiz; // chegou a uma folha
+            }
+            double t3 = agoraSegundos();
+            if (s.cache) {
+                printf("  cache %6u salas (%7zu KiB): %6.1f ns/passo, acertos %5.1f%%, %lu salas geradas, %d pistas\n",
+                       s.cache->capacidade,
+                       ((size_t) s.cache->capacidade * sizeof(SalaGerada) + ((size_t) s.cache->mascara + 1) * sizeof(uint32_t)) >> 10,
+                       (t3 - t2) * 1e9 / n, 100.0 * s.cache->acertos / (s.cache->acertos + s.cache->geradas),
+                       s.cache->geradas, pistasColetadas(&s));
+            } else {
+                printf("  salas em memoria:                   %6.1f ns/passo, %d pistas\n", (t3 - t2) * 1e9 / n, pistasColetadas(&s));
+            }
+            liberarSessao(&s);
+        }
+        fecharCaso(&caso);
+    }
+}
+
+/*
+ * benchResolvedor: resolvedor numa mansão de n salas (50 suspeitos, sem
+ * pistas repetidas) com limiares 2 e 4, em 1, 2 e 4 threads, conferindo
+ * que as respostas não dependem do número de threads; e numa mansão de
+ * 4095 salas com 64 pistas espalhadas por todas elas, resolvida pela busca
+ * por conjuntos de pistas.
+ */
+static void benchResolvedor(int n) {
+    char texto[] = "/tmp/dq_mansaoXXXXXX";
+    if (escreverMansaoTeste(texto, n, 50) != 0) return;
+    TabelaHash *tab = criarTabelaHash(0);
+    Mansao m;
+    int rc = carregarMansao(texto, &m, tab, NULL);
+    unlink(texto);
+    if (rc != 0) { liberarTabelaHash(tab); reiniciarTextos(); return; }
+    Caso caso;
+    prepararCaso(&caso, &m, tab, NULL);
+    uint32_t nSus = totalSuspeitos();
+    SolucaoSuspeito *ref = (SolucaoSuspeito*) alocarMemoria(nSus * sizeof(SolucaoSuspeito), "malloc benchResolvedor");
+    SolucaoSuspeito *sol = (SolucaoSuspeito*) alocarMemoria(nSus * sizeof(SolucaoSuspeito), "malloc benchResolvedor");
+    int limiares[2] = { 2, 4 };
+    for (int l = 0; l < 2; l++) {
+        caso.limiarSustentar = limiares[l];
+        int threads[3] = { 1, 2, 4 };
+        double base = 0;
+        for (int k = 0; k < 3; k++) {
+            double t0 = agoraSegundos();
+            resolverCaso(&caso, threads[k], k == 0 ? ref : sol);
+            double t1 = agoraSegundos();
+            if (k == 0) base = t1 - t0;
+            int divergencias = 0, sustentaveis = 0;
+            long long passos = 0;
+            for (uint32_t s = 0; s < nSus; s++) {
+                const SolucaoSuspeito *x = k == 0 ? &ref[s] : &sol[s];
+                divergencias += x->situacao != ref[s].situacao || x->passos != ref[s].passos;
+                sustentaveis += x->situacao == SOLUCAO_SUSTENTAVEL;
+                passos += x->passos;
+            }
+            printf("%u salas, limiar %d, %d thread(s): %8.1f ms (%.2fx)  %d sustentaveis, %lld passos no total, divergencias=%d\n",
+                   caso.mansao.total, limiares[l], threads[k], (t1 - t0) * 1e3, base / (t1 - t0), sustentaveis, passos, divergencias);
+        }
+    }
+    fecharCaso(&caso);
+
+    // pistas repetidas: as salas de índice >= 128 repetem as pistas das 128 primeiras
+    char repetidas[] = "/tmp/dq_mansaoXXXXXX";
+    if (escreverMansaoTeste(repetidas, 4095, 8) != 0) { free(ref); free(sol); return; }
+    tab = criarTabelaHash(0);
+    rc = carregarMansao(repetidas, &m, tab, NULL);
+    unlink(repetidas);
+    if (rc != 0) { liberarTabelaHash(tab); free(ref); free(sol); return; }
+    for (uint32_t i = 128; i < m.total; i++) m.salas[i].pista = m.salas[i % 128].pista;
+    prepararCaso(&caso, &m, tab, NULL);
+    caso.limiarSustentar = 3;
+    nSus = totalSuspeitos();
+    double t0 = agoraSegundos();
+    resolverCaso(&caso, 1, sol);
+    double t1 = agoraSegundos();
+    int porConjuntos = 0;
+    for (uint32_t s = 0; s < nSus; s++) porConjuntos += sol[s].prova == PROVA_CONJUNTOS;
+    printf("%u salas com 64 pistas distintas, limiar 3: %.1f ms, %d de %u suspeitos pela busca por conjuntos\n",
+           caso.mansao.total, (t1 - t0) * 1e3, porConjuntos, nSus);
+    fecharCaso(&caso);
+    free(ref);
+    free(sol);
+}
+
+/*
+ * benchLeiaute: mansões balanceada e aleatória de n salas, numeradas na
+ * ordem de criação (como um arquivo), como árvore de Sala com um malloc por
+ * sala e congeladas em largura e em van Emde Boas. Mede passeios aleatórios
+ * da entrada até uma folha ([r] ao chegar) e o percurso completo em
+ * pré-ordem; a soma das pistas confere que todas as formas são a mesma
+ * árvore.
+ */
+static void benchLeiaute(int n) {
+    static const char *const nomes[] = { "arvore Sala", "arquivo", "largura", "veb" };
+    const long passos = 4000000;
+    printf("%-10s %-12s %10s %12s %12s %10s\n", "forma", "leiaute", "congelar", "passeio ns", "percurso ns", "soma");
+    for (int forma = FORMA_BALANCEADA; forma <= FORMA_ALEATORIA; forma += FORMA_ALEATORIA - FORMA_BALANCEADA) {
+        ConfigGerador cfg = { (FormaMansao) forma, (uint32_t) n, 30, CHAVES_UNIFORME, 50, 42 };
+        CasoSintetico c;
+        gerarCasoSintetico(&cfg, &c);
+        uint32_t *pilha = (uint32_t*) alocarMemoria((size_t) n * sizeof(uint32_t) + 1, "malloc benchLeiaute");
+        Sala **pilhaSalas = (Sala**) alocarMemoria((size_t) n * sizeof(Sala*) + 1, "malloc benchLeiaute");
+        unsigned long long referencia = 0;
+        for (int l = 0; l <= LEIAUTE_VEB + 1; l++) {
+            Arena *arena = NULL;
+            Sala **nos = NULL;
+            Mansao m;
+            iniciarMansao(&m);
+            double t0 = agoraSegundos(), t1 = t0;
+            if (l == 0) {
+                // um malloc por sala, na ordem de criação
+                arena = criarArena(1);
+                nos = (Sala**) alocarMemoria((size_t) n * sizeof(Sala*), "malloc benchLeiaute");
+                for (int i = 0; i < n; i++) {
+                    nos[i] = (Sala*) arenaAlocar(arena, sizeof(Sala));
+                    nos[i]->nome = TEXTO_NENHUM;
+                    nos[i]->pista = (TextoId) c.pista[i];
+                }
+                for (int i = 0; i < n; i++) {
+                    nos[i]->esq = c.esq[i] != SALA_NENHUMA ? nos[c.esq[i]] : NULL;
+                    nos[i]->dir = c.dir[i] != SALA_NENHUMA ? nos[c.dir[i]] : NULL;
+                }
+            } else {
+                m.salas = (SalaPlana*) alocarMemoria((size_t) n * sizeof(SalaPlana), "malloc benchLeiaute");
+                m.total = m.cap = (uint32_t) n;
+                for (int i = 0; i < n; i++) {
+                    m.salas[i].nome = TEXTO_NENHUM;
+                    m.salas[i].pista = (TextoId) c.pista[i];
+                    m.salas[i].esq = c.esq[i];
+                    m.salas[i].dir = c.dir[i];
+                }
+                t0 = agoraSegundos();
+                congelarMansao(&m, (LeiauteMansao) (l - 1));
+                t1 = agoraSegundos();
+            }
+
+            // passeios: a mesma sequência de sorteios desce pelas mesmas salas em qualquer leiaute
+            unsigned long long estado = 7, soma = 0;
+            double t2 = agoraSegundos();
+            if (l == 0) {
+                Sala *atual = nos[0];
+                for (long p = 0; p < passos; p++) {
+                    Sala *prox = proximoAleatorio(&estado) & 1 ? atual->dir : atual->esq;
+                    if (!prox) prox = atual->esq ? atual->esq : atual->dir;
+                    atual = prox ? prox : nos[0];
+                    soma += atual->pista;
+                }
+            } else {
+                uint32_t atual = m.raiz;
+                for (long p = 0; p < passos; p++) {
+                    uint32_t prox = proximoAleatorio(&estado) & 1 ? m.salas[atual].dir : m.salas[atual].esq;
+                    if (prox == SALA_NENHUMA) prox = m.salas[atual].esq != SALA_NENHUMA ? m.salas[atual].esq : m.salas[atual].dir;
+                    atual = prox != SALA_NENHUMA ? prox : m.raiz;
+                    soma += m.salas[atual].pista;
+                }
+            }
+            double t3 = agoraSegundos();
+
+            // percurso completo em pré-ordem com pilha explícita
+            const int rodadas = 5;
+            double t4 = agoraSegundos();
+            for (int r = 0; r < rodadas; r++) {
+                size_t topo = 0;
+                if (l == 0) {
+                    pilhaSalas[topo++] = nos[0];
+                    while (topo > 0) {
+                        Sala *v = pilhaSalas[--topo];
+                        soma += v->pista;
+                        if (v->dir) pilhaSalas[topo++] = v->dir;
+                        if (v->esq) pilhaSalas[topo++] = v->esq;
+                    }
+                } else {
+                    pilha[topo++] = m.raiz;
+                    while (topo > 0) {
+                        const SalaPlana *v = &m.salas[pilha[--topo]];
+                        soma += v->pista;
+                        if (v->dir != SALA_NENHUMA) pilha[topo++] = v->dir;
+                        if (v->esq != SALA_NENHUMA) pilha[topo++] = v->esq;
+                    }
+                }
+            }
+            double t5 = agoraSegundos();
+            if (l == 0) referencia = soma;
+            printf("%-10s %-12s %7.1f ms %12.1f %12.2f %10s\n", NOMES_FORMAS[forma], nomes[l], (t1 - t0) * 1e3,
+                   (t3 - t2) * 1e9 / passos, (t5 - t4) * 1e9 / ((double) rodadas * n), soma == referencia ? "confere" : "DIVERGENTE");
+            free(nos);
+            liberarArena(arena);
+            liberarMansao(&m);
+        }
+        free(pilhaSalas);
+        free(pilha);
+        liberarCasoSintetico(&c);
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strncmp(argv[1], "--", 2) == 0) return mainGerador(argc, argv);
+    int n = (argc > 1) ? atoi(argv[1]) : 1000000;
+    if (n <= 0) n = 1000000;
+    printf("== AVL de pistas: insercao ordenada x aleatoria ==\n");
+    benchInsercaoPistas(n);
+    printf("\n== Tabela hash pista -> suspeito ==\n");
+    benchTabelaHash(n);
+    printf("\n== Memoria: malloc por no x arena ==\n");
+    benchMemoria(n);
+    printf("\n== Internacao de textos ==\n");
+    benchInternacao(n, 1);
+    benchInternacao(n, 8);
+    printf("\n== Veredito: recontagem x placar ==\n");
+    benchVeredito(n, 50);
+    printf("\n== Mansao: carregar de arquivo x criarSala ==\n");
+    benchCarregarMansao(n);
+    printf("\n== Partida: mansao em texto x caso compilado mapeado ==\n");
+    benchCasoMapeado(n);
+    printf("\n== Passos: pista da sala por strcmp x catalogo x campo ==\n");
+    benchPassos(n);
+    printf("\n== Servidor: sessoes simultaneas sobre um caso compartilhado ==\n");
+    benchServidor(n);
+    printf("\n== Caderno: AVL x bitset de pistas densas ==\n");
+    benchCaderno(n);
+    printf("\n== Textos: hash e comparacao sem caixa (escalar x SSE2 x AVX2) ==\n");
+    benchTextosSimd(n);
+    printf("\n== Carga em lote: um a um x carregarEvidencias ==\n");
+    benchCargaEmLote(n);
+    printf("\n== Caminhos: indice de ancestrais x subir pelos pais ==\n");
+    benchCaminhos(n);
+    printf("\n== Sessao salva: fotografia e diario ==\n");
+    benchSessaoSalva(n);
+    printf("\n== Caderno: paginas e prefixos por posicao x percurso ==\n");
+    benchConsultasCaderno(n);
+    printf("\n== Saida: printf por linha x buffer com um write ==\n");
+    benchSaida(n);
+    printf("\n== Pontuacao: placar com pesos x recontagem do caderno ==\n");
+    benchPontuacao(n);
+    printf("\n== Mansao procedural: salas sob demanda com cache LRU x mansao inteira ==\n");
+    benchMansaoProcedural(n);
+    printf("\n== Resolvedor: quem pode ser acusado, em paralelo ==\n");
+    benchResolvedor(n);
+    printf("\n== Leiaute: arvore de Sala x mansao congelada (arquivo, largura, van Emde Boas) ==\n");
+    benchLeiaute(n);
+    return 0;
+}
+
+#else
+
+/* -------------------------
+   MAIN - monta mansão, hash, lida com fluxo
+   ------------------------- */
+
+// "--limiar s" ou "--limiar s:i" (sem ':i', inocenta com LIMIAR_INOCENTAR_PADRAO)
+static int lerLimiares(const char *arg, long *sustentar, long *inocentar) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s", arg);
+    char *dois = strchr(buf, ':');
+    if (dois) *dois = '\0';
+    *inocentar = LIMIAR_INOCENTAR_PADRAO;
+    return lerInteiro(buf, -PESO_MAXIMO, PESO_MAXIMO, sustentar) &&
+           (!dois || lerInteiro(dois + 1, -PESO_MAXIMO, PESO_MAXIMO, inocentar)) && *inocentar < *sustentar;
+}
+
+// "--procedural salas" ou "--procedural salas:semente" (semente 0 por padrão)
+static int lerProcedural(const char *arg, uint32_t *salas, uint64_t *semente) {
+    char *fim;
+    errno = 0;
+    unsigned long long n = strtoull(arg, &fim, 10);
+    if (errno || fim == arg || n == 0 || n >= SALA_NENHUMA || (*fim != '\0' && *fim != ':')) return 0;
+    *salas = (uint32_t) n;
+    *semente = 0;
+    if (*fim == ':') {
+        const char *s = fim + 1;
+        *semente = strtoull(s, &fim, 0);
+        if (errno || fim == s || *fim != '\0') return 0;
+    }
+    return 1;
+}
+
+int main(int argc, char **argv) {
+    // capacidade inicial da tabela hash - pequena para demo (cresce se preciso)
+    const int M = 16;
+
+    // --- mansao: caso compilado (--caso), arquivo texto (--mansao), procedural (--procedural) ou o mapa fixo de exemplo ---
+    const char *arquivoMansao = NULL, *arquivoCaso = NULL, *compilarPara = NULL, *arquivoLote = NULL, *sessaoSalva = NULL;
+    int nThreads = 1, resolver = 0;
+    long limiarSustentar = 0, limiarInocentar = 0;
+    int limiarDado = 0;
+    uint32_t salasProcedurais = 0, salasEmCache = SALAS_EM_CACHE_PADRAO;
+    uint64_t semente = 0;
+    ModoCaderno modo = CADERNO_AVL;
+    FormatoSaida formato = SAIDA_TEXTO;
+    LeiauteMansao leiaute = LEIAUTE_ARQUIVO;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--mansao") == 0 && i + 1 < argc) arquivoMansao = argv[++i];
+        else if (strcmp(argv[i], "--caso") == 0 && i + 1 < argc) arquivoCaso = argv[++i];
+        else if (strcmp(argv[i], "--compilar-caso") == 0 && i + 1 < argc) compilarPara = argv[++i];
+        else if (strcmp(argv[i], "--lote") == 0 && i + 1 < argc) arquivoLote = argv[++i];
+        else if (strcmp(argv[i], "--sessao") == 0 && i + 1 < argc) sessaoSalva = argv[++i];
+        else if (strcmp(argv[i], "--resolver") == 0) resolver = 1;
+        else if (strcmp(argv[i], "--caderno") == 0 && i + 1 < argc &&
+                 (strcmp(argv[i + 1], "avl") == 0 || strcmp(argv[i + 1], "bits") == 0))
+            modo = strcmp(argv[++i], "bits") == 0 ? CADERNO_BITS : CADERNO_AVL;
+        else if (strcmp(argv[i], "--saida") == 0 && i + 1 < argc &&
+                 (strcmp(argv[i + 1], "texto") == 0 || strcmp(argv[i + 1], "json") == 0))
+            formato = strcmp(argv[++i], "json") == 0 ? SAIDA_JSON : SAIDA_TEXTO;
+        else if (strcmp(argv[i], "--leiaute") == 0 && i + 1 < argc &&
+                 (strcmp(argv[i + 1], "arquivo") == 0 || strcmp(argv[i + 1], "largura") == 0 || strcmp(argv[i + 1], "veb") == 0)) {
+            i++;
+            leiaute = strcmp(argv[i], "veb") == 0 ? LEIAUTE_VEB : strcmp(argv[i], "largura") == 0 ? LEIAUTE_LARGURA : LEIAUTE_ARQUIVO;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0) nThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--limiar") == 0 && i + 1 < argc && lerLimiares(argv[i + 1], &limiarSustentar, &limiarInocentar)) {
+            limiarDado = 1;
+            i++;
+        } else if (strcmp(argv[i], "--procedural") == 0 && i + 1 < argc && lerProcedural(argv[i + 1], &salasProcedurais, &semente)) {
+            i++;
+        } else if (strcmp(argv[i], "--cache-salas") == 0 && i + 1 < argc && atol(argv[i + 1]) >= 2 && atol(argv[i + 1]) < (1L << 28)) {
+            salasEmCache = (uint32_t) atol(argv[++i]);
+        } else {
+            fprintf(stderr, "uso: %s [--mansao arquivo | --caso arquivo.dqc | --procedural salas[:semente] [--cache-salas N]] [--compilar-caso saida.dqc] [--leiaute arquivo|largura|veb] [--caderno avl|bits] [--saida texto|json] [--limiar sustentar[:inocentar]] [--sessao nome] [--lote roteiros|- [--threads N]] [--resolver [--threads N]]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (arquivoCaso && (arquivoMansao || compilarPara)) {
+        fprintf(stderr, "--caso nao pode ser combinado com --mansao ou --compilar-caso\n");
+        return EXIT_FAILURE;
+    }
+    if (salasProcedurais && (arquivoMansao || arquivoCaso || compilarPara)) {
+        fprintf(stderr, "--procedural nao pode ser combinado com --mansao, --caso ou --compilar-caso\n");
+        return EXIT_FAILURE;
+    }
+    if (leiaute != LEIAUTE_ARQUIVO && (arquivoCaso || salasProcedurais)) {
+        // o caso compilado guarda a ordem escolhida ao compilar; a procedural já está em largura
+        fprintf(stderr, "--leiaute nao pode ser combinado com --caso ou --procedural\n");
+        return EXIT_FAILURE;
+    }
+    if (sessaoSalva && arquivoLote) {
+        fprintf(stderr, "--sessao nao pode ser combinado com --lote\n");
+        return EXIT_FAILURE;
+    }
+    if (resolver && (arquivoLote || sessaoSalva || salasProcedurais || compilarPara)) {
+        fprintf(stderr, "--resolver nao pode ser combinado com --lote, --sessao, --procedural ou --compilar-caso\n");
+        return EXIT_FAILURE;
+    }
+
+    // o caso é montado uma vez; depois disso só as sessões mudam
+    Arena *arena = criarArena(0); // árvore de Sala do mapa de exemplo
+    Caso caso;
+    if (arquivoCaso) {
+        if (abrirCaso(arquivoCaso, &caso) != 0) {
+            liberarArena(arena);
+            return EXIT_FAILURE;
+        }
+    } else {
+        TabelaHash *tabela = criarTabelaHash(M);
+        Mansao mansao;
+        RegrasEvidencia regras;
+        iniciarRegras(&regras);
+        int rc = 0;
+        if (arquivoMansao) rc = carregarMansao(arquivoMansao, &mansao, tabela, &regras);
+        else if (salasProcedurais) mansaoProcedural(&mansao, tabela, salasProcedurais, semente, salasEmCache);
+        else montarCasoExemplo(arena, tabela, &mansao);
+        if (rc == 0) congelarMansao(&mansao, leiaute);
+        if (limiarDado) {
+            // --limiar vale também para o caso compilado
+            regras.limiarSustentar = (int32_t) limiarSustentar;
+            regras.limiarInocentar = (int32_t) limiarInocentar;
+        }
+        if (rc == 0 && compilarPara) {
+            rc = gravarCaso(compilarPara, &mansao, tabela, &regras);
+            if (rc == 0) printf("Caso gravado em %s (%u salas).\n", compilarPara, mansao.total);
+            liberarMansao(&mansao);
+        }
+        if (rc != 0 || compilarPara) {
+            liberarRegras(&regras);
+            liberarTabelaHash(tabela);
+            liberarSuspeitos();
+            liberarArena(arena);
+            liberarTextos();
+            return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        prepararCaso(&caso, &mansao, tabela, &regras);
+        liberarRegras(&regras);
+    }
+    if (limiarDado) {
+        caso.limiarSustentar = (int32_t) limiarSustentar;
+        caso.limiarInocentar = (int32_t) limiarInocentar;
+    }
+
+    // --- resolvedor: quem pode ser acusado com sucesso, e com quantos passos ---
+    if (resolver) {
+        SolucaoSuspeito *solucoes = (SolucaoSuspeito*) alocarMemoria((size_t) totalSuspeitos() * sizeof(SolucaoSuspeito) + 1, "malloc main");
+        double inicio = agoraSegundos();
+        int rc = resolverCaso(&caso, nThreads, solucoes);
+        double segundos = agoraSegundos() - inicio;
+        if (rc == 0) {
+            Saida saida;
+            iniciarSaida(&saida, STDOUT_FILENO, formato);
+            relatarResolucao(&saida, &caso, solucoes);
+            liberarSaida(&saida);
+            fprintf(stderr, "resolvedor: %u salas alcancaveis, %u pistas em %.3fs com %d thread(s)\n",
+                    caso.caminhos.alcancaveis, caso.totalPistas, segundos, nThreads);
+        }
+        free(solucoes);
+        fecharCaso(&caso);
+        liberarArena(arena);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // --- modo em lote: sessões roteirizadas, sem prompts ---
+    if (arquivoLote) {
+        FILE *roteiros = strcmp(arquivoLote, "-") == 0 ? stdin : fopen(arquivoLote, "r");
+        int rc = -1;
+        if (!roteiros) {
+            perror(arquivoLote);
+        } else {
+            EstatisticasLote est;
+            Saida saida;
+            iniciarSaida(&saida, STDOUT_FILENO, formato);
+            rc = executarLote(roteiros, &saida, &caso, modo, nThreads, &est);
+            liberarSaida(&saida);
+            if (roteiros != stdin) fclose(roteiros);
+            fprintf(stderr, "lote: %lu sessoes, %lu passos, %lu acusacoes sustentadas em %.3fs com %d thread(s) (%.0f sessoes/s, %.0f passos/s)\n",
+                    est.sessoes, est.passos, est.sustentadas, est.segundos, nThreads,
+                    est.segundos > 0 ? est.sessoes / est.segundos : 0.0,
+                    est.segundos > 0 ? est.passos / est.segundos : 0.0);
+        }
+#ifdef DQ_INSTRUMENTAR
+        relatarInstrumentacao(&caso, NULL);
+#endif
+        fecharCaso(&caso);
+        liberarArena(arena);
+        return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    // --- sessão do jogador: sala atual, caderno (AVL de pistas) e placar por suspeito ---
+    Sessao sessao;
+    iniciarSessao(&sessao, &caso, modo);
+    // --sessao: retoma a fotografia e o diário 'nome.dqs' / 'nome.dqj' e continua gravando
+    if (sessaoSalva && retomarSessao(sessaoSalva, &sessao, &caso) != 0) {
+        liberarSessao(&sessao);
+        fecharCaso(&caso);
+        liberarArena(arena);
+        return EXIT_FAILURE;
+    }
+
+    // toda a saída da partida passa pelo buffer: um write por passo ou listagem
+    Saida saida;
+    iniciarSaida(&saida, STDOUT_FILENO, formato);
+    int json = formato == SAIDA_JSON;
+
+    // Mensagem inicial
+    if (json) {
+        escreverSaida(&saida, "{\"evento\":\"inicio\",\"salas\":%u,\"pistas\":%d,\"passos\":%lu}\n",
+                      caso.mansao.total, pistasColetadas(&sessao), sessao.passos);
+    } else {
+        escreverSaida(&saida, "===== DETECTIVE QUEST - Exploracao da Mansao =====\n");
+        escreverSaida(&saida, "Voce ira explorar as salas e coletar pistas automaticamente ao entrar.\n");
+        if (sessao.passos > 0)
+            escreverSaida(&saida, "Sessao retomada: %d pista(s) no caderno, %lu passo(s) dados.\n", pistasColetadas(&sessao), sessao.passos);
+    }
+
+    // Explorar salas (interativo)
+    explorarSalas(&saida, &sessao, &caso);
+    if (sessaoSalva) compactarSessao(sessaoSalva, &sessao, &caso);
+
+    // Ao final da exploração, listar pistas coletadas e buscar suspeito
+    if (!json) escreverSaida(&saida, "\n=== FIM DA EXPLORACAO ===\n");
+    int total = pistasColetadas(&sessao);
+    PistaNode *pistas = cadernoOrdenado(&sessao, &caso);
     if (total == 0) {
-        printf("Voce nao coletou nenhuma pista.\n");
+        if (!json) escreverSaida(&saida, "Voce nao coletou nenhuma pista.\n");
     } else {
-        printf("Pistas coletadas (%d):\n", total);
-        mostrarPistasInOrder(raizPistas);
-        printf("\nAssociacoes pista -> suspeito (segundo a tabela):\n");
-        listarPistasEAssociacoes(raizPistas, tabela, M);
+        if (!json) escreverSaida(&saida, "Pistas coletadas (%d):\n", total);
+        mostrarPistasInOrder(&saida, pistas);
+        if (!json) escreverSaida(&saida, "\nAssociacoes pista -> suspeito (segundo a tabela):\n");
+        listarPistasEAssociacoes(&saida, pistas, caso.tabela);
+        if (!json) escreverSaida(&saida, "\nSuspeitos mais citados:\n");
+        mostrarRankingSuspeitos(&saida, &sessao.placar, &caso);
     }
 
     // Perguntar acusacao
     char acusado[128];
-    printf("\nQuem voce acusa? Digite o nome do suspeito (ex: Marido): ");
+    if (!json) escreverSaida(&saida, "\nQuem voce acusa? Digite o nome do suspeito (ex: Marido): ");
+    descarregarSaida(&saida);
     if (!fgets(acusado, sizeof(acusado), stdin)) {
         strcpy(acusado, "");
     }
     trim_newline(acusado);
     if (strlen(acusado) == 0) {
-        printf("Nenhum suspeito indicado. Encerrando.\n");
+        if (!json) escreverSaida(&saida, "Nenhum suspeito indicado. Encerrando.\n");
     } else {
-        // verificar se pelo menos duas pistas apontam para o acusado
-        verificarSuspeitoFinal(raizPistas, tabela, M, acusado);
+        // verificar se as pistas somam pontos suficientes contra o acusado
+        verificarSuspeitoFinal(&saida, pistas, &sessao.placar, &caso, acusado);
+        if (sessaoSalva) descartarSessao(sessaoSalva, &sessao); // caso encerrado
     }
+    descarregarSaida(&saida);
+
+#ifdef DQ_INSTRUMENTAR
+    INSTR_CADERNO(pistas, (uint32_t) total);
+    relatarInstrumentacao(&caso, pistas);
+#endif
 
     // liberar memorias
-    liberarPistas(raizPistas);
-    liberarTabelaHash(tabela, M);
-    liberarSalas(root);
+    liberarSessao(&sessao);
+    fecharCaso(&caso);
+    liberarArena(arena); // salas do mapa de exemplo
 
-    printf("\nObrigado por jogar Detective Quest - sistema finalizado.\n");
+    if (!json) escreverSaida(&saida, "\nObrigado por jogar Detective Quest - sistema finalizado.\n");
+    liberarSaida(&saida);
     return 0;
 }
+
+#endif /* DQ_BENCH */